@@ -0,0 +1,100 @@
+/** InputArguments and OutputArguments benchmarks.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ */
+
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+#include "mexplus/arguments.h"
+
+using namespace std;
+using mexplus::InputArguments;
+using mexplus::MxArray;
+using mexplus::OutputArguments;
+
+namespace {
+
+/** Owns the arrays of a right-hand side.
+ */
+class Arguments {
+ public:
+  ~Arguments() {
+    for (size_t i = 0; i < arrays_.size(); ++i)
+      mxDestroyArray(arrays_[i]);
+  }
+  template <typename T>
+  void add(const T& value) { arrays_.push_back(MxArray::from(value)); }
+  int size() const { return static_cast<int>(arrays_.size()); }
+  const mxArray** data() {
+    rhs_.assign(arrays_.begin(), arrays_.end());
+    return rhs_.data();
+  }
+
+ private:
+  vector<mxArray*> arrays_;
+  vector<const mxArray*> rhs_;
+};
+
+void BM_InputsMandatory(benchmark::State& state) {
+  Arguments rhs;
+  rhs.add(3.2);
+  rhs.add(string("text"));
+  const mxArray** prhs = rhs.data();
+  for (auto _ : state) {
+    InputArguments input(rhs.size(), prhs, 2);
+    benchmark::DoNotOptimize(input.get<double>(0));
+  }
+}
+BENCHMARK(BM_InputsMandatory);
+
+void BM_InputsOptions(benchmark::State& state) {
+  Arguments rhs;
+  rhs.add(3.2);
+  rhs.add(string("text"));
+  rhs.add(string("Option2"));
+  rhs.add(string("value"));
+  rhs.add(string("Option1"));
+  rhs.add(10.0);
+  const mxArray** prhs = rhs.data();
+  for (auto _ : state) {
+    InputArguments input(rhs.size(), prhs, 2, 3, "Option1", "Option2",
+                         "Option3");
+    benchmark::DoNotOptimize(input.get<double>("Option1", -1.0));
+    benchmark::DoNotOptimize(input.get<int>("Option3", 0));
+  }
+}
+BENCHMARK(BM_InputsOptions);
+
+void BM_InputsMultipleFormats(benchmark::State& state) {
+  Arguments rhs;
+  rhs.add(3.2);
+  rhs.add(string("text"));
+  rhs.add(1.0);
+  const mxArray** prhs = rhs.data();
+  for (auto _ : state) {
+    InputArguments input;
+    input.define("one", 1);
+    input.define("two", 2, 1, "Option");
+    input.define("three", 3);
+    input.parse(rhs.size(), prhs);
+    benchmark::DoNotOptimize(input.is("three"));
+  }
+}
+BENCHMARK(BM_InputsMultipleFormats);
+
+void BM_OutputsSet(benchmark::State& state) {
+  vector<mxArray*> lhs(2, static_cast<mxArray*>(NULL));
+  for (auto _ : state) {
+    OutputArguments output(lhs.size(), lhs.data(), 2);
+    output.set(0, 1.0);
+    output.set(1, string("text"));
+    mxDestroyArray(lhs[0]);
+    mxDestroyArray(lhs[1]);
+  }
+}
+BENCHMARK(BM_OutputsSet);
+
+}  // namespace
+
+BENCHMARK_MAIN();
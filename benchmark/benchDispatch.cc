@@ -0,0 +1,120 @@
+/** MEX_DISPATCH benchmarks.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * Measures the overhead of dispatching mexFunction() calls to operations, and
+ * of Session lookups, against the stand-in runtime.
+ */
+
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+#include "mexplus/dispatch.h"
+#include "mexplus/mxarray.h"
+
+using namespace std;
+using mexplus::MxArray;
+using mexplus::Session;
+
+namespace {
+
+struct Counter {
+  Counter() : count(0) {}
+  double count;
+};
+
+MEX_DEFINE(noop) (int nlhs, mxArray* plhs[],
+                  int nrhs, const mxArray* prhs[]) {
+}
+
+MEX_DEFINE(add) (int nlhs, mxArray* plhs[],
+                 int nrhs, const mxArray* prhs[]) {
+  plhs[0] = mxCreateDoubleScalar(mxGetScalar(prhs[0]) + mxGetScalar(prhs[1]));
+}
+
+MEX_DEFINE(increment) (int nlhs, mxArray* plhs[],
+                       int nrhs, const mxArray* prhs[]) {
+  Session<Counter>::get(prhs[0])->count += 1;
+}
+
+MEX_DEFINE(zzz) (int nlhs, mxArray* plhs[],
+                 int nrhs, const mxArray* prhs[]) {
+}
+
+/** Call mexFunction() and destroy the outputs.
+ */
+void Call(int nlhs, const vector<const mxArray*>& prhs) {
+  mxArray* plhs[1] = {NULL};
+  mexplus::standalone::callMexFunction(
+      nlhs, plhs, prhs.size(), const_cast<const mxArray**>(prhs.data()));
+  if (plhs[0])
+    mxDestroyArray(plhs[0]);
+}
+
+void BM_DispatchNoop(benchmark::State& state) {
+  MxArray name("noop");
+  vector<const mxArray*> prhs(1, name.get());
+  for (auto _ : state)
+    Call(0, prhs);
+}
+BENCHMARK(BM_DispatchNoop);
+
+void BM_DispatchLastOperation(benchmark::State& state) {
+  MxArray name("zzz");
+  vector<const mxArray*> prhs(1, name.get());
+  for (auto _ : state)
+    Call(0, prhs);
+}
+BENCHMARK(BM_DispatchLastOperation);
+
+void BM_DispatchAdd(benchmark::State& state) {
+  MxArray name("add"), x(1.0), y(2.0);
+  vector<const mxArray*> prhs;
+  prhs.push_back(name.get());
+  prhs.push_back(x.get());
+  prhs.push_back(y.get());
+  for (auto _ : state)
+    Call(1, prhs);
+}
+BENCHMARK(BM_DispatchAdd);
+
+void BM_DispatchSession(benchmark::State& state) {
+  intptr_t id = Session<Counter>::create(new Counter);
+  MxArray name("increment"), handle(id);
+  vector<const mxArray*> prhs;
+  prhs.push_back(name.get());
+  prhs.push_back(handle.get());
+  for (auto _ : state)
+    Call(0, prhs);
+  Session<Counter>::destroy(id);
+}
+BENCHMARK(BM_DispatchSession);
+
+void BM_DispatchPipeline(benchmark::State& state) {
+  MxArray steps(MxArray::Cell(1, 2));
+  MxArray first(MxArray::Cell(1, 4));
+  first.set(0, "add");
+  first.set(1, "x");
+  first.set(2, 1.0);
+  first.set(3, 2.0);
+  MxArray second(MxArray::Cell(1, 4));
+  second.set(0, "add");
+  second.set(1, "y");
+  second.set(2, "$x");
+  second.set(3, "$x");
+  steps.set(0, first.release());
+  steps.set(1, second.release());
+  MxArray outputs(vector<string>(1, "y"));
+  vector<const mxArray*> prhs;
+  prhs.push_back(steps.get());
+  prhs.push_back(outputs.get());
+  for (auto _ : state)
+    Call(1, prhs);
+}
+BENCHMARK(BM_DispatchPipeline);
+
+}  // namespace
+
+MEX_DISPATCH
+
+BENCHMARK_MAIN();
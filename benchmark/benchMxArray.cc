@@ -0,0 +1,124 @@
+/** MxArray conversion benchmarks.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ */
+
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+#include "mexplus/mxarray.h"
+
+using namespace std;
+using mexplus::MxArray;
+
+namespace {
+
+void BM_FromDoubleVector(benchmark::State& state) {
+  vector<double> values(state.range(0), 1.0);
+  for (auto _ : state) {
+    MxArray array(values);
+    benchmark::DoNotOptimize(array.get());
+  }
+  state.SetBytesProcessed(state.iterations() * values.size() * sizeof(double));
+}
+BENCHMARK(BM_FromDoubleVector)->Range(1 << 4, 1 << 20);
+
+void BM_ToDoubleVector(benchmark::State& state) {
+  MxArray array(vector<double>(state.range(0), 1.0));
+  vector<double> values;
+  for (auto _ : state) {
+    array.to(&values);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetBytesProcessed(state.iterations() * values.size() * sizeof(double));
+}
+BENCHMARK(BM_ToDoubleVector)->Range(1 << 4, 1 << 20);
+
+void BM_ToFloatVectorFromDouble(benchmark::State& state) {
+  MxArray array(vector<double>(state.range(0), 1.0));
+  vector<float> values;
+  for (auto _ : state) {
+    array.to(&values);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_ToFloatVectorFromDouble)->Range(1 << 4, 1 << 20);
+
+void BM_ElementAccess(benchmark::State& state) {
+  MxArray array(vector<int32_t>(state.range(0), 1));
+  for (auto _ : state) {
+    int64_t total = 0;
+    for (mwIndex i = 0; i < array.size(); ++i)
+      total += array.at<int32_t>(i);
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetItemsProcessed(state.iterations() * array.size());
+}
+BENCHMARK(BM_ElementAccess)->Range(1 << 4, 1 << 16);
+
+void BM_FromString(benchmark::State& state) {
+  string value(state.range(0), 'x');
+  for (auto _ : state) {
+    MxArray array(value);
+    benchmark::DoNotOptimize(array.get());
+  }
+  state.SetItemsProcessed(state.iterations() * value.size());
+}
+BENCHMARK(BM_FromString)->Range(1 << 4, 1 << 16);
+
+void BM_ToString(benchmark::State& state) {
+  MxArray array(string(state.range(0), 'x'));
+  for (auto _ : state) {
+    string value = array.to<string>();
+    benchmark::DoNotOptimize(value.data());
+  }
+  state.SetItemsProcessed(state.iterations() * array.size());
+}
+BENCHMARK(BM_ToString)->Range(1 << 4, 1 << 16);
+
+void BM_FromCellstr(benchmark::State& state) {
+  vector<string> values(state.range(0), "text");
+  for (auto _ : state) {
+    MxArray array(values);
+    benchmark::DoNotOptimize(array.get());
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_FromCellstr)->Range(1 << 4, 1 << 14);
+
+void BM_ToCellstr(benchmark::State& state) {
+  MxArray array(vector<string>(state.range(0), "text"));
+  vector<string> values;
+  for (auto _ : state) {
+    array.to(&values);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_ToCellstr)->Range(1 << 4, 1 << 14);
+
+void BM_StructField(benchmark::State& state) {
+  const char* fields[] = {"x", "y", "z"};
+  MxArray array(MxArray::Struct(3, fields));
+  array.set("x", 1.0);
+  array.set("y", 2.0);
+  array.set("z", 3.0);
+  for (auto _ : state) {
+    double value = array.at<double>("z");
+    benchmark::DoNotOptimize(value);
+  }
+}
+BENCHMARK(BM_StructField);
+
+void BM_Hash(benchmark::State& state) {
+  MxArray array(vector<double>(state.range(0), 1.0));
+  for (auto _ : state)
+    benchmark::DoNotOptimize(array.hash());
+  state.SetBytesProcessed(state.iterations() * array.size() * sizeof(double));
+}
+BENCHMARK(BM_Hash)->Range(1 << 4, 1 << 20);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -42,6 +42,25 @@ methods
     assert(isscalar(this));
     Database_('put', this.id_, key, value);
   end
+
+  function keys = scan(this, chunk_size)
+  %SCAN Get all keys in chunks.
+    assert(isscalar(this));
+    if nargin < 2, chunk_size = 1000; end
+    cursor = Database_('scan', this.id_);
+    chunks = cell(1, 16);
+    count = 0;
+    done = false;
+    while ~done
+      count = count + 1;
+      if count > numel(chunks)
+        chunks{2 * numel(chunks)} = [];
+      end
+      [chunks{count}, done] = Database_('next', cursor, chunk_size);
+    end
+    Database_('close', cursor);
+    keys = [{}, chunks{1:count}];
+  end
 end
 
 methods (Static)
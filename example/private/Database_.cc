@@ -5,11 +5,16 @@
  *
  */
 #include <mexplus.h>
+#include <map>
+#include <memory>
 
 using namespace std;
 using namespace mexplus;
 
 // Hypothetical database class to be MEXed. This example is a proxy to C++ map.
+// Records are ordered by key hash and then by key, so that a query from Matlab
+// is compared against the char array in place, without making a string for the
+// key, and a scan can resume after the last record it returned.
 class Database {
 public:
   // Database constructor. This is a stub.
@@ -18,21 +23,43 @@ public:
   }
   // Database destructor.
   virtual ~Database() {}
-  // Query a record.
-  string query(const string& key) const {
-    mexPrintf("Querying '%s'.\n", key.c_str());
-    map<string, string>::const_iterator record  = records_.find(key);
+  typedef map<pair<size_t, string>, string> Records;
+  typedef Records::key_type Position;
+  typedef Records::const_iterator const_iterator;
+  // Iterate over records.
+  const_iterator begin() const { return records_.begin(); }
+  const_iterator end() const { return records_.end(); }
+  // Get the record after the given position, which need not exist.
+  const_iterator after(const Position& position) const {
+    return records_.upper_bound(position);
+  }
+  // Query a record. Unlike put(), this does not trace the key, as printing
+  // the UTF-16 view would need the very string it avoids making.
+  string query(const MxStringView& key) const {
+    Records::const_iterator record = find(key);
     return (record != records_.end()) ? record->second : "Not Found";
   }
   // Put a record.
   void put(const string& key, const string& value) {
     mexPrintf("Putting '%s':'%s'.\n", key.c_str(), value.c_str());
-    records_.insert(pair<string, string>(key, value));
+    MxStringView::Hash hash;
+    records_.insert(make_pair(make_pair(hash(key), key), value));
   }
 
 private:
+  // Find a record by the key.
+  Records::const_iterator find(const MxStringView& key) const {
+    size_t hash = key.hash();
+    for (Records::const_iterator it =
+             records_.lower_bound(make_pair(hash, string()));
+         it != records_.end() && it->first.first == hash;
+         ++it)
+      if (key == it->first.second)
+        return it;
+    return records_.end();
+  }
   // Database implementation.
-  map<string, string> records_;
+  Records records_;
 };
 
 // Instance manager for Database.
@@ -62,7 +89,7 @@ MEX_DEFINE(query) (int nlhs, mxArray* plhs[],
   InputArguments input(nrhs, prhs, 2);
   OutputArguments output(nlhs, plhs, 1);
   const Database& database = Session<Database>::getConst(input.get(0));
-  output.set(0, database.query(input.get<string>(1)));
+  output.set(0, database.query(input.get<MxStringView>(1)));
 }
 
 // Defines MEX API for set (non const method).
@@ -74,6 +101,34 @@ MEX_DEFINE(put) (int nlhs, mxArray* plhs[],
   database->put(input.get<string>(1), input.get<string>(2));
 }
 
+// Defines MEX API for scan, which returns a cursor over the keys. Instead of
+// copying the keys, the cursor holds the database, so that deleting it does not
+// end the scan, and resumes after the last key it returned, so that a put()
+// between next calls does not invalidate it.
+MEX_DEFINE(scan) (int nlhs, mxArray* plhs[],
+                  int nrhs, const mxArray* prhs[]) {
+  InputArguments input(nrhs, prhs, 1);
+  OutputArguments output(nlhs, plhs, 1);
+  shared_ptr<const Database> database =
+      Session<Database>::getShared(input.get(0));
+  Database::Position last;
+  bool started = false;
+  output.set(0, CursorBase::create(new Cursor<string>(
+      [=](string* key) mutable {
+        Database::const_iterator record =
+            started ? database->after(last) : database->begin();
+        if (record == database->end())
+          return false;
+        last = record->first;
+        started = true;
+        *key = record->first.second;
+        return true;
+      })));
+}
+
+// Defines MEX API for next and close on cursors.
+MEX_DEFINE_CURSOR_OPERATIONS
+
 } // namespace
 
 MEX_DISPATCH // Don't forget to add this if MEX_DEFINE() is used.
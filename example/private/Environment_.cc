@@ -1,6 +1,7 @@
 /** Demonstration of mexplus library.
  *
- * This file demonstrates custom data conversion by template specialization.
+ * This file demonstrates custom data conversion by MEXPLUS_STRUCT() reflection.
+ * See README.md for conversion by template specialization.
  *
  * Note that MEX_DEFINE() macro can appear in multiple files.
  *
@@ -18,30 +19,8 @@ struct Environment {
   string status;
 };
 
-namespace mexplus {
-
-/** Demonstrates custom conversion for write.
- */
-template<>
-mxArray* MxArray::from(const Environment& value) {
-  const char* kFields[] = {"code", "status"};
-  MxArray struct_array(MxArray::Struct(2, kFields));
-  struct_array.set("code", value.code);
-  struct_array.set("status", value.status);
-  return struct_array.release();
-}
-
-/** Demonstrates custom conversion for read.
- */
-template<>
-void MxArray::to(const mxArray* array, Environment* value) {
-  if (!value)
-    mexErrMsgTxt("Null pointer exception.");
-  MxArray::at(array, "code", &value->code);
-  MxArray::at(array, "status", &value->status);
-}
-
-} // namespace mexplus
+// Defines conversion to and from struct('code', ..., 'status', ...).
+MEXPLUS_STRUCT(Environment, code, status)
 
 namespace {
 
@@ -8,6 +8,8 @@ function runDatabase
   database.put('another-key', 'foo');
   value = database.query('another-key');
   disp(value);
+  keys = database.scan();
+  disp(keys);
   clear database;
 
   % Using static methods.
@@ -6,7 +6,19 @@
 #ifndef INCLUDE_MEXPLUS_H_
 #define INCLUDE_MEXPLUS_H_
 
+#include "mexplus/accessor.h"
 #include "mexplus/arguments.h"
+#include "mexplus/arrow.h"
+#include "mexplus/atexit.h"
+#include "mexplus/cache.h"
+#include "mexplus/callback.h"
+#include "mexplus/chunked.h"
+#include "mexplus/cursor.h"
 #include "mexplus/dispatch.h"
+#include "mexplus/dlpack.h"
+#include "mexplus/reflection.h"
+#include "mexplus/resident.h"
+#include "mexplus/shared.h"
+#include "mexplus/stringview.h"
 
 #endif  // INCLUDE_MEXPLUS_H_
@@ -0,0 +1,210 @@
+/** Typed element accessor for numeric, logical and char arrays.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * MxArray::at() and MxArray::set() check the pointer, the bounds, and switch
+ * on the class ID for every element. Accessor resolves the class once at
+ * construction, so a loop over elements costs about the same as a loop over
+ * a raw pointer, while still converting to and from the requested type.
+ *
+ *    Accessor<double> input(prhs[0]);         // Any numeric class.
+ *    MxArray result(MxArray::Numeric<int32_t>(1, input.size()));
+ *    Accessor<double> output(result);
+ *    for (mwIndex i = 0; i < input.size(); ++i)
+ *      output[i] = 2 * input[i];
+ *
+ * Complex arrays are rejected, since only the real part would be visible.
+ *
+ * Bound checks are decided at compile time by the second template argument:
+ * UncheckedAccess, or CheckedAccess that also refuses to write through an
+ * accessor made from a const array. The default is CheckedAccess unless
+ * NDEBUG is defined.
+ */
+
+#ifndef INCLUDE_MEXPLUS_ACCESSOR_H_
+#define INCLUDE_MEXPLUS_ACCESSOR_H_
+
+#include <mex.h>
+#include <cstdint>
+#include <type_traits>
+#include "mexplus/mxarray.h"
+
+namespace mexplus {
+
+/** Accessor policy without checks.
+ */
+struct UncheckedAccess {
+  static void checkIndex(mwIndex, mwSize) {}
+  static void checkWritable(bool) {}
+};
+
+/** Accessor policy with bound and write checks.
+ */
+struct CheckedAccess {
+  static void checkIndex(mwIndex index, mwSize size) {
+    MEXPLUS_ASSERT(index < size,
+                   "Index out of range: %u.",
+                   static_cast<unsigned>(index));
+  }
+  static void checkWritable(bool writable) {
+    MEXPLUS_ASSERT(writable, "Cannot write to a const array.");
+  }
+};
+
+#ifdef NDEBUG
+typedef UncheckedAccess DefaultAccess;
+#else
+typedef CheckedAccess DefaultAccess;
+#endif
+
+/** Element accessor with the class conversion resolved once.
+ */
+template <typename T, typename Policy = DefaultAccess>
+class Accessor {
+ public:
+  static_assert(MxArithmeticType<T>::value ||
+                MxLogicalType<T>::value ||
+                MxCharType<T>::value,
+                "Accessor supports numeric, logical or char types.");
+  /** Proxy to an element for assignment through operator[].
+   */
+  class Reference {
+   public:
+    Reference(const Accessor* accessor, mwIndex index)
+        : accessor_(accessor), index_(index) {}
+    operator T() const { return accessor_->get(index_); }
+    Reference& operator=(const T& value) {
+      accessor_->set(index_, value);
+      return *this;
+    }
+    Reference& operator=(const Reference& other) {
+      return *this = static_cast<T>(other);
+    }
+
+   private:
+    const Accessor* accessor_;
+    mwIndex index_;
+  };
+
+  /** Read and write access to an array.
+   */
+  explicit Accessor(mxArray* array)
+      : data_(NULL),
+        size_(0),
+        direct_(false),
+        writable_(false),
+        read_(NULL),
+        write_(NULL) {
+    resolve(array, true);
+  }
+  explicit Accessor(MxArray& array) : Accessor(array.getMutable()) {}
+  /** Read-only access to an array.
+   */
+  explicit Accessor(const mxArray* array)
+      : data_(NULL),
+        size_(0),
+        direct_(false),
+        writable_(false),
+        read_(NULL),
+        write_(NULL) {
+    resolve(const_cast<mxArray*>(array), false);
+  }
+  explicit Accessor(const MxArray& array) : Accessor(array.get()) {}
+  /** Number of elements.
+   */
+  mwSize size() const { return size_; }
+  /** Return true if T matches the class of the array, i.e. no conversion.
+   */
+  bool isDirect() const { return direct_; }
+  /** Get an element.
+   */
+  T get(mwIndex index) const {
+    Policy::checkIndex(index, size_);
+    return (direct_) ? static_cast<const T*>(data_)[index] :
+                       read_(data_, index);
+  }
+  /** Set an element.
+   */
+  void set(mwIndex index, const T& value) const {
+    Policy::checkWritable(writable_);
+    Policy::checkIndex(index, size_);
+    if (direct_)
+      static_cast<T*>(data_)[index] = value;
+    else
+      write_(data_, index, value);
+  }
+  T operator[](mwIndex index) const { return get(index); }
+  Reference operator[](mwIndex index) { return Reference(this, index); }
+
+ private:
+  typedef T (*ReadFunction)(const void*, mwIndex);
+  typedef void (*WriteFunction)(void*, mwIndex, T);
+
+  #pragma warning( push )
+  #ifdef _MSC_VER
+  #pragma warning( disable: 4244 4800 )
+  #endif
+  template <typename S>
+  static T read(const void* data, mwIndex index) {
+    return static_cast<T>(static_cast<const S*>(data)[index]);
+  }
+  template <typename S>
+  static void write(void* data, mwIndex index, T value) {
+    static_cast<S*>(data)[index] = static_cast<S>(value);
+  }
+  #pragma warning( pop )
+  template <typename S>
+  void bind() {
+    read_ = &read<S>;
+    write_ = &write<S>;
+    direct_ = std::is_same<S, T>::value;
+  }
+  /** Resolve the data pointer and the conversion for the array class.
+   */
+  void resolve(mxArray* array, bool writable) {
+    MEXPLUS_CHECK_NOTNULL(array);
+    MEXPLUS_ASSERT(!mxIsComplex(array), "Cannot access a complex array.");
+    switch (mxGetClassID(array)) {
+      case mxINT8_CLASS:    bind<int8_t>(); break;
+      case mxUINT8_CLASS:   bind<uint8_t>(); break;
+      case mxINT16_CLASS:   bind<int16_t>(); break;
+      case mxUINT16_CLASS:  bind<uint16_t>(); break;
+      case mxINT32_CLASS:   bind<int32_t>(); break;
+      case mxUINT32_CLASS:  bind<uint32_t>(); break;
+      case mxINT64_CLASS:   bind<int64_t>(); break;
+      case mxUINT64_CLASS:  bind<uint64_t>(); break;
+      case mxSINGLE_CLASS:  bind<float>(); break;
+      case mxDOUBLE_CLASS:  bind<double>(); break;
+      case mxLOGICAL_CLASS: bind<mxLogical>(); break;
+      case mxCHAR_CLASS:    bind<mxChar>(); break;
+      default:
+        MEXPLUS_ERROR("Cannot access %s array.", mxGetClassName(array));
+    }
+    data_ = mxGetData(array);
+    size_ = static_cast<mwSize>(mxGetNumberOfElements(array));
+    writable_ = writable;
+  }
+
+  /** Pointer to the real data.
+   */
+  void* data_;
+  /** Number of elements.
+   */
+  mwSize size_;
+  /** True if the element type of the array is T.
+   */
+  bool direct_;
+  /** True if made from a mutable array.
+   */
+  bool writable_;
+  /** Conversion from the element type of the array.
+   */
+  ReadFunction read_;
+  /** Conversion to the element type of the array.
+   */
+  WriteFunction write_;
+};
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_ACCESSOR_H_
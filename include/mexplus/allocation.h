@@ -0,0 +1,227 @@
+/** Allocation policies for array creation.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * Matlab fills a new numeric array with zeros, which is a full extra pass over
+ * memory when every element is overwritten right after. The creation APIs in
+ * mexplus take an AllocationPolicy to choose how the data is allocated.
+ *
+ *    // Data left uninitialized.
+ *    MxArray numeric(MxArray::Numeric<double>(rows, columns, kUninitialized));
+ *
+ *    // Persistent array kept across MEX calls, destroyed by mexplus.
+ *    static mxArray* table = MxArray::Numeric<double>(256, 1, kPersistent);
+ *
+ *    // Scratch array recycled by shape.
+ *    mxArray* scratch = MxArray::Numeric<double>(rows, columns, kPooled);
+ *    mexCallMATLAB(1, &result, 1, &scratch, "fft");
+ *    MxArrayPool::release(scratch);
+ *
+ * Persistent and pooled arrays are owned by MxArrayPool. They must not be
+ * destroyed with mxDestroyArray() or returned to Matlab as an output; return
+ * a copy from mxDuplicateArray() instead. Owned arrays are destroyed by an
+ * ExitHandlers handler when the MEX file is cleared, or earlier by
+ * MxArrayPool::clear(). Only pooled arrays
+ * can be released, and only once per acquisition.
+ *
+ * mxCreateUninitNumericArray() requires Matlab R2015a or later and is missing
+ * in Octave, so kUninitialized is zero-filled unless MEXPLUS_UNINIT_ARRAY is
+ * defined. make.m defines it for Matlab R2015a or later.
+ */
+
+#ifndef INCLUDE_MEXPLUS_ALLOCATION_H_
+#define INCLUDE_MEXPLUS_ALLOCATION_H_
+
+#include <mex.h>
+#include <map>
+#include <utility>
+#include <vector>
+#include "mexplus/atexit.h"
+
+namespace mexplus {
+
+/** How the data of a new array is allocated.
+ */
+enum AllocationPolicy {
+  kZeroFilled,     // Zero-filled and owned by Matlab. Default.
+  kUninitialized,  // Data left uninitialized and owned by Matlab.
+  kPersistent,     // Zero-filled, persistent, and owned by MxArrayPool.
+  kPooled          // Recycled from MxArrayPool, with undefined contents.
+};
+
+inline mxArray* CreateNumericArray(const std::vector<mwSize>& dimensions,
+                                   mxClassID class_id,
+                                   mxComplexity complexity,
+                                   AllocationPolicy policy = kZeroFilled);
+inline mxArray* CreateLogicalArray(const std::vector<mwSize>& dimensions,
+                                   AllocationPolicy policy = kZeroFilled);
+
+/** Owner of persistent and pooled arrays.
+ */
+class MxArrayPool {
+ public:
+  /** Make the array persistent and owned by the pool.
+   */
+  static mxArray* keep(mxArray* array) {
+    return own(array, kKept);
+  }
+  /** Take an array of the given shape, or create a new one if none is free.
+   */
+  static mxArray* acquire(mxClassID class_id,
+                          mxComplexity complexity,
+                          const std::vector<mwSize>& dimensions) {
+    State* state = getState();
+    Key key(std::make_pair(class_id, complexity), dimensions);
+    FreeMap::iterator entry = state->available.find(key);
+    if (entry != state->available.end()) {
+      mxArray* array = entry->second;
+      state->available.erase(entry);
+      state->owned[array] = kAcquired;
+      return array;
+    }
+    return own((class_id == mxLOGICAL_CLASS) ?
+        CreateLogicalArray(dimensions) :
+        CreateNumericArray(dimensions, class_id, complexity, kUninitialized),
+        kAcquired);
+  }
+  /** Return an acquired array to the pool for reuse.
+   */
+  static void release(mxArray* array) {
+    State* state = getState();
+    OwnerMap::iterator owner = state->owned.find(array);
+    if (owner == state->owned.end())
+      mexErrMsgIdAndTxt("mexplus:pool:notOwned",
+                        "Array is not owned by the pool.");
+    if (owner->second == kKept)
+      mexErrMsgIdAndTxt("mexplus:pool:persistent",
+                        "Persistent array cannot be released.");
+    if (owner->second == kAvailable)
+      mexErrMsgIdAndTxt("mexplus:pool:released",
+                        "Array is already released.");
+    owner->second = kAvailable;
+    const mwSize* dimensions = mxGetDimensions(array);
+    Key key(std::make_pair(mxGetClassID(array),
+                           mxIsComplex(array) ? mxCOMPLEX : mxREAL),
+            std::vector<mwSize>(dimensions,
+                                dimensions + mxGetNumberOfDimensions(array)));
+    state->available.insert(std::make_pair(key, array));
+  }
+  /** Destroy an owned array, either kept or acquired.
+   */
+  static void destroy(mxArray* array) {
+    State* state = getState();
+    OwnerMap::iterator owner = state->owned.find(array);
+    if (owner == state->owned.end())
+      return;
+    if (owner->second == kAvailable) {
+      for (FreeMap::iterator it = state->available.begin();
+           it != state->available.end();
+           ++it) {
+        if (it->second == array) {
+          state->available.erase(it);
+          break;
+        }
+      }
+    }
+    state->owned.erase(owner);
+    mxDestroyArray(array);
+  }
+  /** Destroy all owned arrays.
+   */
+  static void clear() { getState()->clear(); }
+  /** Number of owned arrays.
+   */
+  static size_t size() { return getState()->owned.size(); }
+  /** Number of arrays ready for reuse.
+   */
+  static size_t available() { return getState()->available.size(); }
+
+ private:
+  typedef std::pair<std::pair<mxClassID, mxComplexity>,
+                    std::vector<mwSize> > Key;
+  typedef std::multimap<Key, mxArray*> FreeMap;
+  /** Status of an owned array.
+   */
+  enum Status {
+    kKept,      // Persistent, never released.
+    kAcquired,  // Pooled and in use.
+    kAvailable  // Pooled and ready for reuse.
+  };
+  typedef std::map<mxArray*, Status> OwnerMap;
+  /** Owned arrays, destroyed by clear() from the mexAtExit() handler while
+   * the MX API is still valid.
+   */
+  struct State {
+    void clear() {
+      for (OwnerMap::iterator it = owned.begin(); it != owned.end(); ++it)
+        mxDestroyArray(it->first);
+      owned.clear();
+      available.clear();
+    }
+    OwnerMap owned;
+    FreeMap available;
+  };
+  /** Make the array persistent and owned with the given status.
+   */
+  static mxArray* own(mxArray* array, Status status) {
+    if (!array)
+      mexErrMsgIdAndTxt("mexplus:error", "Failed to allocate an array.");
+    mexMakeArrayPersistent(array);
+    getState()->owned[array] = status;
+    ExitHandlers::add(&MxArrayPool::clear);
+    return array;
+  }
+  /** Get static state storage.
+   */
+  static State* getState() {
+    static State state;
+    return &state;
+  }
+};
+
+/** Create a numeric array under the given policy.
+ */
+inline mxArray* CreateNumericArray(const std::vector<mwSize>& dimensions,
+                                   mxClassID class_id,
+                                   mxComplexity complexity,
+                                   AllocationPolicy policy) {
+  mxArray* array = NULL;
+  switch (policy) {
+    case kPooled:
+      return MxArrayPool::acquire(class_id, complexity, dimensions);
+#ifdef MEXPLUS_UNINIT_ARRAY
+    case kUninitialized:
+      array = mxCreateUninitNumericArray(
+          dimensions.size(),
+          const_cast<mwSize*>(dimensions.data()),
+          class_id,
+          complexity);
+      break;
+#endif
+    default:
+      array = mxCreateNumericArray(dimensions.size(),
+                                   dimensions.data(),
+                                   class_id,
+                                   complexity);
+  }
+  if (!array)
+    mexErrMsgIdAndTxt("mexplus:error", "Failed to allocate an array.");
+  return (policy == kPersistent) ? MxArrayPool::keep(array) : array;
+}
+
+/** Create a logical array under the given policy. Matlab has no uninitialized
+ * logical array, so kUninitialized is zero-filled.
+ */
+inline mxArray* CreateLogicalArray(const std::vector<mwSize>& dimensions,
+                                   AllocationPolicy policy) {
+  if (policy == kPooled)
+    return MxArrayPool::acquire(mxLOGICAL_CLASS, mxREAL, dimensions);
+  mxArray* array = mxCreateLogicalArray(dimensions.size(), dimensions.data());
+  if (!array)
+    mexErrMsgIdAndTxt("mexplus:error", "Failed to allocate an array.");
+  return (policy == kPersistent) ? MxArrayPool::keep(array) : array;
+}
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_ALLOCATION_H_
@@ -0,0 +1,98 @@
+/** Allocator on the Matlab memory manager.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * MxAllocator allocates with mxMalloc() and releases with mxFree(), so that a
+ * container built in C++ can hand its buffer to an mxArray without a copy.
+ *
+ *    std::vector<double, MxAllocator<double> > values(rows * columns);
+ *    // Fill in values...
+ *    plhs[0] = MxArray::adopt(std::move(values), {rows, columns});
+ *
+ * Memory from mxMalloc() is freed by Matlab when the MEX function returns,
+ * unless it is adopted by an mxArray returned to Matlab.
+ */
+
+#ifndef INCLUDE_MEXPLUS_ALLOCATOR_H_
+#define INCLUDE_MEXPLUS_ALLOCATOR_H_
+
+#include <mex.h>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+namespace mexplus {
+
+/** STL allocator on mxMalloc() and mxFree().
+ */
+template <typename T>
+class MxAllocator {
+ public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef std::size_t size_type;
+  typedef std::ptrdiff_t difference_type;
+  template <typename U>
+  struct rebind { typedef MxAllocator<U> other; };
+
+  MxAllocator() : adopted_(NULL) {}
+  /** Allocator that leaves the buffer at *adopted to Matlab on deallocate().
+   * MxArray::adopt() moves the container into one to free it.
+   */
+  explicit MxAllocator(const void* const* adopted) : adopted_(adopted) {}
+  template <typename U>
+  MxAllocator(const MxAllocator<U>& allocator)
+      : adopted_(allocator.adopted()) {}
+  /** Allocate uninitialized storage for n elements.
+   */
+  T* allocate(std::size_t n, const void* = NULL) {
+    if (n == 0)
+      return NULL;
+    if (n > max_size())
+      throw std::bad_alloc();
+    void* data = mxMalloc(n * sizeof(T));
+    if (!data)
+      throw std::bad_alloc();
+    return static_cast<T*>(data);
+  }
+  /** Release storage unless the buffer has been adopted by an mxArray.
+   */
+  void deallocate(T* data, std::size_t) {
+    if (adopted_ && *adopted_ == data)
+      return;
+    mxFree(data);
+  }
+  std::size_t max_size() const {
+    return std::numeric_limits<std::size_t>::max() / sizeof(T);
+  }
+  template <typename U, typename... Args>
+  void construct(U* data, Args&&... args) {
+    ::new(static_cast<void*>(data)) U(std::forward<Args>(args)...);
+  }
+  template <typename U>
+  void destroy(U* data) { data->~U(); }
+  const void* const* adopted() const { return adopted_; }
+
+ private:
+  /** Buffer adopted by an mxArray, or NULL.
+   */
+  const void* const* adopted_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const MxAllocator<T>&, const MxAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+inline bool operator!=(const MxAllocator<T>&, const MxAllocator<U>&) {
+  return false;
+}
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_ALLOCATOR_H_
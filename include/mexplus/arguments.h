@@ -36,6 +36,7 @@
 #include <string>
 #include <vector>
 #include "mexplus/mxarray.h"
+#include "mexplus/mxview.h"
 
 namespace mexplus {
 
@@ -375,17 +376,75 @@ class OutputArguments {
                         nlhs,
                         maximum_size);
   }
+  /** Return true if the caller requested the output at the index.
+   */
+  bool wanted(size_t index) const { return index < nlhs_; }
   /** Safely assign mxArray to the output.
    */
   void set(size_t index, mxArray* value) {
-    if (index < nlhs_)
+    if (wanted(index))
       plhs_[index] = value;
   }
-  /** Safely assign T to the output.
+  /** Safely assign T to the output. Nothing is converted if the output is not
+   * requested.
    */
   template <typename T>
   void set(size_t index, const T& value) {
-    set(index, MxArray::from(value));
+    if (wanted(index))
+      plhs_[index] = MxArray::from(value);
+  }
+  /** Assign the result of the function only if the output is requested. The
+   * function takes no argument and returns a convertible value or mxArray*.
+   *
+   * Example:
+   * @code
+   *     output.set(0, labels);
+   *     output.setLazy(1, [&]() { return computeScores(labels); });
+   * @endcode
+   */
+  template <typename Function>
+  void setLazy(size_t index, Function function) {
+    if (wanted(index))
+      set(index, function());
+  }
+  /** Assign a ragged array to a pair of outputs, values and offsets.
+   */
+  template <typename T>
+  void set(size_t values_index,
+           size_t offsets_index,
+           const Ragged<T>& value) {
+    set(values_index, value.values);
+    set(offsets_index, value.offsets);
+  }
+  /** Create a real numeric or logical output and return a view to write
+   * into. The numeric data is left uninitialized. When the output is not
+   * requested by the caller, the view owns a scratch buffer instead.
+   *
+   * Example:
+   * @code
+   *     MxView<double> result = output.allocate<double>(0, {rows, columns});
+   *     for (mwIndex i = 0; i < result.size(); ++i)
+   *       result[i] = ...;
+   * @endcode
+   */
+  template <typename T>
+  MxView<T> allocate(size_t index, const std::vector<mwSize>& dimensions) {
+    if (!wanted(index))
+      return MxView<T>(dimensions);
+    mxArray* array = (MxLogicalType<T>::value) ?
+        CreateLogicalArray(dimensions) :
+        CreateNumericArray(dimensions,
+                           MxTypes<T>::class_id,
+                           mxREAL,
+                           kUninitialized);
+    set(index, array);
+    return MxView<T>(array);
+  }
+  template <typename T>
+  MxView<T> allocate(size_t index, mwSize rows, mwSize columns) {
+    const mwSize dimensions[] = {rows, columns};
+    return allocate<T>(index, std::vector<mwSize>(dimensions,
+                                                  dimensions + 2));
   }
   /** Size of the output.
    */
@@ -0,0 +1,369 @@
+/** Arrow C Data Interface export and import.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * The Arrow C Data Interface is a pair of plain C structs, so no Arrow library
+ * is needed here. Numeric arrays are exported without a copy: the exported
+ * ArrowArray points into the mxArray data and keeps a SharedMxArray reference
+ * until its release callback is called.
+ *
+ *    ArrowArray array;
+ *    ArrowSchema schema;
+ *    ExportArrow(SharedMxArray(MxArray(prhs[0])), &array, &schema);
+ *    auto column = arrow::ImportArray(&array, &schema);  // Takes ownership.
+ *
+ *    plhs[0] = ImportArrow(&array, &schema);  // Releases array and schema.
+ *
+ * An exported column is 1-D in column-major order. Numeric classes map to the
+ * primitive Arrow types, logical to boolean, and a char array or cellstr to
+ * utf8, one string per row or cell. Boolean and utf8 need a converted buffer,
+ * owned by the exported array. Complex arrays are not supported.
+ *
+ * Import copies into buffers from MxAllocator, which the new mxArray adopts,
+ * as an mxArray cannot refer to foreign memory. Numeric and boolean columns
+ * become N-by-1 arrays and utf8 columns become N-by-1 cellstr. Nulls become
+ * NaN in floating-point columns and empty strings in utf8 columns.
+ *
+ * An exported column is valid only for the duration of the MEX call. Matlab
+ * frees the arrays of a call when it returns, whether borrowed from prhs or
+ * owned by the column, so the consumer must release the column before the
+ * MEX function returns. The release callback may destroy the mxArray, and
+ * the MX API is not thread-safe, so it must also be called on the Matlab
+ * thread, not from a thread of the consumer.
+ */
+
+#ifndef INCLUDE_MEXPLUS_ARROW_H_
+#define INCLUDE_MEXPLUS_ARROW_H_
+
+#include <mex.h>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "mexplus/mxarray.h"
+#include "mexplus/shared.h"
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+extern "C" {
+
+struct ArrowSchema {
+  const char* format;
+  const char* name;
+  const char* metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema** children;
+  struct ArrowSchema* dictionary;
+  void (*release)(struct ArrowSchema*);
+  void* private_data;
+};
+
+struct ArrowArray {
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void** buffers;
+  struct ArrowArray** children;
+  struct ArrowArray* dictionary;
+  void (*release)(struct ArrowArray*);
+  void* private_data;
+};
+
+}  // extern "C"
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+namespace mexplus {
+
+/** Private data of an exported ArrowArray.
+ */
+struct ArrowExportData {
+  /** Reference to the exported array.
+   */
+  SharedMxArray array;
+  /** Packed bits or UTF-8 data, when the data is converted.
+   */
+  std::vector<uint8_t> values;
+  /** String offsets.
+   */
+  std::vector<int32_t> offsets;
+  /** Buffer pointers, i.e. validity, data or offsets, and string data.
+   */
+  const void* buffers[3];
+};
+
+/** Release callback of an exported ArrowArray. Call it on the Matlab thread
+ * before the MEX call returns, as it may destroy the mxArray.
+ */
+inline void ReleaseArrowArray(ArrowArray* array) {
+  delete static_cast<ArrowExportData*>(array->private_data);
+  array->private_data = NULL;
+  array->release = NULL;
+}
+
+/** Release callback of an exported ArrowSchema. Strings are static.
+ */
+inline void ReleaseArrowSchema(ArrowSchema* schema) {
+  schema->release = NULL;
+}
+
+/** Arrow format string of the class, or NULL if not supported.
+ */
+inline const char* ArrowFormat(mxClassID class_id) {
+  switch (class_id) {
+    case mxINT8_CLASS:    return "c";
+    case mxUINT8_CLASS:   return "C";
+    case mxINT16_CLASS:   return "s";
+    case mxUINT16_CLASS:  return "S";
+    case mxINT32_CLASS:   return "i";
+    case mxUINT32_CLASS:  return "I";
+    case mxINT64_CLASS:   return "l";
+    case mxUINT64_CLASS:  return "L";
+    case mxSINGLE_CLASS:  return "f";
+    case mxDOUBLE_CLASS:  return "g";
+    case mxLOGICAL_CLASS: return "b";
+    case mxCHAR_CLASS:    return "u";
+    case mxCELL_CLASS:    return "u";
+    default:              return NULL;
+  }
+}
+
+/** Return true if the array is a cell array of char arrays.
+ */
+inline bool IsCellstr(const mxArray* array) {
+  if (!mxIsCell(array))
+    return false;
+  for (size_t i = 0; i < mxGetNumberOfElements(array); ++i) {
+    const mxArray* element = mxGetCell(array, i);
+    if (!element || !mxIsChar(element))
+      return false;
+  }
+  return true;
+}
+
+/** Export a numeric, logical, char, or cellstr array as an Arrow column.
+ * @param array array to export. The column holds a reference to it.
+ * @param output ArrowArray to fill in. The consumer must call its release
+ *     on the Matlab thread before the MEX call returns.
+ * @param schema ArrowSchema to fill in. The consumer must call its release.
+ */
+inline void ExportArrow(const SharedMxArray& array,
+                        ArrowArray* output,
+                        ArrowSchema* schema) {
+  MEXPLUS_CHECK_NOTNULL(array.get());
+  MEXPLUS_CHECK_NOTNULL(output);
+  MEXPLUS_CHECK_NOTNULL(schema);
+  const mxArray* source = array.get();
+  const char* format = ArrowFormat(mxGetClassID(source));
+  MEXPLUS_ASSERT(format && !mxIsComplex(source) &&
+                 (!mxIsCell(source) || IsCellstr(source)),
+                 "Cannot export %s array to Arrow.",
+                 mxGetClassName(source));
+  // Owned here until the release callback takes over.
+  std::unique_ptr<ArrowExportData> data(new ArrowExportData);
+  data->array = array;
+  data->buffers[0] = NULL;
+  data->buffers[1] = NULL;
+  data->buffers[2] = NULL;
+  int64_t length = static_cast<int64_t>(mxGetNumberOfElements(source));
+  int64_t n_buffers = 2;
+  if (mxIsLogical(source)) {
+    const mxLogical* values = mxGetLogicals(source);
+    data->values.assign((length + 7) / 8, 0);
+    for (int64_t i = 0; i < length; ++i)
+      if (values[i])
+        data->values[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+    data->buffers[1] = data->values.data();
+  } else if (format[0] == 'u') {
+    std::vector<std::string> rows;
+    MxArray::to(source, &rows);
+    size_t total = 0;
+    for (size_t i = 0; i < rows.size(); ++i)
+      total += rows[i].size();
+    if (total > static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+      MEXPLUS_ERROR("Too many characters to export: %u.",
+                    static_cast<unsigned>(total));
+    data->offsets.reserve(rows.size() + 1);
+    data->offsets.push_back(0);
+    data->values.reserve(total);
+    for (size_t i = 0; i < rows.size(); ++i) {
+      data->values.insert(data->values.end(), rows[i].begin(), rows[i].end());
+      data->offsets.push_back(static_cast<int32_t>(data->values.size()));
+    }
+    length = static_cast<int64_t>(rows.size());
+    n_buffers = 3;
+    data->buffers[1] = data->offsets.data();
+    data->buffers[2] = data->values.data();
+  } else {
+    data->buffers[1] = mxGetData(source);
+  }
+  output->length = length;
+  output->null_count = 0;
+  output->offset = 0;
+  output->n_buffers = n_buffers;
+  output->n_children = 0;
+  output->buffers = data->buffers;
+  output->children = NULL;
+  output->dictionary = NULL;
+  output->release = &ReleaseArrowArray;
+  output->private_data = data.release();
+  schema->format = format;
+  schema->name = "";
+  schema->metadata = NULL;
+  schema->flags = 0;
+  schema->n_children = 0;
+  schema->children = NULL;
+  schema->dictionary = NULL;
+  schema->release = &ReleaseArrowSchema;
+  schema->private_data = NULL;
+}
+
+/** Export a const array without a copy. The array must outlive the column.
+ */
+inline void ExportArrow(const mxArray* array,
+                        ArrowArray* output,
+                        ArrowSchema* schema) {
+  ExportArrow(SharedMxArray(array), output, schema);
+}
+
+/** Release an imported ArrowArray and ArrowSchema on scope exit.
+ */
+class ArrowImportGuard {
+ public:
+  ArrowImportGuard(ArrowArray* array, ArrowSchema* schema)
+      : array_(array), schema_(schema) {}
+  ~ArrowImportGuard() {
+    if (array_->release)
+      array_->release(array_);
+    if (schema_->release)
+      schema_->release(schema_);
+  }
+
+ private:
+  ArrowArray* array_;
+  ArrowSchema* schema_;
+};
+
+/** Return true if the element is valid in the validity bitmap.
+ */
+inline bool IsArrowValid(const ArrowArray* array, int64_t index) {
+  const uint8_t* validity = static_cast<const uint8_t*>(array->buffers[0]);
+  if (array->null_count == 0 || !validity)
+    return true;
+  index += array->offset;
+  return (validity[index / 8] >> (index % 8)) & 1;
+}
+
+/** Allocate a buffer from MxAllocator and make an N-by-1 array to adopt it.
+ */
+template <typename T>
+mxArray* AdoptArrowBuffer(T** data, int64_t length) {
+  *data = (length > 0) ? MxAllocator<T>().allocate(length) : NULL;
+  std::vector<mwSize> dimensions(2, 1);
+  dimensions[0] = static_cast<mwSize>(length);
+  return MxArray::adopt(*data, dimensions);
+}
+
+/** Import a primitive Arrow column.
+ */
+template <typename T>
+mxArray* ImportArrowNumeric(const ArrowArray* array) {
+  MEXPLUS_ASSERT(array->null_count == 0 ||
+                 std::numeric_limits<T>::has_quiet_NaN,
+                 "Cannot import nulls to an integer array.");
+  const T* values = static_cast<const T*>(array->buffers[1]) + array->offset;
+  T* data;
+  mxArray* output = AdoptArrowBuffer(&data, array->length);
+  if (array->length > 0)
+    std::memcpy(data, values, array->length * sizeof(T));
+  if (array->null_count != 0) {
+    for (int64_t i = 0; i < array->length; ++i)
+      if (!IsArrowValid(array, i))
+        data[i] = std::numeric_limits<T>::quiet_NaN();
+  }
+  return output;
+}
+
+/** Import a boolean Arrow column.
+ */
+inline mxArray* ImportArrowBoolean(const ArrowArray* array) {
+  MEXPLUS_ASSERT(array->null_count == 0,
+                 "Cannot import nulls to a logical array.");
+  const uint8_t* values = static_cast<const uint8_t*>(array->buffers[1]);
+  mxLogical* data;
+  mxArray* output = AdoptArrowBuffer(&data, array->length);
+  for (int64_t i = 0; i < array->length; ++i) {
+    int64_t index = i + array->offset;
+    data[i] = (values[index / 8] >> (index % 8)) & 1;
+  }
+  return output;
+}
+
+/** Import a utf8 or large utf8 Arrow column.
+ */
+template <typename Offset>
+mxArray* ImportArrowString(const ArrowArray* array) {
+  const Offset* offsets = static_cast<const Offset*>(array->buffers[1]) +
+                          array->offset;
+  const char* values = static_cast<const char*>(array->buffers[2]);
+  MxArray cell(MxArray::Cell(static_cast<int>(array->length), 1));
+  for (int64_t i = 0; i < array->length; ++i) {
+    std::string value;
+    if (IsArrowValid(array, i))
+      value.assign(values + offsets[i], values + offsets[i + 1]);
+    cell.set(static_cast<mwIndex>(i), value);
+  }
+  return cell.release();
+}
+
+/** Import an Arrow column. The array and the schema are released.
+ * @param array ArrowArray of a primitive, boolean, or utf8 column.
+ * @param schema ArrowSchema of the column.
+ * @return Unmanaged mxArray*. Always caller must destroy.
+ */
+inline mxArray* ImportArrow(ArrowArray* array, ArrowSchema* schema) {
+  MEXPLUS_CHECK_NOTNULL(array);
+  MEXPLUS_CHECK_NOTNULL(schema);
+  MEXPLUS_ASSERT(array->release && schema->release,
+                 "Arrow array is already released.");
+  ArrowImportGuard guard(array, schema);
+  MEXPLUS_ASSERT(array->n_children == 0 && !array->dictionary,
+                 "Cannot import a nested or dictionary Arrow array.");
+  const char* format = schema->format;
+  MEXPLUS_CHECK_NOTNULL(format);
+  MEXPLUS_ASSERT(format[0] != '\0' && format[1] == '\0',
+                 "Unsupported Arrow format: %s.",
+                 format);
+  switch (format[0]) {
+    case 'c': return ImportArrowNumeric<int8_t>(array);
+    case 'C': return ImportArrowNumeric<uint8_t>(array);
+    case 's': return ImportArrowNumeric<int16_t>(array);
+    case 'S': return ImportArrowNumeric<uint16_t>(array);
+    case 'i': return ImportArrowNumeric<int32_t>(array);
+    case 'I': return ImportArrowNumeric<uint32_t>(array);
+    case 'l': return ImportArrowNumeric<int64_t>(array);
+    case 'L': return ImportArrowNumeric<uint64_t>(array);
+    case 'f': return ImportArrowNumeric<float>(array);
+    case 'g': return ImportArrowNumeric<double>(array);
+    case 'b': return ImportArrowBoolean(array);
+    case 'u': return ImportArrowString<int32_t>(array);
+    case 'U': return ImportArrowString<int64_t>(array);
+    default:
+      MEXPLUS_ERROR("Unsupported Arrow format: %s.", format);
+  }
+  return NULL;
+}
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_ARROW_H_
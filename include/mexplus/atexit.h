@@ -0,0 +1,64 @@
+/** Exit handlers run when the MEX file is cleared.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * Arrays kept across MEX calls must be destroyed while the MX API is still
+ * valid, i.e., in the function registered by mexAtExit(), not in a static
+ * destructor while the MEX file is unloading. Matlab keeps only one such
+ * function per MEX file, so mexplus chains its handlers behind one.
+ *
+ *    void closeLibrary() { ... }
+ *    ExitHandlers::add(closeLibrary);  // Instead of mexAtExit(closeLibrary).
+ *
+ * Handlers run once, in the reverse order of registration. A direct call to
+ * mexAtExit() replaces the chain, so use ExitHandlers::add() instead.
+ */
+
+#ifndef INCLUDE_MEXPLUS_ATEXIT_H_
+#define INCLUDE_MEXPLUS_ATEXIT_H_
+
+#include <mex.h>
+#include <algorithm>
+#include <vector>
+
+namespace mexplus {
+
+/** Chain of functions called from the mexAtExit() handler.
+ */
+class ExitHandlers {
+ public:
+  typedef void (*Handler)(void);
+
+  /** Register a handler. A handler already registered is not added again.
+   */
+  static void add(Handler handler) {
+    std::vector<Handler>* handlers = getHandlers();
+    if (std::find(handlers->begin(), handlers->end(), handler) !=
+        handlers->end())
+      return;
+    handlers->push_back(handler);
+    mexAtExit(&ExitHandlers::run);
+  }
+  /** Call and unregister all handlers.
+   */
+  static void run(void) {
+    std::vector<Handler>* handlers = getHandlers();
+    while (!handlers->empty()) {
+      Handler handler = handlers->back();
+      handlers->pop_back();
+      handler();
+    }
+  }
+
+ private:
+  /** Get static handler storage.
+   */
+  static std::vector<Handler>* getHandlers() {
+    static std::vector<Handler> handlers;
+    return &handlers;
+  }
+};
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_ATEXIT_H_
@@ -0,0 +1,357 @@
+/** Memoized MEX operations keyed by input content.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * MEX_DEFINE_CACHED() defines an operation like MEX_DEFINE(), but keeps its
+ * outputs in a bounded LRU cache keyed by the content hash of the inputs.
+ * When the same inputs come again, the body does not run and the outputs are
+ * duplicated from the cache. Use it only for pure functions.
+ *
+ *    MEX_DEFINE_CACHED(solve, 256 << 20) (int nlhs, mxArray* plhs[],
+ *                                         int nrhs, const mxArray* prhs[]) {
+ *      // Runs only on a cache miss.
+ *    }
+ *
+ *    MEX_DEFINE(cacheStatistics) (int nlhs, mxArray* plhs[],
+ *                                 int nrhs, const mxArray* prhs[]) {
+ *      plhs[0] = OperationCache::statistics();
+ *    }
+ *
+ *    MEX_DEFINE(clearCache) (int nlhs, mxArray* plhs[],
+ *                            int nrhs, const mxArray* prhs[]) {
+ *      OperationCache::invalidateAll();
+ *    }
+ *
+ * The capacity is in bytes of cached outputs. Outputs larger than the capacity
+ * are not cached. Cached arrays are persistent and destroyed on eviction,
+ * invalidation, or by an ExitHandlers handler when the MEX file is cleared.
+ * Keys are 64-bit hashes of the inputs and the number of outputs, see
+ * HashArray(). Each entry also keeps a second hash with an independent seed,
+ * computed in the same pass over the inputs, and a lookup whose second hash
+ * differs is a miss, so that a collision of keys does not return the outputs
+ * of other inputs. Inputs are not compared otherwise. A call with an input
+ * that cannot be hashed, e.g., a function handle or an object, always runs
+ * the body and is not cached.
+ */
+
+#ifndef INCLUDE_MEXPLUS_CACHE_H_
+#define INCLUDE_MEXPLUS_CACHE_H_
+
+#include <mex.h>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "mexplus/atexit.h"
+#include "mexplus/dispatch.h"
+#include "mexplus/hash.h"
+
+namespace mexplus {
+
+/** Seed of the second hash that confirms a cache hit.
+ */
+const uint64_t kCacheCheckSeed = 0x9E3779B97F4A7C15ULL;
+
+/** LRU cache of operation outputs.
+ */
+class OperationCache {
+ public:
+  /** Create an empty cache.
+   * @param capacity maximum bytes of cached outputs.
+   */
+  explicit OperationCache(size_t capacity)
+      : capacity_(capacity), bytes_(0), hits_(0), misses_(0) {}
+  virtual ~OperationCache() { clear(); }
+  /** Get the cache of the named operation, created on first use.
+   */
+  static OperationCache* get(const std::string& name, size_t capacity) {
+    CacheMap* caches = getCaches();
+    CacheMap::iterator it = caches->find(name);
+    if (it == caches->end()) {
+      it = caches->insert(std::make_pair(
+          name,
+          std::shared_ptr<OperationCache>(new OperationCache(capacity)))).first;
+      ExitHandlers::add(&OperationCache::invalidateAll);
+    }
+    return it->second.get();
+  }
+  /** Return true if all the inputs can be hashed. A NULL input, i.e., a value
+   * published in a Pipeline, has no content to hash.
+   */
+  static bool cacheable(int nrhs, const mxArray* prhs[]) {
+    for (int i = 0; i < nrhs; ++i)
+      if (!prhs[i] || !IsHashable(prhs[i]))
+        return false;
+    return true;
+  }
+  /** Compute the key of the call and its second hash with kCacheCheckSeed,
+   * both in a single pass over the inputs.
+   */
+  static void key(int nlhs,
+                  int nrhs,
+                  const mxArray* prhs[],
+                  uint64_t* key,
+                  uint64_t* check) {
+    const uint64_t seeds[2] = {0, kCacheCheckSeed};
+    std::vector<uint64_t> keys, checks;
+    keys.reserve(nrhs + 2);
+    checks.reserve(nrhs + 2);
+    keys.push_back(static_cast<uint64_t>(nlhs));
+    keys.push_back(static_cast<uint64_t>(nrhs));
+    checks.assign(keys.begin(), keys.end());
+    for (int i = 0; i < nrhs; ++i) {
+      uint64_t hashes[2];
+      HashArray(prhs[i], seeds, hashes);
+      keys.push_back(hashes[0]);
+      checks.push_back(hashes[1]);
+    }
+    *key = XXHash64::hash(keys.data(), keys.size() * sizeof(uint64_t),
+                          seeds[0]);
+    *check = XXHash64::hash(checks.data(), checks.size() * sizeof(uint64_t),
+                            seeds[1]);
+  }
+  /** Duplicate cached outputs into plhs. Return false on a miss, including
+   * an entry of the same key whose second hash differs.
+   */
+  bool lookup(uint64_t key, uint64_t check, int nlhs, mxArray* plhs[]) {
+    EntryMap::iterator it = index_.find(key);
+    if (it == index_.end() || it->second->check != check) {
+      ++misses_;
+      return false;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    const std::vector<mxArray*>& outputs = it->second->outputs;
+    for (size_t i = 0; i < outputs.size() && i < static_cast<size_t>(nlhs);
+         ++i)
+      plhs[i] = (outputs[i]) ? mxDuplicateArray(outputs[i]) : NULL;
+    ++hits_;
+    return true;
+  }
+  /** Store duplicates of the outputs, evicting least recently used entries.
+   * An entry of the same key with a different second hash is replaced.
+   */
+  void store(uint64_t key, uint64_t check, int nlhs, mxArray* plhs[]) {
+    EntryMap::iterator it = index_.find(key);
+    if (it != index_.end()) {
+      if (it->second->check == check)
+        return;
+      evict(it->second);
+    }
+    size_t bytes = 0;
+    for (int i = 0; i < nlhs; ++i)
+      bytes += (plhs[i]) ? ArrayBytes(plhs[i]) : 0;
+    if (bytes > capacity_)
+      return;
+    while (bytes_ + bytes > capacity_ && !entries_.empty())
+      evict(--entries_.end());
+    entries_.push_front(Entry());
+    Entry& entry = entries_.front();
+    entry.key = key;
+    entry.check = check;
+    entry.bytes = bytes;
+    for (int i = 0; i < nlhs; ++i) {
+      mxArray* output = (plhs[i]) ? mxDuplicateArray(plhs[i]) : NULL;
+      if (output)
+        mexMakeArrayPersistent(output);
+      entry.outputs.push_back(output);
+    }
+    index_[key] = entries_.begin();
+    bytes_ += bytes;
+  }
+  /** Destroy all cached outputs. Counters are kept.
+   */
+  void clear() {
+    while (!entries_.empty())
+      evict(entries_.begin());
+  }
+  size_t capacity() const { return capacity_; }
+  size_t bytes() const { return bytes_; }
+  size_t size() const { return entries_.size(); }
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+  /** Clear the cache of the named operation.
+   */
+  static void invalidate(const std::string& name) {
+    CacheMap* caches = getCaches();
+    CacheMap::iterator it = caches->find(name);
+    if (it != caches->end())
+      it->second->clear();
+  }
+  /** Clear all caches.
+   */
+  static void invalidateAll() {
+    CacheMap* caches = getCaches();
+    for (CacheMap::iterator it = caches->begin(); it != caches->end(); ++it)
+      it->second->clear();
+  }
+  /** Struct array of name, hits, misses, entries, bytes, and capacity for
+   * each cached operation.
+   * @return Unmanaged mxArray*. Always caller must destroy.
+   */
+  static mxArray* statistics() {
+    CacheMap* caches = getCaches();
+    const char* fields[] = {"name", "hits", "misses", "entries", "bytes",
+                            "capacity"};
+    mxArray* array = mxCreateStructMatrix(1, caches->size(), 6, fields);
+    mwIndex index = 0;
+    for (CacheMap::iterator it = caches->begin(); it != caches->end(); ++it) {
+      const OperationCache& cache = *it->second;
+      mxSetFieldByNumber(array, index, 0,
+                         mxCreateString(it->first.c_str()));
+      mxSetFieldByNumber(array, index, 1,
+                         mxCreateDoubleScalar(cache.hits()));
+      mxSetFieldByNumber(array, index, 2,
+                         mxCreateDoubleScalar(cache.misses()));
+      mxSetFieldByNumber(array, index, 3,
+                         mxCreateDoubleScalar(cache.size()));
+      mxSetFieldByNumber(array, index, 4,
+                         mxCreateDoubleScalar(cache.bytes()));
+      mxSetFieldByNumber(array, index, 5,
+                         mxCreateDoubleScalar(cache.capacity()));
+      ++index;
+    }
+    return array;
+  }
+  /** Approximate bytes of array data, including nested arrays.
+   */
+  static size_t ArrayBytes(const mxArray* array) {
+    if (!array)
+      return 0;
+    size_t size = mxGetNumberOfElements(array);
+    size_t bytes = 0;
+    if (mxIsCell(array)) {
+      for (size_t i = 0; i < size; ++i)
+        bytes += ArrayBytes(mxGetCell(array, i));
+    } else if (mxIsStruct(array)) {
+      int fields = mxGetNumberOfFields(array);
+      for (size_t i = 0; i < size; ++i)
+        for (int j = 0; j < fields; ++j)
+          bytes += ArrayBytes(mxGetFieldByNumber(array, i, j));
+    } else {
+      if (mxIsSparse(array)) {
+        size = mxGetNzmax(array);
+        bytes += (size + mxGetN(array) + 1) * sizeof(mwIndex);
+      }
+      bytes += size * mxGetElementSize(array) * (mxIsComplex(array) ? 2 : 1);
+    }
+    return bytes;
+  }
+
+ private:
+  /** Cached outputs of a call.
+   */
+  struct Entry {
+    uint64_t key;
+    /** Hash of the same inputs with kCacheCheckSeed.
+     */
+    uint64_t check;
+    size_t bytes;
+    std::vector<mxArray*> outputs;
+  };
+  typedef std::list<Entry> EntryList;
+  typedef std::unordered_map<uint64_t, EntryList::iterator> EntryMap;
+  typedef std::map<std::string, std::shared_ptr<OperationCache> > CacheMap;
+
+  /** Prohibit copy.
+   */
+  OperationCache(const OperationCache&);
+  OperationCache& operator=(const OperationCache&);
+  /** Destroy an entry.
+   */
+  void evict(EntryList::iterator entry) {
+    for (size_t i = 0; i < entry->outputs.size(); ++i)
+      if (entry->outputs[i])
+        mxDestroyArray(entry->outputs[i]);
+    bytes_ -= entry->bytes;
+    index_.erase(entry->key);
+    entries_.erase(entry);
+  }
+  /** Get static cache storage.
+   */
+  static CacheMap* getCaches() {
+    static CacheMap caches;
+    return &caches;
+  }
+
+  /** Maximum bytes of cached outputs.
+   */
+  size_t capacity_;
+  /** Bytes of cached outputs.
+   */
+  size_t bytes_;
+  uint64_t hits_;
+  uint64_t misses_;
+  /** Entries in the most recently used order.
+   */
+  EntryList entries_;
+  /** Key to entry.
+   */
+  EntryMap index_;
+};
+
+/** Operation that runs compute() only on a cache miss.
+ */
+class CachedOperation : public Operation {
+ public:
+  CachedOperation(const char* name, size_t capacity)
+      : cache_(OperationCache::get(name, capacity)) {}
+  virtual ~CachedOperation() {}
+  virtual void operator()(int nlhs,
+                          mxArray *plhs[],
+                          int nrhs,
+                          const mxArray *prhs[]) {
+    if (!OperationCache::cacheable(nrhs, prhs)) {
+      compute(nlhs, plhs, nrhs, prhs);
+      return;
+    }
+    // Matlab accepts the first output even when nlhs is 0.
+    int outputs = (nlhs > 0) ? nlhs : 1;
+    uint64_t key, check;
+    OperationCache::key(outputs, nrhs, prhs, &key, &check);
+    if (cache_->lookup(key, check, outputs, plhs))
+      return;
+    compute(nlhs, plhs, nrhs, prhs);
+    cache_->store(key, check, outputs, plhs);
+  }
+  /** Implementation of the operation.
+   */
+  virtual void compute(int nlhs,
+                       mxArray *plhs[],
+                       int nrhs,
+                       const mxArray *prhs[]) = 0;
+
+ private:
+  OperationCache* cache_;
+};
+
+}  // namespace mexplus
+
+/** Define a MEX API function memoized by the input content. Example:
+ *
+ * MEX_DEFINE_CACHED(myfunc, 64 << 20) (int nlhs, mxArray *plhs[],
+ *                                      int nrhs, const mxArray *prhs[]) {
+ *   ...
+ * }
+ */
+#define MEX_DEFINE_CACHED(name, capacity) \
+class Operation_##name : public mexplus::CachedOperation { \
+ public: \
+  Operation_##name() : mexplus::CachedOperation(#name, capacity) {} \
+  virtual void compute(int nlhs, \
+                       mxArray *plhs[], \
+                       int nrhs, \
+                       const mxArray *prhs[]); \
+ private: \
+  static bool Operation_Admitter(const std::string& func) { \
+    return func == #name;\
+  } \
+  static const mexplus::OperationCreatorImpl<Operation_##name> creator_; \
+}; \
+const mexplus::OperationCreatorImpl<Operation_##name> \
+    Operation_##name::creator_(Operation_##name::Operation_Admitter, NULL); \
+void Operation_##name::compute
+
+#endif  // INCLUDE_MEXPLUS_CACHE_H_
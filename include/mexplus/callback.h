@@ -0,0 +1,356 @@
+/** Matlab function handle wrapper with batched calls.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * Callback calls a function_handle argument through feval with C++ arguments
+ * and result. Vectors are passed as columns. Each call passes new argument
+ * arrays unless reuse is enabled in the constructor, in which case the
+ * argument arrays are kept between calls and refilled in place when the
+ * class and size match, which saves the allocation for scalar and vector
+ * arguments.
+ *
+ * Enable reuse only when the function does not keep its arguments. If the
+ * function stores an argument, e.g., in a history buffer, a closure, or a
+ * global variable, Matlab holds a shared-data copy of the array, and the next
+ * call or flush() silently overwrites the stored value.
+ *
+ *    Callback<double(vector<double>)> objective(prhs[0]);
+ *    double value = objective(x);
+ *
+ * Each feval pays the interpreter overhead, so invocations can be buffered
+ * and sent in one feval. In the cell mode, each argument is a 1-by-N cell
+ * array. In the stacked mode, scalars become a 1-by-N row and vectors become
+ * the columns of an M-by-N matrix. The function returns either a 1-by-N cell
+ * array or an array whose elements split evenly into N results, column-wise.
+ *
+ *    Callback<double(vector<double>)> objective(prhs[0], kStackedBatch);
+ *    for (size_t i = 0; i < candidates.size(); ++i)
+ *      objective.push(candidates[i]);
+ *    vector<double> values = objective.flush();  // One feval.
+ *
+ * With the stacked mode above, the Matlab side is vectorized over columns,
+ * e.g. @(X) sum(X.^2, 1).
+ */
+
+#ifndef INCLUDE_MEXPLUS_CALLBACK_H_
+#define INCLUDE_MEXPLUS_CALLBACK_H_
+
+#include <mex.h>
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+#include "mexplus/mxarray.h"
+
+namespace mexplus {
+
+/** How buffered invocations are passed to the function.
+ */
+enum CallbackBatch {
+  kCellBatch,     // Each argument as a 1-by-N cell array.
+  kStackedBatch   // Each argument stacked along the columns.
+};
+
+template <size_t... Indices>
+struct CallbackIndices {};
+
+template <size_t N, size_t... Indices>
+struct MakeCallbackIndices : MakeCallbackIndices<N - 1, N - 1, Indices...> {};
+
+template <size_t... Indices>
+struct MakeCallbackIndices<0, Indices...> {
+  typedef CallbackIndices<Indices...> type;
+};
+
+template <typename Signature>
+class Callback;
+
+/** Function handle wrapper for the signature R(Args...).
+ */
+template <typename R, typename... Args>
+class Callback<R(Args...)> {
+ public:
+  static_assert(!std::is_void<R>::value, "Callback must return a value.");
+  typedef typename MakeCallbackIndices<sizeof...(Args)>::type Indices;
+
+  /** Wrap a function handle.
+   * @param handle function_handle array, e.g. prhs[0].
+   * @param batch how buffered invocations are passed.
+   * @param reuse refill the argument arrays in place between calls. The
+   *     function must not keep its arguments.
+   */
+  explicit Callback(const mxArray* handle,
+                    CallbackBatch batch = kCellBatch,
+                    bool reuse = false)
+      : arguments_(sizeof...(Args) + 1, static_cast<mxArray*>(NULL)),
+        batch_(batch),
+        reuse_(reuse),
+        pending_(0),
+        column_(NULL) {
+    MEXPLUS_CHECK_NOTNULL(handle);
+    MEXPLUS_ASSERT(mxIsClass(handle, "function_handle"),
+                   "Expected a function_handle but %s.",
+                   mxGetClassName(handle));
+    arguments_[0] = const_cast<mxArray*>(handle);
+  }
+  virtual ~Callback() {
+    for (size_t i = 1; i < arguments_.size(); ++i)
+      if (arguments_[i])
+        mxDestroyArray(arguments_[i]);
+    if (column_)
+      mxDestroyArray(column_);
+  }
+  /** Call the function once.
+   */
+  R operator()(const Args&... args) {
+    assignAll(Indices(), args...);
+    MxArray result(feval());
+    return result.to<R>();
+  }
+  /** Buffer an invocation until flush().
+   */
+  void push(const Args&... args) {
+    pushAll(Indices(), args...);
+    ++pending_;
+  }
+  /** Number of buffered invocations.
+   */
+  size_t pending() const { return pending_; }
+  /** Call the function once for the buffered invocations.
+   * @return Results in the order of push().
+   */
+  std::vector<R> flush() {
+    std::vector<R> results;
+    if (pending_ == 0)
+      return results;
+    size_t size = pending_;
+    batchAll(Indices());
+    clearAll(Indices());
+    pending_ = 0;
+    MxArray result(feval());
+    split(result.get(), size, &results);
+    return results;
+  }
+
+ private:
+  /** Prohibit copy.
+   */
+  Callback(const Callback&);
+  Callback& operator=(const Callback&);
+  /** feval(handle, arguments...) with one output.
+   */
+  mxArray* feval() {
+    mxArray* output = NULL;
+    mexCallMATLAB(1, &output, static_cast<int>(arguments_.size()),
+                  arguments_.data(), "feval");
+    MEXPLUS_CHECK_NOTNULL(output);
+    return output;
+  }
+  template <size_t... I>
+  void assignAll(CallbackIndices<I...>, const Args&... args) {
+    int expansion[] = {0, (assign(&arguments_[I + 1], args), 0)...};
+    (void)expansion;
+  }
+  template <size_t... I>
+  void pushAll(CallbackIndices<I...>, const Args&... args) {
+    int expansion[] = {0, (std::get<I>(buffers_).push_back(args), 0)...};
+    (void)expansion;
+  }
+  template <size_t... I>
+  void batchAll(CallbackIndices<I...>) {
+    int expansion[] = {0, (batch(&arguments_[I + 1],
+                                 std::get<I>(buffers_)), 0)...};
+    (void)expansion;
+  }
+  template <size_t... I>
+  void clearAll(CallbackIndices<I...>) {
+    int expansion[] = {0, (std::get<I>(buffers_).clear(), 0)...};
+    (void)expansion;
+  }
+  /** Replace an argument array.
+   */
+  static void replace(mxArray** slot, mxArray* array) {
+    if (*slot)
+      mxDestroyArray(*slot);
+    *slot = array;
+  }
+  /** Reuse a real array of the class and size, or create a new one.
+   */
+  static void reserve(mxArray** slot,
+                      mxClassID class_id,
+                      mwSize rows,
+                      mwSize columns,
+                      bool reuse) {
+    if (reuse && *slot && mxGetClassID(*slot) == class_id &&
+        !mxIsComplex(*slot) &&
+        mxGetM(*slot) == rows && mxGetN(*slot) == columns &&
+        mxGetNumberOfDimensions(*slot) == 2)
+      return;
+    std::vector<mwSize> dimensions(2);
+    dimensions[0] = rows;
+    dimensions[1] = columns;
+    replace(slot, (class_id == mxLOGICAL_CLASS) ?
+        CreateLogicalArray(dimensions) :
+        CreateNumericArray(dimensions, class_id, mxREAL, kUninitialized));
+  }
+  /** Refill a scalar argument in place.
+   */
+  template <typename T>
+  void assign(mxArray** slot, const T& value,
+      typename std::enable_if<MxArithmeticType<T>::value ||
+                              MxLogicalType<T>::value, T>::type* = 0) {
+    reserve(slot, MxTypes<T>::class_id, 1, 1, reuse_);
+    *static_cast<T*>(mxGetData(*slot)) = value;
+  }
+  /** Refill a vector argument in place, as a column.
+   */
+  template <typename T>
+  void assign(mxArray** slot, const T& value,
+      typename std::enable_if<MxArithmeticCompound<T>::value, T>::type* = 0) {
+    typedef typename T::value_type V;
+    reserve(slot, MxTypes<V>::class_id, value.size(), 1, reuse_);
+    std::copy(value.begin(), value.end(), static_cast<V*>(mxGetData(*slot)));
+  }
+  /** Convert other arguments.
+   */
+  template <typename T>
+  void assign(mxArray** slot, const T& value,
+      typename std::enable_if<!MxArithmeticType<T>::value &&
+                              !MxLogicalType<T>::value &&
+                              !MxArithmeticCompound<T>::value,
+                              T>::type* = 0) {
+    replace(slot, MxArray::from(value));
+  }
+  /** Make a batched argument.
+   */
+  template <typename T>
+  void batch(mxArray** slot, const std::vector<T>& values) {
+    if (batch_ == kStackedBatch)
+      stack(slot, values);
+    else
+      cell(slot, values);
+  }
+  /** Make a 1-by-N cell array, reused when enabled and the size matches.
+   */
+  template <typename T>
+  void cell(mxArray** slot, const std::vector<T>& values) {
+    if (!reuse_ || !*slot || !mxIsCell(*slot) || mxGetM(*slot) != 1 ||
+        mxGetN(*slot) != values.size())
+      replace(slot, MxArray::Cell(1, static_cast<int>(values.size())));
+    for (size_t i = 0; i < values.size(); ++i) {
+      mxArray* element = mxGetCell(*slot, i);
+      assign(&element, values[i]);
+      mxSetCell(*slot, i, element);
+    }
+  }
+  /** Stack scalars in a row.
+   */
+  template <typename T>
+  void stack(mxArray** slot, const std::vector<T>& values,
+      typename std::enable_if<MxArithmeticType<T>::value ||
+                              MxLogicalType<T>::value, T>::type* = 0) {
+    reserve(slot, MxTypes<T>::class_id, 1, values.size(), reuse_);
+    std::copy(values.begin(), values.end(), static_cast<T*>(mxGetData(*slot)));
+  }
+  /** Stack vectors as columns.
+   */
+  template <typename T>
+  void stack(mxArray** slot, const std::vector<T>& values,
+      typename std::enable_if<MxArithmeticCompound<T>::value, T>::type* = 0) {
+    typedef typename T::value_type V;
+    mwSize rows = values[0].size();
+    reserve(slot, MxTypes<V>::class_id, rows, values.size(), reuse_);
+    V* data = static_cast<V*>(mxGetData(*slot));
+    for (size_t i = 0; i < values.size(); ++i) {
+      MEXPLUS_ASSERT(values[i].size() == rows,
+                     "Cannot stack vectors of %d and %d elements.",
+                     static_cast<int>(rows),
+                     static_cast<int>(values[i].size()));
+      data = std::copy(values[i].begin(), values[i].end(), data);
+    }
+  }
+  /** Other arguments cannot be stacked.
+   */
+  template <typename T>
+  void stack(mxArray** slot, const std::vector<T>& values,
+      typename std::enable_if<!MxArithmeticType<T>::value &&
+                              !MxLogicalType<T>::value &&
+                              !MxArithmeticCompound<T>::value,
+                              T>::type* = 0) {
+    MEXPLUS_ERROR("Cannot stack %s arguments. Use kCellBatch.",
+                  typeid(T).name());
+  }
+  /** Split the batched result into N values.
+   */
+  void split(const mxArray* result, size_t size, std::vector<R>* results) {
+    results->resize(size);
+    mwSize elements = mxGetNumberOfElements(result);
+    if (mxIsCell(result)) {
+      MEXPLUS_ASSERT(elements == size,
+                     "Expected %d results but %d.",
+                     static_cast<int>(size),
+                     static_cast<int>(elements));
+      for (size_t i = 0; i < size; ++i)
+        MxArray::to(mxGetCell(result, i), &(*results)[i]);
+      return;
+    }
+    MEXPLUS_ASSERT((mxIsNumeric(result) || mxIsLogical(result) ||
+                    mxIsChar(result)) && !mxIsComplex(result) &&
+                   elements % size == 0,
+                   "Cannot split %s result of %d elements into %d.",
+                   mxGetClassName(result),
+                   static_cast<int>(elements),
+                   static_cast<int>(size));
+    mwSize rows = elements / size;
+    size_t bytes = rows * mxGetElementSize(result);
+    reserveColumn(mxGetClassID(result), rows);
+    const char* data = static_cast<const char*>(mxGetData(result));
+    for (size_t i = 0; i < size; ++i) {
+      if (bytes > 0)
+        std::memcpy(mxGetData(column_), data + i * bytes, bytes);
+      MxArray::to(column_, &(*results)[i]);
+    }
+  }
+  /** Reuse the column array used to split results.
+   */
+  void reserveColumn(mxClassID class_id, mwSize rows) {
+    if (class_id == mxCHAR_CLASS) {
+      if (column_ && (!mxIsChar(column_) || mxGetN(column_) != rows)) {
+        mxDestroyArray(column_);
+        column_ = NULL;
+      }
+      if (!column_) {
+        mwSize dimensions[2] = {1, rows};
+        column_ = mxCreateCharArray(2, dimensions);
+        MEXPLUS_CHECK_NOTNULL(column_);
+      }
+      return;
+    }
+    reserve(&column_, class_id, rows, 1, true);
+  }
+
+  /** Function handle followed by the argument arrays.
+   */
+  std::vector<mxArray*> arguments_;
+  /** Batch mode.
+   */
+  CallbackBatch batch_;
+  /** Whether argument arrays are refilled in place.
+   */
+  bool reuse_;
+  /** Buffered arguments.
+   */
+  std::tuple<std::vector<Args>...> buffers_;
+  /** Number of buffered invocations.
+   */
+  size_t pending_;
+  /** Array of one result, reused to split a batched result.
+   */
+  mxArray* column_;
+};
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_CALLBACK_H_
@@ -0,0 +1,281 @@
+/** Chunked conversion of large arrays in bounded memory.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * ChunkedReader converts a numeric, logical, or char array block by block
+ * into a reused buffer, so that a consumer such as a reduction, a hash, or a
+ * file writer never holds the whole converted copy.
+ *
+ *    ChunkedReader<float> reader(prhs[0], 1 << 20);
+ *    while (reader.next())
+ *      file.write(reader.data(), reader.size() * sizeof(float));
+ *
+ *    // Or, with a range-based for loop.
+ *    for (const ChunkedReader<float>::Chunk& chunk :
+ *         ChunkedReader<float>(prhs[0], 1 << 20))
+ *      sum = std::accumulate(chunk.begin(), chunk.end(), sum);
+ *
+ * With prefetch enabled, a worker thread converts the next block into a second
+ * buffer while the consumer processes the current one. The worker only
+ * touches the raw data, never the Matlab API. Each block stays valid until the
+ * next call to next().
+ */
+
+#ifndef INCLUDE_MEXPLUS_CHUNKED_H_
+#define INCLUDE_MEXPLUS_CHUNKED_H_
+
+#include <mex.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "mexplus/mxarray.h"
+
+namespace mexplus {
+
+/** Block-wise converter with optional double-buffered prefetch.
+ */
+template <typename T>
+class ChunkedReader {
+ public:
+  static_assert(MxArithmeticType<T>::value ||
+                MxLogicalType<T>::value ||
+                MxCharType<T>::value,
+                "ChunkedReader supports numeric, logical or char types.");
+  /** Converted block.
+   */
+  struct Chunk {
+    const T* data;
+    mwSize size;
+    mwIndex offset;
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+  };
+  /** Input iterator over the blocks, advancing the reader.
+   */
+  class iterator {
+   public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef Chunk value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const Chunk* pointer;
+    typedef const Chunk& reference;
+
+    explicit iterator(ChunkedReader* reader = NULL) : reader_(reader) {
+      if (reader_ && !reader_->next())
+        reader_ = NULL;
+    }
+    const Chunk& operator*() const { return reader_->chunk_; }
+    const Chunk* operator->() const { return &reader_->chunk_; }
+    iterator& operator++() {
+      if (!reader_->next())
+        reader_ = NULL;
+      return *this;
+    }
+    bool operator==(const iterator& other) const {
+      return reader_ == other.reader_;
+    }
+    bool operator!=(const iterator& other) const {
+      return reader_ != other.reader_;
+    }
+
+   private:
+    ChunkedReader* reader_;
+  };
+
+  /** Create a reader.
+   * @param array numeric, logical, or char array.
+   * @param chunk_size number of elements per block.
+   * @param prefetch convert the next block on a worker thread.
+   */
+  ChunkedReader(const mxArray* array, mwSize chunk_size, bool prefetch = false)
+      : total_(0),
+        chunk_size_(chunk_size),
+        next_offset_(0),
+        prefetch_(prefetch),
+        current_(0),
+        pending_(false),
+        requested_(false),
+        stopping_(false) {
+    MEXPLUS_CHECK_NOTNULL(array);
+    MEXPLUS_ASSERT(chunk_size > 0, "Chunk size must be positive.");
+    switch (mxGetClassID(array)) {
+      case mxINT8_CLASS:    bind<int8_t>(); break;
+      case mxUINT8_CLASS:   bind<uint8_t>(); break;
+      case mxINT16_CLASS:   bind<int16_t>(); break;
+      case mxUINT16_CLASS:  bind<uint16_t>(); break;
+      case mxINT32_CLASS:   bind<int32_t>(); break;
+      case mxUINT32_CLASS:  bind<uint32_t>(); break;
+      case mxINT64_CLASS:   bind<int64_t>(); break;
+      case mxUINT64_CLASS:  bind<uint64_t>(); break;
+      case mxSINGLE_CLASS:  bind<float>(); break;
+      case mxDOUBLE_CLASS:  bind<double>(); break;
+      case mxLOGICAL_CLASS: bind<mxLogical>(); break;
+      case mxCHAR_CLASS:    bind<mxChar>(); break;
+      default:
+        MEXPLUS_ERROR("Cannot convert %s.", mxGetClassName(array));
+    }
+    real_ = mxGetData(array);
+    imaginary_ = mxIsComplex(array) ? mxGetPi(array) : NULL;
+    total_ = static_cast<mwSize>(mxGetNumberOfElements(array));
+    buffers_[0].reset(new T[std::min(chunk_size_, total_)]);
+    if (prefetch_ && total_ > chunk_size_) {
+      buffers_[1].reset(new T[chunk_size_]);
+      worker_ = std::thread(&ChunkedReader::work, this);
+    }
+    chunk_.data = NULL;
+    chunk_.size = 0;
+    chunk_.offset = 0;
+  }
+  ~ChunkedReader() {
+    if (worker_.joinable()) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      condition_.notify_all();
+      worker_.join();
+    }
+  }
+  /** Advance to the next block. Return false after the last block.
+   */
+  bool next() {
+    if (next_offset_ >= total_ && !pending_)
+      return false;
+    if (!worker_.joinable()) {
+      fill(0, next_offset_);
+      current_ = 0;
+    } else {
+      if (!pending_)
+        request(current_, next_offset_);
+      current_ = wait();
+      if (next_offset_ + blockSize(next_offset_) < total_)
+        request(1 - current_,
+                next_offset_ + blockSize(next_offset_));
+    }
+    chunk_.data = buffers_[current_].get();
+    chunk_.size = blockSize(next_offset_);
+    chunk_.offset = next_offset_;
+    next_offset_ += chunk_.size;
+    return true;
+  }
+  /** Current block.
+   */
+  const Chunk& chunk() const { return chunk_; }
+  const T* data() const { return chunk_.data; }
+  mwSize size() const { return chunk_.size; }
+  mwIndex offset() const { return chunk_.offset; }
+  /** Total number of elements.
+   */
+  mwSize total() const { return total_; }
+  iterator begin() { return iterator(this); }
+  iterator end() { return iterator(); }
+
+ private:
+  typedef void (*ConvertFunction)(const void*, const void*, mwIndex, mwSize,
+                                  T*);
+
+  /** Prohibit copy, as the worker refers to this object.
+   */
+  ChunkedReader(const ChunkedReader&);
+  ChunkedReader& operator=(const ChunkedReader&);
+  template <typename S>
+  void bind() {
+    convert_ = &MxArray::convertRangeTo<S, T*>;
+  }
+  mwSize blockSize(mwIndex offset) const {
+    return std::min(chunk_size_, total_ - offset);
+  }
+  void fill(int buffer, mwIndex offset) {
+    convert_(real_, imaginary_, offset, blockSize(offset),
+             buffers_[buffer].get());
+  }
+  /** Ask the worker to convert a block into the buffer.
+   */
+  void request(int buffer, mwIndex offset) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      request_buffer_ = buffer;
+      request_offset_ = offset;
+      requested_ = true;
+      pending_ = true;
+    }
+    condition_.notify_all();
+  }
+  /** Wait for the requested block and return its buffer.
+   */
+  int wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (requested_)
+      condition_.wait(lock);
+    pending_ = false;
+    return request_buffer_;
+  }
+  /** Worker loop.
+   */
+  void work() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      while (!requested_ && !stopping_)
+        condition_.wait(lock);
+      if (stopping_)
+        return;
+      int buffer = request_buffer_;
+      mwIndex offset = request_offset_;
+      lock.unlock();
+      fill(buffer, offset);
+      lock.lock();
+      requested_ = false;
+      condition_.notify_all();
+    }
+  }
+
+  /** Real and imaginary data of the array.
+   */
+  const void* real_;
+  const void* imaginary_;
+  /** Conversion from the element type of the array.
+   */
+  ConvertFunction convert_;
+  /** Number of elements in the array.
+   */
+  mwSize total_;
+  /** Number of elements per block.
+   */
+  mwSize chunk_size_;
+  /** Offset of the block returned by the next call to next().
+   */
+  mwIndex next_offset_;
+  /** True if prefetch is requested.
+   */
+  bool prefetch_;
+  /** Double buffers. Only the first is used without prefetch.
+   */
+  std::unique_ptr<T[]> buffers_[2];
+  /** Index of the buffer in the current chunk.
+   */
+  int current_;
+  /** Current block.
+   */
+  Chunk chunk_;
+  /** True if a block has been requested and not yet waited for.
+   */
+  bool pending_;
+  /** Worker states guarded by mutex_.
+   */
+  bool requested_;
+  bool stopping_;
+  int request_buffer_;
+  mwIndex request_offset_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread worker_;
+};
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_CHUNKED_H_
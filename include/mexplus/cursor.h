@@ -0,0 +1,266 @@
+/** Cursor sessions to return large results in chunks.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * An operation that would return a huge result can instead return a cursor
+ * id. Matlab then pulls the result n items at a time through the reserved
+ * next operation, each chunk converted to a single mxArray, and ends with the
+ * close operation.
+ *
+ *    MEX_DEFINE(scan) (int nlhs, mxArray* plhs[],
+ *                      int nrhs, const mxArray* prhs[]) {
+ *      std::shared_ptr<const Database> database =
+ *          Session<Database>::getShared(prhs[0]);
+ *      string last;
+ *      bool started = false;
+ *      plhs[0] = MxArray::from(CursorBase::create(new Cursor<string>(
+ *          [=](string* value) mutable {
+ *            Database::const_iterator it = started ?
+ *                database->upper_bound(last) : database->begin();
+ *            if (it == database->end())
+ *              return false;
+ *            last = *value = it->first;
+ *            started = true;
+ *            return true;
+ *          })));
+ *    }
+ *
+ *    MEX_DEFINE_CURSOR_OPERATIONS  // Defines next and close.
+ *
+ * The cursor outlives the call, so the generator should own what it reads.
+ * Holding the instance from Session::getShared() keeps it alive after the
+ * session is destroyed, and resuming from the last key of an ordered
+ * container, unlike keeping an iterator, survives a later call modifying it.
+ *
+ * In Matlab,
+ *
+ *    cursor = Database_('scan', id);
+ *    [keys, done] = Database_('next', cursor, 1000);
+ *    Database_('close', cursor);
+ *
+ * With prefetch, a background thread generates the next chunk while Matlab
+ * processes the current one. The generator then runs on that thread, so it
+ * must not call the Matlab API. An exception from the generator on that
+ * thread is rethrown by the next take() or done(). Closing a cursor, or
+ * clearing the cursor sessions, stops the thread and destroys the generator.
+ */
+
+#ifndef INCLUDE_MEXPLUS_CURSOR_H_
+#define INCLUDE_MEXPLUS_CURSOR_H_
+
+#include <mex.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "mexplus/dispatch.h"
+#include "mexplus/mxarray.h"
+
+namespace mexplus {
+
+/** Type-erased cursor kept in Session<CursorBase>.
+ */
+class CursorBase {
+ public:
+  virtual ~CursorBase() {}
+  /** Convert up to the next n items to an mxArray.
+   */
+  virtual mxArray* next(size_t n) = 0;
+  /** Return true if no item is left.
+   */
+  virtual bool done() = 0;
+  /** Keep a cursor in the session storage and return its id.
+   */
+  static intptr_t create(CursorBase* cursor) {
+    return Session<CursorBase>::create(cursor);
+  }
+};
+
+/** Cursor over items produced by a generator.
+ */
+template <typename T>
+class Cursor : public CursorBase {
+ public:
+  /** Generator sets the next item and returns true, or returns false at end.
+   */
+  typedef std::function<bool(T*)> Generator;
+
+  /** Create a cursor.
+   * @param generator item generator.
+   * @param prefetch generate the next chunk on a background thread.
+   */
+  explicit Cursor(const Generator& generator, bool prefetch = false)
+      : generator_(generator),
+        exhausted_(false),
+        requested_(0),
+        stopping_(false) {
+    if (prefetch)
+      worker_ = std::thread(&Cursor::work, this);
+  }
+  virtual ~Cursor() {
+    if (worker_.joinable()) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      condition_.notify_all();
+      worker_.join();
+    }
+  }
+  /** Take up to the next n items. Items that the worker has not generated
+   * yet are generated here once the worker is idle.
+   */
+  std::vector<T> take(size_t n) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (requested_ > 0 && ready_.size() < n && !exhausted_)
+      condition_.wait(lock);
+    rethrow();
+    if (requested_ == 0) {
+      while (ready_.size() < n && !exhausted_)
+        generate(1);
+    }
+    std::vector<T> values;
+    values.reserve(std::min(n, ready_.size()));
+    while (values.size() < n && !ready_.empty()) {
+      values.push_back(ready_.front());
+      ready_.pop_front();
+    }
+    if (worker_.joinable() && !exhausted_ && n > ready_.size() + requested_) {
+      requested_ = n - ready_.size();
+      condition_.notify_all();
+    }
+    return values;
+  }
+  virtual mxArray* next(size_t n) { return MxArray::from(take(n)); }
+  /** Return true if no item is left. This waits only for the first item of
+   * the prefetch, not for the whole chunk.
+   */
+  virtual bool done() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (requested_ > 0 && ready_.empty() && !exhausted_)
+      condition_.wait(lock);
+    rethrow();
+    if (ready_.empty() && !exhausted_)
+      generate(1);
+    return ready_.empty() && exhausted_;
+  }
+
+ private:
+  /** Prohibit copy, as the worker refers to this object.
+   */
+  Cursor(const Cursor&);
+  Cursor& operator=(const Cursor&);
+  /** Generate up to n items into ready_. The caller holds the lock.
+   */
+  void generate(size_t n) {
+    for (size_t i = 0; i < n && !exhausted_; ++i) {
+      T value;
+      if (generator_(&value))
+        ready_.push_back(value);
+      else
+        exhausted_ = true;
+    }
+  }
+  /** Rethrow the exception from the worker, if any. The caller holds the
+   * lock.
+   */
+  void rethrow() {
+    if (error_)
+      std::rethrow_exception(error_);
+  }
+  /** Worker loop. The generator runs without the lock, as the caller never
+   * runs it while requested_ is positive. Each item is announced as soon as
+   * it is ready. An exception ends the cursor and is kept for the caller.
+   */
+  void work() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      while (requested_ == 0 && !stopping_)
+        condition_.wait(lock);
+      if (stopping_)
+        return;
+      while (requested_ > 0 && !exhausted_ && !stopping_) {
+        lock.unlock();
+        T value;
+        bool generated = false;
+        std::exception_ptr error;
+        try {
+          generated = generator_(&value);
+        } catch (...) {
+          error = std::current_exception();
+        }
+        lock.lock();
+        if (error) {
+          error_ = error;
+          exhausted_ = true;
+        } else if (generated) {
+          ready_.push_back(value);
+        } else {
+          exhausted_ = true;
+        }
+        --requested_;
+        condition_.notify_all();
+      }
+      requested_ = 0;
+      condition_.notify_all();
+    }
+  }
+
+  /** Item generator.
+   */
+  Generator generator_;
+  /** Generated items not yet taken.
+   */
+  std::deque<T> ready_;
+  /** True once the generator returned false.
+   */
+  bool exhausted_;
+  /** Exception thrown by the generator on the worker.
+   */
+  std::exception_ptr error_;
+  /** Number of items the worker is asked to generate.
+   */
+  size_t requested_;
+  bool stopping_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread worker_;
+};
+
+}  // namespace mexplus
+
+/** Define the reserved cursor operations. Use once per MEX binary.
+ *
+ * next(id, n) returns up to n items, and true as the second output if the
+ * cursor is exhausted. close(id) destroys the cursor.
+ */
+#define MEX_DEFINE_CURSOR_OPERATIONS \
+MEX_DEFINE(next) (int nlhs, mxArray* plhs[], \
+                  int nrhs, const mxArray* prhs[]) { \
+  if (nrhs != 2 || !mxIsNumeric(prhs[1]) || mxIsEmpty(prhs[1])) \
+    mexErrMsgIdAndTxt("mexplus:cursor:argumentError", \
+                      "Invalid argument: expected a cursor id and n."); \
+  double size = mxGetScalar(prhs[1]); \
+  if (!(size >= 0) || !mxIsFinite(size)) \
+    mexErrMsgIdAndTxt("mexplus:cursor:argumentError", \
+                      "Invalid argument: n must be finite and " \
+                      "nonnegative."); \
+  mexplus::CursorBase* cursor = \
+      mexplus::Session<mexplus::CursorBase>::get(prhs[0]); \
+  plhs[0] = cursor->next(static_cast<size_t>(size)); \
+  if (nlhs > 1) \
+    plhs[1] = mxCreateLogicalScalar(cursor->done()); \
+} \
+MEX_DEFINE(close) (int /* nlhs */, mxArray* /* plhs */[], \
+                   int nrhs, const mxArray* prhs[]) { \
+  if (nrhs != 1) \
+    mexErrMsgIdAndTxt("mexplus:cursor:argumentError", \
+                      "Invalid argument: expected a cursor id."); \
+  mexplus::Session<mexplus::CursorBase>::destroy(prhs[0]); \
+}
+
+#endif  // INCLUDE_MEXPLUS_CURSOR_H_
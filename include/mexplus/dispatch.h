@@ -64,6 +64,12 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <typeinfo>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "mexplus/mxarray.h"
+#include "mexplus/recorder.h"
 
 #ifndef MEXPLUS_AT_EXIT
 #define MEXPLUS_AT_EXIT
@@ -174,6 +180,296 @@ inline void CreateOperation(OperationNameAdmitter* admitter,
   OperationFactory::registry()->insert(std::make_pair(admitter, creator));
 }
 
+/** Graph of operation calls run in one MEX call. Intermediate outputs stay
+ * in the MEX file as symbols and only the requested ones are returned.
+ *
+ *    [z, w] = mylibrary({{'filter', 'y', x}, ...
+ *                        {'reduce', 'z', '$y'}, ...
+ *                        {'count', 'w', '$y', 10}}, {'z', 'w'});
+ *
+ * Each step is a cell {name, outputs, inputs...}, where outputs is a symbol
+ * name or a cellstr of names bound to the outputs of the operation. An input
+ * '$name' refers to a symbol, and '$$text' is the literal string '$text'.
+ * The last argument names the symbols to return.
+ *
+ * A step can hand a C++ value to the next one without converting it to an
+ * mxArray. publish() binds the value to an output of the running step, and
+ * consume() reads an input as the same C++ type. A published value is
+ * converted by MxArray::from() only when it is returned to Matlab.
+ *
+ *    MEX_DEFINE(filter) (int nlhs, mxArray* plhs[],
+ *                        int nrhs, const mxArray* prhs[]) {
+ *      std::shared_ptr<const vector<double> > x =
+ *          Pipeline::consume<vector<double> >(0, prhs);
+ *      vector<double> y = Filter(*x);
+ *      if (!Pipeline::publish(0, std::move(y)))
+ *        plhs[0] = MxArray::from(y);  // Not in a pipeline.
+ *    }
+ *
+ * consume() converts an mxArray input with MxArray::to(), so such a step also
+ * works outside a pipeline. An input bound to a published value is NULL in
+ * prhs, so only steps that read it with consume() can take it.
+ */
+class Pipeline {
+ public:
+  Pipeline() {}
+  /** Destroy the remaining symbols.
+   */
+  ~Pipeline() {
+    for (SymbolMap::iterator it = symbols_.begin(); it != symbols_.end(); ++it)
+      if (it->second.array)
+        mxDestroyArray(it->second.array);
+  }
+  /** Run the steps and return the requested outputs.
+   */
+  void operator()(int nlhs,
+                  mxArray *plhs[],
+                  int nrhs,
+                  const mxArray *prhs[]) {
+    if (nrhs < 1 || nrhs > 2 || !mxIsCell(prhs[0]))
+      mexErrMsgIdAndTxt("mexplus:dispatch:argumentError",
+                        "Invalid pipeline: expected steps and outputs.");
+    for (mwIndex i = 0; i < mxGetNumberOfElements(prhs[0]); ++i)
+      run(mxGetCell(prhs[0], i));
+    std::vector<std::string> outputs;
+    if (nrhs > 1)
+      outputs = getNames(prhs[1]);
+    if (static_cast<size_t>(nlhs) > outputs.size())
+      mexErrMsgIdAndTxt("mexplus:dispatch:argumentError",
+                        "Too many outputs: %d for %d symbols.",
+                        nlhs,
+                        static_cast<int>(outputs.size()));
+    for (int i = 0; i < nlhs || (i == 0 && !outputs.empty()); ++i)
+      plhs[i] = take(outputs[i], outputs, i);
+  }
+  /** Bind a C++ value to an output of the running step. Return false, and
+   * leave the value as is, when no pipeline step is running.
+   * @param index output index of the step.
+   * @param value value to publish, converted by MxArray::from() if returned.
+   */
+  template <typename T>
+  static bool publish(int index, T&& value) {
+    typedef typename std::decay<T>::type Value;
+    Step* step = *getStep();
+    if (!step)
+      return false;
+    if (index < 0 || static_cast<size_t>(index) >= step->outputs.size())
+      mexErrMsgIdAndTxt("mexplus:dispatch:argumentError",
+                        "Invalid pipeline output index: %d.",
+                        index);
+    Symbol& symbol = step->outputs[index];
+    symbol.value = std::make_shared<Value>(std::forward<T>(value));
+    symbol.type = &typeid(Value);
+    symbol.convert = &convert<Value>;
+    return true;
+  }
+  /** Read an input as a C++ value, either as published by an earlier step or
+   * converted from the mxArray by MxArray::to().
+   * @param index input index of the step.
+   * @param prhs inputs of the step.
+   */
+  template <typename T>
+  static std::shared_ptr<const T> consume(int index, const mxArray* prhs[]) {
+    Step* step = *getStep();
+    if (step && index >= 0 &&
+        static_cast<size_t>(index) < step->inputs.size() &&
+        step->inputs[index]) {
+      const Symbol& symbol = *step->inputs[index];
+      if (*symbol.type != typeid(T))
+        mexErrMsgIdAndTxt("mexplus:dispatch:typeError",
+                          "Pipeline input %d has type %s, not %s.",
+                          index + 1,
+                          symbol.type->name(),
+                          typeid(T).name());
+      return std::static_pointer_cast<const T>(symbol.value);
+    }
+    if (!prhs[index])
+      mexErrMsgIdAndTxt("mexplus:dispatch:argumentError",
+                        "Null input %d.",
+                        index + 1);
+    return std::make_shared<T>(MxArray::to<T>(prhs[index]));
+  }
+
+ private:
+  /** Intermediate output, either an mxArray or a published C++ value.
+   */
+  struct Symbol {
+    Symbol() : array(NULL), type(NULL), convert(NULL) {}
+    mxArray* array;
+    std::shared_ptr<const void> value;
+    const std::type_info* type;
+    mxArray* (*convert)(const void* value);
+  };
+  typedef std::map<std::string, Symbol> SymbolMap;
+  /** Published inputs and outputs of the running step.
+   */
+  struct Step {
+    std::vector<const Symbol*> inputs;
+    std::vector<Symbol> outputs;
+  };
+  /** Set the running step for the lifetime of the object.
+   */
+  class StepScope {
+   public:
+    explicit StepScope(Step* step) : previous_(*getStep()) {
+      *getStep() = step;
+    }
+    ~StepScope() { *getStep() = previous_; }
+
+   private:
+    Step* previous_;
+  };
+
+  /** Prohibit copy.
+   */
+  Pipeline(const Pipeline&);
+  Pipeline& operator=(const Pipeline&);
+  /** Run one step {name, outputs, inputs...}.
+   */
+  void run(const mxArray* step) {
+    if (!step || !mxIsCell(step) || mxGetNumberOfElements(step) < 2 ||
+        !mxIsChar(mxGetCell(step, 0)))
+      mexErrMsgIdAndTxt("mexplus:dispatch:argumentError",
+                        "Invalid pipeline step: expected {name, outputs, "
+                        "inputs...}.");
+    std::string name = getString(mxGetCell(step, 0));
+    std::vector<std::string> outputs = getNames(mxGetCell(step, 1));
+    Step published;
+    std::vector<const mxArray*> inputs;
+    std::vector<mxArray*> literals;
+    for (mwIndex i = 2; i < mxGetNumberOfElements(step); ++i) {
+      const Symbol* symbol = NULL;
+      inputs.push_back(resolve(mxGetCell(step, i), &literals, &symbol));
+      published.inputs.push_back(symbol);
+    }
+    published.outputs.resize(outputs.size());
+    std::unique_ptr<Operation> operation(OperationFactory::create(name));
+    if (operation.get() == NULL) {
+      for (size_t i = 0; i < literals.size(); ++i)
+        mxDestroyArray(literals[i]);
+      mexErrMsgIdAndTxt("mexplus:dispatch:argumentError",
+                        "Invalid operation: %s", name.c_str());
+    }
+    std::vector<mxArray*> results(outputs.empty() ? 1 : outputs.size(), NULL);
+    {
+      StepScope scope(&published);
+      (*operation)(static_cast<int>(outputs.size()),
+                   &results[0],
+                   static_cast<int>(inputs.size()),
+                   (inputs.empty()) ? NULL : &inputs[0]);
+    }
+    for (size_t i = 0; i < literals.size(); ++i)
+      mxDestroyArray(literals[i]);
+    for (size_t i = 0; i < results.size(); ++i) {
+      if (i >= outputs.size()) {
+        if (results[i])
+          mxDestroyArray(results[i]);
+        continue;
+      }
+      Symbol& output = published.outputs[i];
+      if (output.value) {
+        if (results[i])
+          mxDestroyArray(results[i]);
+      } else if (!results[i]) {
+        mexErrMsgIdAndTxt("mexplus:dispatch:argumentError",
+                          "Operation %s did not set output %d.",
+                          name.c_str(),
+                          static_cast<int>(i + 1));
+      } else {
+        output.array = results[i];
+      }
+      Symbol& symbol = symbols_[outputs[i]];
+      if (symbol.array)
+        mxDestroyArray(symbol.array);
+      symbol = output;
+    }
+  }
+  /** Resolve an input to a symbol, an escaped string, or itself. A published
+   * symbol resolves to NULL and is set to published.
+   */
+  const mxArray* resolve(const mxArray* input,
+                         std::vector<mxArray*>* literals,
+                         const Symbol** published) {
+    if (!input || !mxIsChar(input) || mxGetNumberOfElements(input) == 0 ||
+        mxGetChars(input)[0] != '$')
+      return input;
+    std::string name = getString(input).substr(1);
+    if (!name.empty() && name[0] == '$') {
+      literals->push_back(mxCreateString(name.c_str()));
+      return literals->back();
+    }
+    SymbolMap::const_iterator it = symbols_.find(name);
+    if (it == symbols_.end())
+      mexErrMsgIdAndTxt("mexplus:dispatch:argumentError",
+                        "Undefined pipeline symbol: %s", name.c_str());
+    if (!it->second.array)
+      *published = &it->second;
+    return it->second.array;
+  }
+  /** Hand over a symbol, or a copy if it is returned again later. A published
+   * value is converted to a new array.
+   */
+  mxArray* take(const std::string& name,
+                const std::vector<std::string>& outputs,
+                size_t index) {
+    SymbolMap::iterator it = symbols_.find(name);
+    if (it == symbols_.end())
+      mexErrMsgIdAndTxt("mexplus:dispatch:argumentError",
+                        "Undefined pipeline symbol: %s", name.c_str());
+    if (!it->second.array)
+      return it->second.convert(it->second.value.get());
+    for (size_t i = index + 1; i < outputs.size(); ++i)
+      if (outputs[i] == name)
+        return mxDuplicateArray(it->second.array);
+    mxArray* array = it->second.array;
+    symbols_.erase(it);
+    return array;
+  }
+  /** Convert a published value to an mxArray.
+   */
+  template <typename T>
+  static mxArray* convert(const void* value) {
+    return MxArray::from(*static_cast<const T*>(value));
+  }
+  /** Get the running step, or NULL outside of a step.
+   */
+  static Step** getStep() {
+    static Step* step = NULL;
+    return &step;
+  }
+  /** Get a symbol name or a cellstr of names.
+   */
+  static std::vector<std::string> getNames(const mxArray* names) {
+    std::vector<std::string> values;
+    if (names && mxIsChar(names)) {
+      if (mxGetNumberOfElements(names) > 0)
+        values.push_back(getString(names));
+    } else if (names && mxIsCell(names)) {
+      for (mwIndex i = 0; i < mxGetNumberOfElements(names); ++i) {
+        const mxArray* name = mxGetCell(names, i);
+        if (!name || !mxIsChar(name))
+          mexErrMsgIdAndTxt("mexplus:dispatch:argumentError",
+                            "Invalid pipeline symbol names.");
+        values.push_back(getString(name));
+      }
+    } else if (names && !mxIsEmpty(names)) {
+      mexErrMsgIdAndTxt("mexplus:dispatch:argumentError",
+                        "Invalid pipeline symbol names.");
+    }
+    return values;
+  }
+  /** Get an ASCII string.
+   */
+  static std::string getString(const mxArray* array) {
+    return std::string(mxGetChars(array),
+                       mxGetChars(array) + mxGetNumberOfElements(array));
+  }
+
+  /** Intermediate outputs by name.
+   */
+  SymbolMap symbols_;
+};
+
 /** Key-value storage to make a stateful MEX function.
  *  \code
  *    #include <mexplus/dispatch.h>
@@ -219,6 +515,7 @@ class Session {
     intptr_t id = reinterpret_cast<intptr_t>(instance);
     instances->insert(std::make_pair(id, std::shared_ptr<T>(instance)));
     mexLock();
+    CallRecorder::get()->created(id);
     return id;
   }
   /** Destroy an instance.
@@ -226,6 +523,7 @@ class Session {
   static void destroy(intptr_t id) {
     getInstances()->erase(id);
     mexUnlock();
+    CallRecorder::get()->destroyed(id);
   }
   static void destroy(const mxArray* pointer) {
     destroy(getIntPointer(pointer));
@@ -252,6 +550,21 @@ class Session {
   static const T& getConst(const mxArray* pointer) {
     return getConst(getIntPointer(pointer));
   }
+  /** Retrieve a shared instance or throw if no instance is found. The
+   * instance outlives destroy() while the pointer is held.
+   */
+  static std::shared_ptr<T> getShared(intptr_t id) {
+    InstanceMap* instances = getInstances();
+    typename InstanceMap::iterator instance = instances->find(id);
+    if (instance == instances->end())
+      mexErrMsgIdAndTxt("mexplus:session:notFound",
+                        "Invalid id %d. Did you create?",
+                        id);
+    return instance->second;
+  }
+  static std::shared_ptr<T> getShared(const mxArray* pointer) {
+    return getShared(getIntPointer(pointer));
+  }
   /** Check if the given id exists.
    */
   static bool exist(intptr_t id) {
@@ -357,12 +670,21 @@ const mexplus::OperationCreatorImpl<Operation_##name> \
     Operation_##name::creator_(admitter, tag); \
 void Operation_##name::operator()
 
-/** Insert a function dispatching code. Use once per MEX binary.
+/** Insert a function dispatching code. Use once per MEX binary. A cell array
+ * as the first argument runs a Pipeline of operations.
  */
 #define MEX_DISPATCH \
 void mexFunction(int nlhs, mxArray *plhs[], \
                  int nrhs, const mxArray *prhs[]) { \
   MEXPLUS_AT_INIT;\
+  mexplus::CallRecording recording(nrhs, prhs); \
+  if (nrhs >= 1 && mxIsCell(prhs[0])) { \
+    mexplus::Pipeline pipeline; \
+    pipeline(nlhs, plhs, nrhs, prhs); \
+    recording.finish("(pipeline)", nlhs); \
+    MEXPLUS_AT_EXIT; \
+    return; \
+  } \
   if (nrhs < 1 || !mxIsChar(prhs[0])) \
     mexErrMsgIdAndTxt("mexplus:dispatch:argumentError", \
                       "Invalid argument: missing operation."); \
@@ -377,6 +699,7 @@ void mexFunction(int nlhs, mxArray *plhs[], \
         "Invalid operation: %s", operation_name.c_str()); \
   } \
   (*operation)(nlhs, plhs, nrhs - 1, prhs + 1); \
+  recording.finish(operation_name, nlhs); \
   MEXPLUS_AT_EXIT; \
 }
 
@@ -0,0 +1,318 @@
+/** DLPack tensor exchange.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * ToDLPack() hands an N-d numeric or logical array to a DLPack consumer
+ * without a copy. The tensor has column-major strides, and its deleter
+ * releases the reference to the array.
+ *
+ *    DLManagedTensor* tensor = ToDLPack(MxArray(prhs[0]));
+ *    model.run(tensor);  // Calls tensor->deleter() when done.
+ *
+ *    plhs[0] = FromDLPack(output_tensor);  // Calls the deleter.
+ *
+ * FromDLPack() takes over the array without a copy when the tensor came from
+ * ToDLPack() and holds the only reference to an owned array, since only then
+ * is the memory known to be from the Matlab allocator. Otherwise the data is
+ * copied in column-major order from any strides.
+ *
+ * A tensor from ToDLPack() is valid only for the duration of the MEX call,
+ * as Matlab frees the arrays of a call when it returns. Its deleter may call
+ * mxDestroyArray(), and the MX API is not thread-safe, so the consumer must
+ * call the deleter on the Matlab thread before the MEX function returns, not
+ * later from a thread pool of its own.
+ *
+ * The types come from the upstream dlpack/dlpack.h, version 0.8 or later,
+ * when it is included first or found on the include path. Otherwise a subset
+ * of the same layout is declared in namespace mexplus, so that it never
+ * clashes with the upstream header. Either way, mexplus::DLManagedTensor
+ * names the type in use. Only CPU tensors of real types are supported.
+ */
+
+#ifndef INCLUDE_MEXPLUS_DLPACK_H_
+#define INCLUDE_MEXPLUS_DLPACK_H_
+
+#include <mex.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "mexplus/allocation.h"
+#include "mexplus/mxarray.h"
+#include "mexplus/shared.h"
+
+#if !defined(DLPACK_DLPACK_H_) && defined(__has_include)
+#if __has_include(<dlpack/dlpack.h>)
+#include <dlpack/dlpack.h>
+#endif
+#endif
+
+namespace mexplus {
+
+#ifdef DLPACK_DLPACK_H_
+
+using ::DLDeviceType;
+using ::DLDevice;
+using ::DLDataTypeCode;
+using ::DLDataType;
+using ::DLTensor;
+using ::DLManagedTensor;
+using ::kDLCPU;
+using ::kDLCUDA;
+using ::kDLCUDAHost;
+using ::kDLInt;
+using ::kDLUInt;
+using ::kDLFloat;
+using ::kDLOpaqueHandle;
+using ::kDLBfloat;
+using ::kDLComplex;
+using ::kDLBool;
+
+#else
+
+typedef enum {
+  kDLCPU = 1,
+  kDLCUDA = 2,
+  kDLCUDAHost = 3,
+} DLDeviceType;
+
+typedef struct {
+  DLDeviceType device_type;
+  int32_t device_id;
+} DLDevice;
+
+typedef enum {
+  kDLInt = 0U,
+  kDLUInt = 1U,
+  kDLFloat = 2U,
+  kDLOpaqueHandle = 3U,
+  kDLBfloat = 4U,
+  kDLComplex = 5U,
+  kDLBool = 6U,
+} DLDataTypeCode;
+
+typedef struct {
+  uint8_t code;
+  uint8_t bits;
+  uint16_t lanes;
+} DLDataType;
+
+typedef struct {
+  void* data;
+  DLDevice device;
+  int32_t ndim;
+  DLDataType dtype;
+  int64_t* shape;
+  int64_t* strides;
+  uint64_t byte_offset;
+} DLTensor;
+
+typedef struct DLManagedTensor {
+  DLTensor dl_tensor;
+  void* manager_ctx;
+  void (*deleter)(struct DLManagedTensor* self);
+} DLManagedTensor;
+
+#endif  // DLPACK_DLPACK_H_
+
+}  // namespace mexplus
+
+namespace mexplus {
+
+/** Manager context of a tensor made by ToDLPack().
+ */
+struct DLPackContext {
+  DLManagedTensor tensor;
+  /** Reference to the array.
+   */
+  SharedMxArray array;
+  std::vector<int64_t> shape;
+  std::vector<int64_t> strides;
+};
+
+/** Deleter of a tensor made by ToDLPack(). Call it on the Matlab thread
+ * before the MEX call returns, as it may destroy the mxArray.
+ */
+inline void DeleteDLPackContext(DLManagedTensor* tensor) {
+  delete static_cast<DLPackContext*>(tensor->manager_ctx);
+}
+
+/** DLPack data type of the class. The code is kDLOpaqueHandle if unsupported.
+ */
+inline DLDataType DLPackDataType(mxClassID class_id) {
+  DLDataType dtype = {kDLOpaqueHandle, 0, 1};
+  switch (class_id) {
+    case mxINT8_CLASS:    dtype.code = kDLInt;   dtype.bits = 8;  break;
+    case mxUINT8_CLASS:   dtype.code = kDLUInt;  dtype.bits = 8;  break;
+    case mxINT16_CLASS:   dtype.code = kDLInt;   dtype.bits = 16; break;
+    case mxUINT16_CLASS:  dtype.code = kDLUInt;  dtype.bits = 16; break;
+    case mxINT32_CLASS:   dtype.code = kDLInt;   dtype.bits = 32; break;
+    case mxUINT32_CLASS:  dtype.code = kDLUInt;  dtype.bits = 32; break;
+    case mxINT64_CLASS:   dtype.code = kDLInt;   dtype.bits = 64; break;
+    case mxUINT64_CLASS:  dtype.code = kDLUInt;  dtype.bits = 64; break;
+    case mxSINGLE_CLASS:  dtype.code = kDLFloat; dtype.bits = 32; break;
+    case mxDOUBLE_CLASS:  dtype.code = kDLFloat; dtype.bits = 64; break;
+    case mxLOGICAL_CLASS: dtype.code = kDLBool;  dtype.bits = 8;  break;
+    default: break;
+  }
+  return dtype;
+}
+
+/** Class of the DLPack data type, or mxUNKNOWN_CLASS if unsupported.
+ */
+inline mxClassID DLPackClassID(const DLDataType& dtype) {
+  if (dtype.lanes != 1)
+    return mxUNKNOWN_CLASS;
+  switch (dtype.code) {
+    case kDLInt:
+      switch (dtype.bits) {
+        case 8:  return mxINT8_CLASS;
+        case 16: return mxINT16_CLASS;
+        case 32: return mxINT32_CLASS;
+        case 64: return mxINT64_CLASS;
+      }
+      break;
+    case kDLUInt:
+      switch (dtype.bits) {
+        case 8:  return mxUINT8_CLASS;
+        case 16: return mxUINT16_CLASS;
+        case 32: return mxUINT32_CLASS;
+        case 64: return mxUINT64_CLASS;
+      }
+      break;
+    case kDLFloat:
+      switch (dtype.bits) {
+        case 32: return mxSINGLE_CLASS;
+        case 64: return mxDOUBLE_CLASS;
+      }
+      break;
+    case kDLBool:
+      if (dtype.bits == 8)
+        return mxLOGICAL_CLASS;
+      break;
+  }
+  return mxUNKNOWN_CLASS;
+}
+
+/** Make a DLPack tensor that refers to the array without a copy.
+ * @param array real numeric or logical array. The tensor holds a reference.
+ * @return Tensor that the consumer must delete by its deleter, on the Matlab
+ *     thread before the MEX call returns.
+ */
+inline DLManagedTensor* ToDLPack(const SharedMxArray& array) {
+  const mxArray* source = array.get();
+  MEXPLUS_CHECK_NOTNULL(source);
+  DLDataType dtype = DLPackDataType(mxGetClassID(source));
+  MEXPLUS_ASSERT(dtype.code != kDLOpaqueHandle && !mxIsComplex(source),
+                 "Cannot export %s array to DLPack.",
+                 mxGetClassName(source));
+  DLPackContext* context = new DLPackContext;
+  context->array = array;
+  const mwSize* dimensions = mxGetDimensions(source);
+  mwSize ndim = mxGetNumberOfDimensions(source);
+  int64_t stride = 1;
+  for (mwSize i = 0; i < ndim; ++i) {
+    context->shape.push_back(static_cast<int64_t>(dimensions[i]));
+    context->strides.push_back(stride);
+    stride *= static_cast<int64_t>(dimensions[i]);
+  }
+  DLTensor* tensor = &context->tensor.dl_tensor;
+  tensor->data = mxGetData(source);
+  tensor->device.device_type = kDLCPU;
+  tensor->device.device_id = 0;
+  tensor->ndim = static_cast<int32_t>(ndim);
+  tensor->dtype = dtype;
+  tensor->shape = context->shape.data();
+  tensor->strides = context->strides.data();
+  tensor->byte_offset = 0;
+  context->tensor.manager_ctx = context;
+  context->tensor.deleter = &DeleteDLPackContext;
+  return &context->tensor;
+}
+
+/** Make a DLPack tensor that takes over an MxArray, owner or borrowed.
+ */
+inline DLManagedTensor* ToDLPack(MxArray&& array) {
+  return ToDLPack(SharedMxArray(std::move(array)));
+}
+
+/** Make an mxArray from a DLPack tensor. The tensor is deleted.
+ * @param tensor CPU tensor of a real numeric or boolean type.
+ * @return Unmanaged mxArray*. Always caller must destroy.
+ */
+inline mxArray* FromDLPack(DLManagedTensor* tensor) {
+  MEXPLUS_CHECK_NOTNULL(tensor);
+  struct Deleter {
+    explicit Deleter(DLManagedTensor* tensor) : tensor_(tensor) {}
+    ~Deleter() {
+      if (tensor_->deleter)
+        tensor_->deleter(tensor_);
+    }
+    DLManagedTensor* tensor_;
+  } deleter(tensor);
+  if (tensor->deleter == &DeleteDLPackContext) {
+    DLPackContext* context = static_cast<DLPackContext*>(tensor->manager_ctx);
+    if (context->array.isUnique() && context->array.array().isOwner())
+      return context->array.release();
+  }
+  const DLTensor& source = tensor->dl_tensor;
+  MEXPLUS_ASSERT(source.device.device_type == kDLCPU,
+                 "Cannot import a DLPack tensor on device %d.",
+                 static_cast<int>(source.device.device_type));
+  mxClassID class_id = DLPackClassID(source.dtype);
+  MEXPLUS_ASSERT(class_id != mxUNKNOWN_CLASS,
+                 "Unsupported DLPack data type: code %d, %d bits.",
+                 static_cast<int>(source.dtype.code),
+                 static_cast<int>(source.dtype.bits));
+  std::vector<mwSize> dimensions;
+  for (int32_t i = 0; i < source.ndim; ++i)
+    dimensions.push_back(static_cast<mwSize>(source.shape[i]));
+  while (dimensions.size() < 2)
+    dimensions.push_back(1);
+  mxArray* array = (class_id == mxLOGICAL_CLASS) ?
+      CreateLogicalArray(dimensions) :
+      CreateNumericArray(dimensions, class_id, mxREAL, kUninitialized);
+  size_t element_size = source.dtype.bits / 8;
+  size_t size = mxGetNumberOfElements(array);
+  if (size == 0)
+    return array;
+  const char* input = static_cast<const char*>(source.data) +
+                      source.byte_offset;
+  char* output = static_cast<char*>(mxGetData(array));
+  // Element strides, row-major when strides are NULL.
+  std::vector<int64_t> strides(source.ndim);
+  int64_t stride = 1;
+  bool column_major = true;
+  for (int32_t i = source.ndim - 1; i >= 0; --i) {
+    strides[i] = (source.strides) ? source.strides[i] : stride;
+    stride *= source.shape[i];
+  }
+  stride = 1;
+  for (int32_t i = 0; i < source.ndim; ++i) {
+    if (source.shape[i] > 1 && strides[i] != stride)
+      column_major = false;
+    stride *= source.shape[i];
+  }
+  if (column_major) {
+    std::memcpy(output, input, size * element_size);
+    return array;
+  }
+  std::vector<int64_t> subscripts(source.ndim, 0);
+  int64_t offset = 0;
+  for (size_t index = 0; index < size; ++index) {
+    std::memcpy(output + index * element_size,
+                input + offset * static_cast<int64_t>(element_size),
+                element_size);
+    for (int32_t i = 0; i < source.ndim; ++i) {
+      offset += strides[i];
+      if (++subscripts[i] < source.shape[i])
+        break;
+      offset -= strides[i] * subscripts[i];
+      subscripts[i] = 0;
+    }
+  }
+  return array;
+}
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_DLPACK_H_
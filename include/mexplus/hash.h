@@ -0,0 +1,378 @@
+/** Content hashing of mxArray.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * HashArray() computes a 64-bit fingerprint directly over the array data,
+ * without converting to C++ types. The fingerprint folds in the class ID, the
+ * dimensions and the complexity, and recurses through cells and struct fields
+ * in field-number order, with the field names. Numeric, logical, char,
+ * sparse, cell, and struct arrays are supported.
+ *
+ *    uint64_t key = MxArray(prhs[0]).hash();
+ *
+ * Bytes are hashed by XXH64, which reads four independent 64-bit lanes per
+ * 32-byte stripe. Data larger than kHashBlockSize is hashed block by block
+ * and the block hashes are hashed again, so that blocks can be computed in
+ * parallel. The fingerprint is the same with or without threads. It depends
+ * on the byte order and is not meant to be stored across platforms.
+ *
+ * Hashes with several seeds, e.g., a key and an independent check, can be
+ * computed in a single pass over the data, which is read once for all seeds.
+ *
+ *    const uint64_t seeds[2] = {0, 1};
+ *    uint64_t hashes[2];
+ *    HashArray(prhs[0], seeds, hashes);
+ */
+
+#ifndef INCLUDE_MEXPLUS_HASH_H_
+#define INCLUDE_MEXPLUS_HASH_H_
+
+#include <mex.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace mexplus {
+
+/** Size of the blocks hashed separately in large arrays.
+ */
+const size_t kHashBlockSize = 1 << 22;
+
+/** XXH64 hash of a byte sequence.
+ */
+class XXHash64 {
+ public:
+  static uint64_t hash(const void* data, size_t size, uint64_t seed = 0) {
+    const uint64_t seeds[1] = {seed};
+    uint64_t hashes[1];
+    hash(data, size, seeds, hashes);
+    return hashes[0];
+  }
+  /** Hash the same bytes with N seeds in a single pass over the data. Each
+   * hash equals hash(data, size, seeds[k]).
+   */
+  template <size_t N>
+  static void hash(const void* data,
+                   size_t size,
+                   const uint64_t (&seeds)[N],
+                   uint64_t (&hashes)[N]) {
+    const uint8_t* input = static_cast<const uint8_t*>(data);
+    const uint8_t* end = input + size;
+    uint64_t h[N];
+    if (size >= 32) {
+      uint64_t v[N][4];
+      for (size_t k = 0; k < N; ++k) {
+        v[k][0] = seeds[k] + kPrime1 + kPrime2;
+        v[k][1] = seeds[k] + kPrime2;
+        v[k][2] = seeds[k];
+        v[k][3] = seeds[k] - kPrime1;
+      }
+      const uint8_t* limit = end - 32;
+      do {
+        uint64_t stripe[4] = {read64(input), read64(input + 8),
+                              read64(input + 16), read64(input + 24)};
+        for (size_t k = 0; k < N; ++k) {
+          v[k][0] = round(v[k][0], stripe[0]);
+          v[k][1] = round(v[k][1], stripe[1]);
+          v[k][2] = round(v[k][2], stripe[2]);
+          v[k][3] = round(v[k][3], stripe[3]);
+        }
+        input += 32;
+      } while (input <= limit);
+      for (size_t k = 0; k < N; ++k) {
+        h[k] = rotate(v[k][0], 1) + rotate(v[k][1], 7) +
+               rotate(v[k][2], 12) + rotate(v[k][3], 18);
+        for (int lane = 0; lane < 4; ++lane)
+          h[k] = merge(h[k], v[k][lane]);
+      }
+    } else {
+      for (size_t k = 0; k < N; ++k)
+        h[k] = seeds[k] + kPrime5;
+    }
+    for (size_t k = 0; k < N; ++k)
+      h[k] += static_cast<uint64_t>(size);
+    while (input + 8 <= end) {
+      uint64_t word = round(0, read64(input));
+      for (size_t k = 0; k < N; ++k)
+        h[k] = rotate(h[k] ^ word, 27) * kPrime1 + kPrime4;
+      input += 8;
+    }
+    if (input + 4 <= end) {
+      uint64_t word = static_cast<uint64_t>(read32(input)) * kPrime1;
+      for (size_t k = 0; k < N; ++k)
+        h[k] = rotate(h[k] ^ word, 23) * kPrime2 + kPrime3;
+      input += 4;
+    }
+    while (input < end) {
+      uint64_t byte = static_cast<uint64_t>(*input++) * kPrime5;
+      for (size_t k = 0; k < N; ++k)
+        h[k] = rotate(h[k] ^ byte, 11) * kPrime1;
+    }
+    for (size_t k = 0; k < N; ++k) {
+      h[k] ^= h[k] >> 33;
+      h[k] *= kPrime2;
+      h[k] ^= h[k] >> 29;
+      h[k] *= kPrime3;
+      h[k] ^= h[k] >> 32;
+      hashes[k] = h[k];
+    }
+  }
+
+ private:
+  static const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+  static const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+  static const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+  static const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+  static const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+  static uint64_t rotate(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+  }
+  static uint64_t read64(const uint8_t* data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+  static uint32_t read32(const uint8_t* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+  static uint64_t round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * kPrime2;
+    accumulator = rotate(accumulator, 31);
+    return accumulator * kPrime1;
+  }
+  static uint64_t merge(uint64_t accumulator, uint64_t value) {
+    accumulator ^= round(0, value);
+    return accumulator * kPrime1 + kPrime4;
+  }
+};
+
+/** Hash a buffer with N seeds, block by block when it is larger than
+ * kHashBlockSize. Each hash equals HashBuffer(data, size, seeds[k]).
+ * @param parallel hash the blocks on multiple threads.
+ */
+template <size_t N>
+inline void HashBuffer(const void* data,
+                       size_t size,
+                       const uint64_t (&seeds)[N],
+                       uint64_t (&hashes)[N],
+                       bool parallel = false) {
+  if (size <= kHashBlockSize) {
+    XXHash64::hash(data, size, seeds, hashes);
+    return;
+  }
+  const char* input = static_cast<const char*>(data);
+  size_t blocks = (size + kHashBlockSize - 1) / kHashBlockSize;
+  // Block hashes of each seed are contiguous.
+  std::vector<uint64_t> block_hashes(N * blocks);
+  auto hash_block = [=, &block_hashes, &seeds](size_t i) {
+    size_t offset = i * kHashBlockSize;
+    uint64_t block[N];
+    XXHash64::hash(input + offset,
+                   std::min(kHashBlockSize, size - offset),
+                   seeds,
+                   block);
+    for (size_t k = 0; k < N; ++k)
+      block_hashes[k * blocks + i] = block[k];
+  };
+  size_t workers = (parallel) ? std::thread::hardware_concurrency() : 1;
+  if (workers > blocks)
+    workers = blocks;
+  if (workers <= 1) {
+    for (size_t i = 0; i < blocks; ++i)
+      hash_block(i);
+  } else {
+    std::vector<std::thread> threads;
+    for (size_t worker = 0; worker < workers; ++worker) {
+      threads.push_back(std::thread([=, &hash_block]() {
+        for (size_t i = worker; i < blocks; i += workers)
+          hash_block(i);
+      }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i)
+      threads[i].join();
+  }
+  for (size_t k = 0; k < N; ++k)
+    hashes[k] = XXHash64::hash(block_hashes.data() + k * blocks,
+                               blocks * sizeof(uint64_t),
+                               seeds[k]);
+}
+
+/** Hash a buffer, block by block when it is larger than kHashBlockSize.
+ * @param parallel hash the blocks on multiple threads.
+ */
+inline uint64_t HashBuffer(const void* data,
+                           size_t size,
+                           uint64_t seed,
+                           bool parallel = false) {
+  const uint64_t seeds[1] = {seed};
+  uint64_t hashes[1];
+  HashBuffer(data, size, seeds, hashes, parallel);
+  return hashes[0];
+}
+
+/** Hash the class ID, dimensions, and complexity with N seeds.
+ */
+template <size_t N>
+inline void HashHeader(mxClassID class_id,
+                       const mwSize* dimensions,
+                       mwSize dimension_size,
+                       bool complex,
+                       bool sparse,
+                       const uint64_t (&seeds)[N],
+                       uint64_t (&hashes)[N]) {
+  std::vector<uint64_t> header;
+  header.reserve(dimension_size + 3);
+  header.push_back(static_cast<uint64_t>(class_id));
+  header.push_back((complex ? 1 : 0) | (sparse ? 2 : 0));
+  header.push_back(static_cast<uint64_t>(dimension_size));
+  for (mwSize i = 0; i < dimension_size; ++i)
+    header.push_back(static_cast<uint64_t>(dimensions[i]));
+  XXHash64::hash(header.data(), header.size() * sizeof(uint64_t), seeds,
+                 hashes);
+}
+
+/** Hash the class ID, dimensions, and complexity.
+ */
+inline uint64_t HashHeader(mxClassID class_id,
+                           const mwSize* dimensions,
+                           mwSize dimension_size,
+                           bool complex,
+                           bool sparse,
+                           uint64_t seed = 0) {
+  const uint64_t seeds[1] = {seed};
+  uint64_t hashes[1];
+  HashHeader(class_id, dimensions, dimension_size, complex, sparse, seeds,
+             hashes);
+  return hashes[0];
+}
+
+/** Return true if HashArray() accepts the array, i.e., it is NULL or a
+ * numeric, logical, char, cell, or struct array whose elements are as well.
+ */
+inline bool IsHashable(const mxArray* array) {
+  if (!array || mxIsNumeric(array) || mxIsLogical(array) || mxIsChar(array))
+    return true;
+  size_t size = mxGetNumberOfElements(array);
+  if (mxIsCell(array)) {
+    for (size_t i = 0; i < size; ++i)
+      if (!IsHashable(mxGetCell(array, i)))
+        return false;
+    return true;
+  }
+  if (mxIsStruct(array)) {
+    int fields = mxGetNumberOfFields(array);
+    for (size_t i = 0; i < size; ++i)
+      for (int j = 0; j < fields; ++j)
+        if (!IsHashable(mxGetFieldByNumber(array, i, j)))
+          return false;
+    return true;
+  }
+  return false;
+}
+
+/** Compute the content hashes of an array with N seeds in a single pass over
+ * the data. Each hash equals HashArray(array, parallel, base_seeds[k]).
+ * @param array array to hash. NULL is hashed as an empty double array.
+ * @param base_seeds seeds of the hashes.
+ * @param hashes output hashes.
+ * @param parallel hash large data on multiple threads.
+ */
+template <size_t N>
+inline void HashArray(const mxArray* array,
+                      const uint64_t (&base_seeds)[N],
+                      uint64_t (&hashes)[N],
+                      bool parallel = false) {
+  uint64_t seeds[N];
+  if (!array) {
+    const mwSize dimensions[2] = {0, 0};
+    HashHeader(mxDOUBLE_CLASS, dimensions, 2, false, false, base_seeds, seeds);
+    XXHash64::hash(NULL, 0, seeds, hashes);
+    return;
+  }
+  mxClassID class_id = mxGetClassID(array);
+  bool complex = mxIsComplex(array);
+  bool sparse = mxIsSparse(array);
+  HashHeader(class_id,
+             mxGetDimensions(array),
+             mxGetNumberOfDimensions(array),
+             complex,
+             sparse,
+             base_seeds,
+             seeds);
+  size_t size = mxGetNumberOfElements(array);
+  if (mxIsCell(array) || mxIsStruct(array)) {
+    // Element hashes of each seed are contiguous, after the field names.
+    bool is_struct = mxIsStruct(array);
+    int fields = (is_struct) ? mxGetNumberOfFields(array) : 0;
+    size_t count = (is_struct) ? fields * (size + 1) : size;
+    std::vector<uint64_t> element_hashes(N * count);
+    uint64_t element[N];
+    for (int j = 0; j < fields; ++j) {
+      const char* name = mxGetFieldNameByNumber(array, j);
+      XXHash64::hash(name, std::strlen(name), seeds, element);
+      for (size_t k = 0; k < N; ++k)
+        element_hashes[k * count + j] = element[k];
+    }
+    for (size_t i = fields; i < count; ++i) {
+      const mxArray* value = (is_struct) ?
+          mxGetFieldByNumber(array, (i - fields) / fields,
+                             (i - fields) % fields) :
+          mxGetCell(array, i);
+      HashArray(value, base_seeds, element, parallel);
+      for (size_t k = 0; k < N; ++k)
+        element_hashes[k * count + i] = element[k];
+    }
+    for (size_t k = 0; k < N; ++k)
+      hashes[k] = XXHash64::hash(element_hashes.data() + k * count,
+                                 count * sizeof(uint64_t),
+                                 seeds[k]);
+    return;
+  }
+  if (!mxIsNumeric(array) && !mxIsLogical(array) && !mxIsChar(array))
+    mexErrMsgIdAndTxt("mexplus:error",
+                      "Cannot hash %s array.",
+                      mxGetClassName(array));
+  size_t element_size = mxGetElementSize(array);
+  if (sparse) {
+    size_t columns = mxGetN(array);
+    const mwIndex* jc = mxGetJc(array);
+    size = jc[columns];
+    uint64_t column_hashes[N];
+    XXHash64::hash(jc, (columns + 1) * sizeof(mwIndex), seeds, column_hashes);
+    HashBuffer(mxGetIr(array), size * sizeof(mwIndex), column_hashes, seeds,
+               parallel);
+  }
+  if (!complex) {
+    HashBuffer(mxGetData(array), size * element_size, seeds, hashes, parallel);
+    return;
+  }
+  uint64_t real_hashes[N];
+  HashBuffer(mxGetData(array), size * element_size, seeds, real_hashes,
+             parallel);
+  HashBuffer(mxGetImagData(array), size * element_size, real_hashes, hashes,
+             parallel);
+}
+
+/** Compute the content hash of an array.
+ * @param array array to hash. NULL is hashed as an empty double array.
+ * @param parallel hash large data on multiple threads.
+ * @param base_seed seed of the hash. Different seeds give independent
+ *     hashes of the same array.
+ */
+inline uint64_t HashArray(const mxArray* array,
+                          bool parallel = false,
+                          uint64_t base_seed = 0) {
+  const uint64_t base_seeds[1] = {base_seed};
+  uint64_t hashes[1];
+  HashArray(array, base_seeds, hashes, parallel);
+  return hashes[0];
+}
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_HASH_H_
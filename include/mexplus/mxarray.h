@@ -53,11 +53,16 @@
 #include <mex.h>
 #include <algorithm>
 #include <cstdint>
+#include <iterator>
 #include <set>
 #include <string>
 #include <typeinfo>
 #include <vector>
+#include "mexplus/allocation.h"
+#include "mexplus/allocator.h"
+#include "mexplus/hash.h"
 #include "mexplus/mxtypes.h"
+#include "mexplus/unicode.h"
 
 #pragma warning(once : 4244)
 
@@ -90,6 +95,84 @@
 
 namespace mexplus {
 
+/** Packed ragged array, i.e., jagged rows of values stored contiguously.
+ *
+ * Row i spans values[offsets[i]] to values[offsets[i + 1] - 1], and offsets
+ * always has one more element than the number of rows. The MxArray conversion
+ * produces a struct with `values` and `offsets` fields instead of a cell array
+ * of rows, which takes exactly two data allocations regardless of the number
+ * of rows. A cell array of numeric vectors can be read into Ragged in a single
+ * pass.
+ *
+ * Example:
+ * @code
+ *     Ragged<int> ragged(vector<vector<int> >(...));
+ *     plhs[0] = MxArray::from(ragged);  // struct with values, offsets
+ *     Ragged<double> rows = MxArray::to<Ragged<double> >(prhs[0]);  // {x, y}
+ * @endcode
+ */
+template <typename T>
+struct Ragged {
+  static_assert(MxArithmeticType<T>::value ||
+                MxLogicalType<T>::value ||
+                MxCharType<T>::value,
+                "Ragged value must be a numeric, logical, or char type.");
+  /** Empty constructor.
+   */
+  Ragged() : offsets(1, 0) {}
+  /** Construct from nested containers, i.e. vector<vector<T> >.
+   */
+  template <typename Container>
+  explicit Ragged(const Container& rows) : offsets(1, 0) {
+    mwSize total_size = 0;
+    for (typename Container::const_iterator it = rows.begin();
+         it != rows.end();
+         ++it)
+      total_size += static_cast<mwSize>(it->size());
+    values.reserve(total_size);
+    offsets.reserve(rows.size() + 1);
+    for (typename Container::const_iterator it = rows.begin();
+         it != rows.end();
+         ++it)
+      push_back(it->begin(), it->end());
+  }
+  /** Append a row.
+   */
+  template <typename Iterator>
+  void push_back(Iterator first, Iterator last) {
+    values.insert(values.end(), first, last);
+    offsets.push_back(static_cast<mwIndex>(values.size()));
+  }
+  /** Number of rows.
+   */
+  mwSize size() const {
+    return (offsets.empty()) ? 0 : static_cast<mwSize>(offsets.size() - 1);
+  }
+  /** Number of values in a row.
+   */
+  mwSize rowSize(mwIndex row) const {
+    return static_cast<mwSize>(offsets[row + 1] - offsets[row]);
+  }
+  /** Iterators to a row.
+   */
+  typename std::vector<T>::const_iterator begin(mwIndex row) const {
+    return values.begin() + offsets[row];
+  }
+  typename std::vector<T>::const_iterator end(mwIndex row) const {
+    return values.begin() + offsets[row + 1];
+  }
+
+  /** Concatenated values of all rows.
+   */
+  std::vector<T> values;
+  /** Offset of each row in values, followed by the total size.
+   */
+  std::vector<mwIndex> offsets;
+};
+
+template <typename T>
+class ChunkedReader;
+
 /** mxArray object wrapper for data conversion and manipulation.
  *
  * The class is similar to a combination of unique_ptr and wrapper around
@@ -232,24 +315,33 @@ class MxArray {
   /** Create a new numeric (real or complex) matrix.
    * @param rows Number of rows.
    * @param columns Number of cols.
+   * @param policy Allocation policy, e.g., kUninitialized.
    */
   template <typename T>
-  static mxArray* Numeric(int rows = 1, int columns = 1);
+  static mxArray* Numeric(int rows = 1,
+                          int columns = 1,
+                          AllocationPolicy policy = kZeroFilled);
   /** Create a new numeric (real or complex) matrix.
    * @param ndim Number of dimensions.
    * @param dims Dimensions array. Each element in the dimensions array
    *             contains the size of the array in that dimension.
+   * @param policy Allocation policy, e.g., kUninitialized.
    */
   template <typename T>
-  static mxArray* Numeric(std::vector<std::size_t> dims);
+  static mxArray* Numeric(std::vector<std::size_t> dims,
+                          AllocationPolicy policy = kZeroFilled);
   /** Create a new logical matrix.
    * @param rows Number of rows.
    * @param columns Number of cols.
+   * @param policy Allocation policy, e.g., kPersistent.
    */
-  static mxArray* Logical(int rows = 1, int columns = 1) {
-    mxArray* logical_array = mxCreateLogicalMatrix(rows, columns);
-    MEXPLUS_CHECK_NOTNULL(logical_array);
-    return logical_array;
+  static mxArray* Logical(int rows = 1,
+                          int columns = 1,
+                          AllocationPolicy policy = kZeroFilled) {
+    std::vector<mwSize> dimensions(2);
+    dimensions[0] = rows;
+    dimensions[1] = columns;
+    return CreateLogicalArray(dimensions, policy);
   }
   /** Create a new cell matrix.
    * @param rows Number of rows.
@@ -294,15 +386,74 @@ class MxArray {
     MEXPLUS_CHECK_NOTNULL(struct_array);
     return struct_array;
   }
+  /** Create a padded char matrix from UTF-8 rows, i.e. char({'ab', 'c'}).
+   * Shorter rows are padded with blanks. MxArray::to<vector<string> >()
+   * reads the rows back with the trailing blanks removed.
+   *
+   * Example:
+   * @code
+   *     vector<string> rows = {"ab", "cde"};
+   *     plhs[0] = MxArray::CharMatrix(rows);  // ['ab '; 'cde']
+   * @endcode
+   */
+  template <typename Container>
+  static mxArray* CharMatrix(const Container& rows);
+  /** Create a numeric array that takes over the buffer of the vector without
+   * a copy. The vector is left empty.
+   * @param value vector allocated by MxAllocator.
+   * @param dimensions array dimensions, or 1-by-N if empty.
+   *
+   * Example:
+   * @code
+   *     vector<double, MxAllocator<double> > values(rows * columns);
+   *     // Fill in values...
+   *     plhs[0] = MxArray::adopt(std::move(values), {rows, columns});
+   * @endcode
+   */
+  template <typename T>
+  static mxArray* adopt(std::vector<T, MxAllocator<T> >&& value,
+                        const std::vector<mwSize>& dimensions =
+                            std::vector<mwSize>());
+  /** Create a numeric or logical array that takes over the given buffer.
+   * @param data buffer from mxMalloc(), mxCalloc(), or MxAllocator.
+   * @param dimensions array dimensions.
+   */
+  template <typename T>
+  static mxArray* adopt(T* data, const std::vector<mwSize>& dimensions);
   /** mxArray* importer methods.
    */
   template <typename T>
   static mxArray* from(const T& value) { return fromInternal<T>(value); }
-  static mxArray* from(const char* value) {
-    mxArray* array = mxCreateString(value);
+  /** Nested containers given as rvalue, i.e. vector<vector<string> >. This
+   * is not a move: each element is copied into its mxArray through
+   * from(const T&), as an mxArray cannot take over C++ memory, and is then
+   * reset so that its memory is released early. Peak memory stays close to
+   * one copy of the data instead of two.
+   */
+  template <typename Container>
+  static mxArray* from(Container&& value,
+                       typename std::enable_if<
+                         !std::is_lvalue_reference<Container>::value &&
+                         !std::is_const<Container>::value &&
+                         MxNestedCompound<Container>::value &&
+                         !MxStringCompound<Container>::value
+                       >::type* = NULL) {
+    mxArray* array = mxCreateCellMatrix(1, static_cast<int>(value.size()));
     MEXPLUS_CHECK_NOTNULL(array);
+    mwIndex index = 0;
+    for (typename Container::iterator it = value.begin();
+         it != value.end();
+         ++it) {
+      mxArray* new_item = from(std::move(*it));
+      *it = typename Container::value_type();  // Release the element early.
+      mxSetCell(array, index++, new_item);
+    }
     return array;
   }
+  static mxArray* from(const char* value) {
+    MEXPLUS_CHECK_NOTNULL(value);
+    return fromUtf8(value, std::char_traits<char>::length(value));
+  }
   static mxArray* from(int32_t value) {
     mxArray* array = mxCreateNumericMatrix(1, 1, mxINT32_CLASS, mxREAL);
     MEXPLUS_CHECK_NOTNULL(array);
@@ -318,9 +469,78 @@ class MxArray {
   template <typename T>
   static T to(const mxArray* array) {
     T value;
-    toInternal<T>(array, &value);
+    to<T>(array, &value);  // Dispatch to a custom specialization if any.
     return value;
   }
+  /** Convert a range of numeric, logical, or char elements into an output
+   * iterator, i.e. a pointer to a preallocated buffer.
+   */
+  template <typename OutputIterator>
+  static void copyTo(const mxArray* array,
+                     mwIndex offset,
+                     mwSize size,
+                     OutputIterator output) {
+    copyToInternal(array, offset, size, output);
+  }
+  /** Convert numeric, logical, or char elements into caller storage without
+   * any allocation. Storage smaller than the array is an error.
+   * @param data pointer to the storage.
+   * @param capacity number of elements available in the storage.
+   * @return number of elements written.
+   *
+   * Example:
+   * @code
+   *     double buffer[256];
+   *     mwSize size = MxArray::toInto(prhs[0], buffer, 256);
+   * @endcode
+   */
+  template <typename T>
+  static mwSize toInto(const mxArray* array, T* data, mwSize capacity) {
+    MEXPLUS_CHECK_NOTNULL(array);
+    mwSize size = static_cast<mwSize>(mxGetNumberOfElements(array));
+    MEXPLUS_ASSERT(size <= capacity,
+                   "Storage too small: %u for %u elements.",
+                   static_cast<unsigned>(capacity),
+                   static_cast<unsigned>(size));
+    if (size > 0)
+      copyToInternal(array, 0, size, data);
+    return size;
+  }
+  /** Convert into a vector without reallocation. The vector is resized to the
+   * number of elements within its current capacity, so a reused vector
+   * allocates nothing. Capacity smaller than the array is an error.
+   */
+  template <typename T, typename Allocator>
+  static void toInto(const mxArray* array,
+                     std::vector<T, Allocator>* value) {
+    MEXPLUS_CHECK_NOTNULL(array);
+    MEXPLUS_CHECK_NOTNULL(value);
+    mwSize size = static_cast<mwSize>(mxGetNumberOfElements(array));
+    MEXPLUS_ASSERT(size <= value->capacity(),
+                   "Storage too small: %u for %u elements.",
+                   static_cast<unsigned>(value->capacity()),
+                   static_cast<unsigned>(size));
+    value->resize(size);
+    if (size > 0)
+      copyToInternal(array, 0, size, value->begin());
+  }
+  /** Convert into the leading elements of a fixed-size container, i.e.
+   * std::array. Size smaller than the array is an error.
+   * @return number of elements written.
+   */
+  template <typename Container>
+  static mwSize toInto(const mxArray* array, Container* value) {
+    MEXPLUS_CHECK_NOTNULL(array);
+    MEXPLUS_CHECK_NOTNULL(value);
+    mwSize size = static_cast<mwSize>(mxGetNumberOfElements(array));
+    MEXPLUS_ASSERT(size <= value->size(),
+                   "Storage too small: %u for %u elements.",
+                   static_cast<unsigned>(value->size()),
+                   static_cast<unsigned>(size));
+    if (size > 0)
+      copyToInternal(array, 0, size, value->begin());
+    return size;
+  }
   /** mxArray* element reader methods.
    */
   template <typename T>
@@ -401,11 +621,11 @@ class MxArray {
   template <typename T>
   T to() const {
     T value;
-    toInternal<T>(array_, &value);
+    to<T>(array_, &value);
     return value;
   }
   template <typename T>
-  void to(T* value) const { toInternal<T>(array_, value); }
+  void to(T* value) const { to<T>(array_, value); }
   /** Template for element accessor.
    * @param index index of the array element.
    * @return value of the element at index.
@@ -564,6 +784,17 @@ class MxArray {
   inline mwSize size() const {
     return static_cast<mwSize>(mxGetNumberOfElements(array_));
   }
+  /** Content hash over the data, dimensions, class and nested arrays.
+   * @param parallel hash large data on multiple threads.
+   */
+  inline uint64_t hash(bool parallel = false) const {
+    MEXPLUS_CHECK_NOTNULL(array_);
+    return HashArray(array_, parallel);
+  }
+  static uint64_t hash(const mxArray* array, bool parallel = false) {
+    MEXPLUS_CHECK_NOTNULL(array);
+    return HashArray(array, parallel);
+  }
   /** Number of dimensions.
    */
   inline mwSize dimensionSize() const {
@@ -740,6 +971,9 @@ class MxArray {
   static inline double Eps() { return mxGetEps(); }
 
  private:
+  template <typename T>
+  friend class ChunkedReader;
+
   /** Copy constructor is prohibited except internally.
    */
   MxArray(const MxArray& array);
@@ -778,19 +1012,27 @@ class MxArray {
   template <typename T>
   static mxArray* fromInternal(const typename std::enable_if<
       MxCharType<T>::value, T>::type& value);
+  /** UTF-8 string.
+   */
+  template <typename Container>
+  static mxArray* fromInternal(const typename std::enable_if<
+      std::is_same<Container, std::string>::value,
+      Container>::type& value);
   /** Containter with signed char.
    */
   template <typename Container>
   static mxArray* fromInternal(const typename std::enable_if<
       (MxCharCompound<Container>::value) &&
-      (std::is_signed<typename Container::value_type>::value),
+      (std::is_signed<typename Container::value_type>::value) &&
+      !std::is_same<Container, std::string>::value,
       Container>::type& value);
   /** Container with unsigned char.
    */
   template <typename Container>
   static mxArray* fromInternal(const typename std::enable_if<
       (MxCharCompound<Container>::value) &&
-      !(std::is_signed<typename Container::value_type>::value),
+      !(std::is_signed<typename Container::value_type>::value) &&
+      !std::is_same<Container, std::string>::value,
       Container>::type& value);
   /** Logicals.
    */
@@ -806,7 +1048,18 @@ class MxArray {
    */
   template <typename Container>
   static mxArray* fromInternal(const typename std::enable_if<
-      MxCellCompound<Container>::value, Container>::type& value);
+      MxCellCompound<Container>::value &&
+      !MxStringCompound<Container>::value, Container>::type& value);
+  /** Container with strings, i.e. cellstr.
+   */
+  template <typename Container>
+  static mxArray* fromInternal(const typename std::enable_if<
+      MxStringCompound<Container>::value, Container>::type& value);
+  /** Packed ragged array, i.e. Ragged<int>.
+   */
+  template <typename T>
+  static mxArray* fromInternal(const typename std::enable_if<
+      MxRaggedType<T>::value, T>::type& value);
 
   /*************************************************************/
   /**             Templated mxArray exporters                 **/
@@ -842,9 +1095,33 @@ class MxArray {
                          typename std::enable_if<
                            MxCellType<T>::value &&
                            (!std::is_compound<T>::value ||
-                            MxCellType<typename T::value_type>::value),
+                            MxCellType<typename T::value_type>::value) &&
+                           !MxStringCompound<T>::value,
+                           T
+                         >::type* value);
+  /** Strings from a cellstr or rows of a char matrix.
+   */
+  template <typename T>
+  static void toInternal(const mxArray* array,
+                         typename std::enable_if<
+                           MxStringCompound<T>::value,
+                           T
+                         >::type* value);
+  /** Packed ragged array from a struct or a cell array of vectors.
+   */
+  template <typename T>
+  static void toInternal(const mxArray* array,
+                         typename std::enable_if<
+                           MxRaggedType<T>::value,
                            T
                          >::type* value);
+  /** Contiguous range of numeric, logical, or char elements.
+   */
+  template <typename OutputIterator>
+  static void copyToInternal(const mxArray* array,
+                             mwIndex offset,
+                             mwSize size,
+                             OutputIterator output);
 
   /*************************************************************/
   /**             Templated mxArray getters                   **/
@@ -1020,6 +1297,43 @@ class MxArray {
       }
     }
   }
+  /** Explicit numeric range assignment.
+   */
+  template <typename T, typename OutputIterator>
+  static void assignRangeTo(const mxArray* array,
+                            mwIndex offset,
+                            mwSize size,
+                            OutputIterator output) {
+    convertRangeTo<T>(mxGetData(array),
+                      mxIsComplex(array) ? mxGetPi(array) : NULL,
+                      offset,
+                      size,
+                      output);
+  }
+  /** Explicit numeric range conversion from the real and imaginary data. It
+   * makes no API call, so that it can run on a worker thread.
+   */
+  template <typename T, typename OutputIterator>
+  static void convertRangeTo(const void* real,
+                             const void* imaginary,
+                             mwIndex offset,
+                             mwSize size,
+                             OutputIterator output) {
+    typedef typename std::iterator_traits<OutputIterator>::value_type R;
+    if (!imaginary) {
+      const T* data_pointer = reinterpret_cast<const T*>(real) + offset;
+      std::copy(data_pointer, data_pointer + size, output);
+    } else {
+      const T* real_part = reinterpret_cast<const T*>(real) + offset;
+      const T* imag_part = reinterpret_cast<const T*>(imaginary) + offset;
+      for (mwSize i = 0; i < size; ++i) {
+        double mag = std::abs(std::complex<double>(
+            static_cast<double>(*(real_part++)),
+            static_cast<double>(*(imag_part++))));
+        *(output++) = static_cast<R>(mag);
+      }
+    }
+  }
   #pragma warning( pop )
   /** Explicit complex array assigment.
    */
@@ -1044,12 +1358,37 @@ class MxArray {
       }
     }
   }
+  /** Create a char array from UTF-8 data.
+   */
+  static mxArray* fromUtf8(const char* data, size_t size) {
+    const mwSize dimensions[] = {1, static_cast<mwSize>(
+        Utf16Length(data, size))};
+    mxArray* array = mxCreateCharArray(2, dimensions);
+    MEXPLUS_CHECK_NOTNULL(array);
+    Utf8ToUtf16(data, size, mxGetChars(array));
+    return array;
+  }
+  /** Explicit char array assignment to UTF-8 string.
+   */
+  template <typename R>
+  static void assignStringTo(const mxArray* array,
+                             typename std::enable_if<
+                               std::is_same<R, std::string>::value,
+                               R
+                             >::type* value) {
+    const mxChar* data_pointer = mxGetChars(array);
+    size_t size = mxGetNumberOfElements(array);
+    value->resize(Utf8Length(data_pointer, size));
+    if (!value->empty())
+      Utf16ToUtf8(data_pointer, size, &(*value)[0]);
+  }
   /** Explicit char (signed) array assignment.
    */
   template <typename R>
   static void assignStringTo(const mxArray* array,
                              typename std::enable_if<
-                               std::is_signed<typename R::value_type>::value,
+                               std::is_signed<typename R::value_type>::value &&
+                               !std::is_same<R, std::string>::value,
                                R
                              >::type* value) {
     typedef typename std::make_signed<mxChar>::type SignedMxChar;
@@ -1062,12 +1401,15 @@ class MxArray {
   template <typename R>
   static void assignStringTo(const mxArray* array,
                              typename std::enable_if<
-                               !std::is_signed<typename R::value_type>::value,
+                               !std::is_signed<typename R::value_type>::value &&
+                               !std::is_same<R, std::string>::value,
       R>::type* value) {
     mxChar* data_pointer = mxGetChars(array);
     value->assign(data_pointer, data_pointer + mxGetNumberOfElements(array));
   }
-  /** Explicit cell array assignment.
+  /** Explicit cell array assignment. The destination is sized by resize(),
+   * which keeps the storage of existing elements. There is no separate
+   * reserve, as the size is known before any element is converted.
    */
   template <typename T>
   static void assignCellTo(const mxArray* array, T* value) {
@@ -1076,9 +1418,24 @@ class MxArray {
     for (size_t i = 0; i < array_size; ++i) {
       const mxArray* element = mxGetCell(array, static_cast<int>(i));
       MEXPLUS_CHECK_NOTNULL(element);
-      (*value)[i] = to<typename T::value_type>(element);
+      assignElementTo(element, value, i);
     }
   }
+  /** In-place element conversion, i.e. into the storage of (*value)[index].
+   */
+  template <typename T>
+  static void assignElementTo(const mxArray* element,
+                              T* value,
+                              size_t index) {
+    to(element, &(*value)[index]);  // Reuses the storage of the element.
+  }
+  static void assignElementTo(const mxArray* element,
+                              std::vector<bool>* value,
+                              size_t index) {
+    bool element_value;
+    to(element, &element_value);
+    (*value)[index] = element_value;
+  }
 
   /*************************************************************/
   /**  Assignment helpers (for MxArray.set<type>(i, value))  **/
@@ -1214,11 +1571,9 @@ template <typename Container>
 mxArray* MxArray::fromInternal(const typename std::enable_if<
     MxArithmeticCompound<Container>::value, Container>::type& value) {
   typedef typename Container::value_type ValueType;
-  mxArray* array = mxCreateNumericMatrix(1,
-                                         static_cast<int>(value.size()),
-                                         MxTypes<ValueType>::class_id,
-                                         MxTypes<ValueType>::complexity);
-  MEXPLUS_CHECK_NOTNULL(array);
+  mxArray* array = Numeric<ValueType>(1,
+                                      static_cast<int>(value.size()),
+                                      kUninitialized);
   std::copy(value.begin(),
             value.end(),
             reinterpret_cast<ValueType*>(mxGetData(array)));
@@ -1232,11 +1587,9 @@ mxArray* MxArray::fromInternal(const typename std::enable_if<
       MxComplexCompound<Container>::value, Container>::type& value) {
   typedef typename Container::value_type ContainerValueType;
   typedef typename ContainerValueType::value_type ValueType;
-  mxArray* array = mxCreateNumericMatrix(1,
-                                         static_cast<int>(value.size()),
-                                         MxTypes<ContainerValueType>::class_id,
-                                         mxCOMPLEX);
-  MEXPLUS_CHECK_NOTNULL(array);
+  mxArray* array = Numeric<ContainerValueType>(1,
+                                               static_cast<int>(value.size()),
+                                               kUninitialized);
   ValueType* real = reinterpret_cast<ValueType*>(mxGetPr(array));
   ValueType* imag = reinterpret_cast<ValueType*>(mxGetPi(array));
   typename Container::const_iterator it;
@@ -1256,10 +1609,18 @@ mxArray* MxArray::fromInternal(const typename std::enable_if<
   return array;
 }
 
+template <typename Container>
+mxArray* MxArray::fromInternal(const typename std::enable_if<
+    std::is_same<Container, std::string>::value,
+    Container>::type& value) {
+  return fromUtf8(value.data(), value.size());
+}
+
 template <typename Container>
 mxArray* MxArray::fromInternal(const typename std::enable_if<
     (MxCharCompound<Container>::value) &&
-    (std::is_signed<typename Container::value_type>::value),
+    (std::is_signed<typename Container::value_type>::value) &&
+    !std::is_same<Container, std::string>::value,
     Container>::type& value) {
   typedef typename std::make_unsigned<typename Container::value_type>::type
                    UnsignedValue;
@@ -1278,7 +1639,8 @@ mxArray* MxArray::fromInternal(const typename std::enable_if<
 template <typename Container>
 mxArray* MxArray::fromInternal(const typename std::enable_if<
     (MxCharCompound<Container>::value) &&
-    !(std::is_signed<typename Container::value_type>::value),
+    !(std::is_signed<typename Container::value_type>::value) &&
+    !std::is_same<Container, std::string>::value,
     Container>::type& value) {
   const mwSize dimensions[] = {1, static_cast<mwSize>(value.size())};
   mxArray* array = mxCreateCharArray(2, dimensions);
@@ -1306,7 +1668,8 @@ mxArray* MxArray::fromInternal(const typename std::enable_if<
 
 template <typename Container>
 mxArray* MxArray::fromInternal(const typename std::enable_if<
-    MxCellCompound<Container>::value, Container>::type& value) {
+    MxCellCompound<Container>::value &&
+    !MxStringCompound<Container>::value, Container>::type& value) {
   mxArray* array = mxCreateCellMatrix(1, static_cast<int>(value.size()));
   MEXPLUS_CHECK_NOTNULL(array);
   mwIndex index = 0;
@@ -1320,6 +1683,30 @@ mxArray* MxArray::fromInternal(const typename std::enable_if<
   return array;
 }
 
+template <typename Container>
+mxArray* MxArray::fromInternal(const typename std::enable_if<
+    MxStringCompound<Container>::value, Container>::type& value) {
+  mxArray* array = mxCreateCellMatrix(1, static_cast<int>(value.size()));
+  MEXPLUS_CHECK_NOTNULL(array);
+  mwIndex index = 0;
+  for (typename Container::const_iterator it = value.begin();
+       it != value.end();
+       ++it) {
+    mxSetCell(array, index++, fromUtf8(it->data(), it->size()));
+  }
+  return array;
+}
+
+template <typename T>
+mxArray* MxArray::fromInternal(const typename std::enable_if<
+    MxRaggedType<T>::value, T>::type& value) {
+  const char* kFields[] = {"values", "offsets"};
+  MxArray struct_array(Struct(2, kFields));
+  mxSetFieldByNumber(struct_array.getMutable(), 0, 0, from(value.values));
+  mxSetFieldByNumber(struct_array.getMutable(), 0, 1, from(value.offsets));
+  return struct_array.release();
+}
+
 /*************************************************************/
 /**             Templated mxArray exporters                 **/
 /*************************************************************/
@@ -1360,7 +1747,8 @@ void MxArray::toInternal(const mxArray* array,
                          typename std::enable_if<
                            MxCellType<T>::value &&
                            (!std::is_compound<T>::value ||
-                           MxCellType<typename T::value_type>::value),
+                           MxCellType<typename T::value_type>::value) &&
+                           !MxStringCompound<T>::value,
                            T
                          >::type* value) {
   MEXPLUS_CHECK_NOTNULL(value);
@@ -1369,7 +1757,147 @@ void MxArray::toInternal(const mxArray* array,
   value->resize(array_size);
   for (size_t i = 0; i < array_size; ++i) {
     const mxArray* element = mxGetCell(array, i);
-    (*value)[i] = to<typename T::value_type>(element);
+    MEXPLUS_CHECK_NOTNULL(element);
+    assignElementTo(element, value, i);
+  }
+}
+
+/** Converter to strings. A char matrix is transposed once so that each row
+ * is transcoded from contiguous memory.
+ */
+template <typename T>
+void MxArray::toInternal(const mxArray* array,
+                         typename std::enable_if<
+                           MxStringCompound<T>::value,
+                           T
+                         >::type* value) {
+  MEXPLUS_CHECK_NOTNULL(array);
+  MEXPLUS_CHECK_NOTNULL(value);
+  if (mxIsChar(array)) {
+    mwSize rows = static_cast<mwSize>(mxGetM(array));
+    mwSize columns = static_cast<mwSize>(mxGetN(array));
+    const mxChar* data = mxGetChars(array);
+    std::vector<mxChar> row_major;
+    if (rows > 1) {
+      row_major.resize(rows * columns);
+      for (mwSize j = 0; j < columns; ++j)
+        for (mwSize i = 0; i < rows; ++i)
+          row_major[i * columns + j] = data[j * rows + i];
+      data = row_major.data();
+    }
+    value->resize(rows);
+    typename T::iterator output = value->begin();
+    for (mwSize i = 0; i < rows; ++i, ++output) {
+      const mxChar* row = data + i * columns;
+      mwSize length = columns;
+      while (length > 0 && row[length - 1] == ' ')
+        --length;
+      output->resize(Utf8Length(row, length));
+      if (!output->empty())
+        Utf16ToUtf8(row, length, &(*output)[0]);
+    }
+    return;
+  }
+  MEXPLUS_ASSERT(mxIsCell(array),
+                 "Expected a cell array or a char matrix but %s.",
+                 mxGetClassName(array));
+  mwSize array_size = static_cast<mwSize>(mxGetNumberOfElements(array));
+  value->resize(array_size);
+  typename T::iterator output = value->begin();
+  for (mwSize i = 0; i < array_size; ++i, ++output) {
+    const mxArray* element = mxGetCell(array, i);
+    MEXPLUS_CHECK_NOTNULL(element);
+    if (mxIsChar(element))
+      assignStringTo<std::string>(element, &(*output));
+    else
+      to(element, &(*output));
+  }
+}
+
+/** Converter to a packed ragged array. A cell array of vectors is packed in a
+ * single pass after summing up the row sizes.
+ */
+template <typename T>
+void MxArray::toInternal(const mxArray* array,
+                         typename std::enable_if<
+                           MxRaggedType<T>::value,
+                           T
+                         >::type* value) {
+  MEXPLUS_CHECK_NOTNULL(array);
+  MEXPLUS_CHECK_NOTNULL(value);
+  if (mxIsStruct(array)) {
+    atInternal(array, "values", 0, &value->values);
+    atInternal(array, "offsets", 0, &value->offsets);
+    MEXPLUS_ASSERT(!value->offsets.empty() &&
+                   value->offsets.front() == 0 &&
+                   value->offsets.back() == value->values.size(),
+                   "Invalid ragged array offsets.");
+    for (size_t i = 1; i < value->offsets.size(); ++i)
+      MEXPLUS_ASSERT(value->offsets[i - 1] <= value->offsets[i],
+                     "Invalid ragged array offsets.");
+    return;
+  }
+  MEXPLUS_ASSERT(mxIsCell(array),
+                 "Expected a cell array or a struct but %s.",
+                 mxGetClassName(array));
+  mwSize array_size = static_cast<mwSize>(mxGetNumberOfElements(array));
+  value->offsets.resize(array_size + 1);
+  value->offsets[0] = 0;
+  for (mwIndex i = 0; i < array_size; ++i) {
+    const mxArray* element = mxGetCell(array, i);
+    value->offsets[i + 1] = value->offsets[i] +
+        ((element) ? mxGetNumberOfElements(element) : 0);
+  }
+  value->values.resize(value->offsets[array_size]);
+  for (mwIndex i = 0; i < array_size; ++i) {
+    const mxArray* element = mxGetCell(array, i);
+    if (element && !mxIsEmpty(element))
+      copyToInternal(element,
+                     0,
+                     value->rowSize(i),
+                     value->values.begin() + value->offsets[i]);
+  }
+}
+
+/** Converter from a range of numeric, logical, or char elements.
+ */
+template <typename OutputIterator>
+void MxArray::copyToInternal(const mxArray* array,
+                             mwIndex offset,
+                             mwSize size,
+                             OutputIterator output) {
+  MEXPLUS_CHECK_NOTNULL(array);
+  MEXPLUS_ASSERT(static_cast<size_t>(offset + size) <=
+                 mxGetNumberOfElements(array),
+                 "Index out of range: %u.",
+                 offset + size);
+  switch (mxGetClassID(array)) {
+    case mxINT8_CLASS:
+      assignRangeTo<int8_t>(array, offset, size, output); break;
+    case mxUINT8_CLASS:
+      assignRangeTo<uint8_t>(array, offset, size, output); break;
+    case mxINT16_CLASS:
+      assignRangeTo<int16_t>(array, offset, size, output); break;
+    case mxUINT16_CLASS:
+      assignRangeTo<uint16_t>(array, offset, size, output); break;
+    case mxINT32_CLASS:
+      assignRangeTo<int32_t>(array, offset, size, output); break;
+    case mxUINT32_CLASS:
+      assignRangeTo<uint32_t>(array, offset, size, output); break;
+    case mxINT64_CLASS:
+      assignRangeTo<int64_t>(array, offset, size, output); break;
+    case mxUINT64_CLASS:
+      assignRangeTo<uint64_t>(array, offset, size, output); break;
+    case mxSINGLE_CLASS:
+      assignRangeTo<float>(array, offset, size, output); break;
+    case mxDOUBLE_CLASS:
+      assignRangeTo<double>(array, offset, size, output); break;
+    case mxLOGICAL_CLASS:
+      assignRangeTo<mxLogical>(array, offset, size, output); break;
+    case mxCHAR_CLASS:
+      assignRangeTo<mxChar>(array, offset, size, output); break;
+    default:
+      MEXPLUS_ERROR("Cannot convert %s.", mxGetClassName(array));
   }
 }
 
@@ -1522,27 +2050,94 @@ void MxArray::setInternal(mxArray* array,
 }
 
 template <typename T>
-mxArray* MxArray::Numeric(int rows, int columns) {
-  typedef typename std::enable_if<
-      MxComplexOrArithmeticType<T>::value, T>::type Scalar;
-  mxArray* numeric = mxCreateNumericMatrix(rows,
-                                           columns,
-                                           MxTypes<Scalar>::class_id,
-                                           MxTypes<Scalar>::complexity);
-  MEXPLUS_CHECK_NOTNULL(numeric);
-  return numeric;
+mxArray* MxArray::Numeric(int rows, int columns, AllocationPolicy policy) {
+  std::vector<mwSize> dimensions(2);
+  dimensions[0] = rows;
+  dimensions[1] = columns;
+  return Numeric<T>(dimensions, policy);
 }
 
 template <typename T>
-mxArray* MxArray::Numeric(std::vector<std::size_t> dims) {
+mxArray* MxArray::Numeric(std::vector<std::size_t> dims,
+                          AllocationPolicy policy) {
 	typedef typename std::enable_if<
 		MxComplexOrArithmeticType<T>::value, T>::type Scalar;
-	mxArray* numeric = mxCreateNumericArray(dims.size(),
-                                          &dims[0],
-                                          MxTypes<Scalar>::class_id,
-                                          MxTypes<Scalar>::complexity);
-	MEXPLUS_CHECK_NOTNULL(numeric);
-	return numeric;
+	return CreateNumericArray(dims,
+                            MxTypes<Scalar>::class_id,
+                            MxTypes<Scalar>::complexity,
+                            policy);
+}
+
+template <typename Container>
+mxArray* MxArray::CharMatrix(const Container& rows) {
+  static_assert(MxStringCompound<Container>::value,
+                "CharMatrix expects a container of std::string.");
+  size_t columns = 0;
+  for (typename Container::const_iterator it = rows.begin();
+       it != rows.end();
+       ++it)
+    columns = std::max(columns, Utf16Length(it->data(), it->size()));
+  const mwSize dimensions[] = {static_cast<mwSize>(rows.size()),
+                               static_cast<mwSize>(columns)};
+  mxArray* array = mxCreateCharArray(2, dimensions);
+  MEXPLUS_CHECK_NOTNULL(array);
+  std::vector<mxChar> row_major(rows.size() * columns, ' ');
+  size_t index = 0;
+  for (typename Container::const_iterator it = rows.begin();
+       it != rows.end();
+       ++it)
+    Utf8ToUtf16(it->data(), it->size(), row_major.data() + columns * index++);
+  mxChar* data = mxGetChars(array);
+  for (size_t j = 0; j < columns; ++j)
+    for (size_t i = 0; i < rows.size(); ++i)
+      *(data++) = row_major[i * columns + j];
+  return array;
+}
+
+template <typename T>
+mxArray* MxArray::adopt(std::vector<T, MxAllocator<T> >&& value,
+                        const std::vector<mwSize>& dimensions) {
+  static_assert(MxArithmeticType<T>::value,
+                "Only a real numeric vector can be adopted.");
+  std::vector<mwSize> shape(dimensions);
+  if (shape.empty()) {
+    shape.push_back(1);
+    shape.push_back(static_cast<mwSize>(value.size()));
+  }
+  mwSize elements = 1;
+  for (size_t i = 0; i < shape.size(); ++i)
+    elements *= shape[i];
+  MEXPLUS_ASSERT(elements == value.size(),
+                 "Dimensions do not match %d elements.",
+                 static_cast<int>(value.size()));
+  T* data = value.empty() ? NULL : value.data();
+  mxArray* array = adopt<T>(data, shape);
+  const void* adopted = data;
+  // Free the container but leave the buffer to the array.
+  std::vector<T, MxAllocator<T> > owner(std::move(value),
+                                        MxAllocator<T>(&adopted));
+  return array;
+}
+
+template <typename T>
+mxArray* MxArray::adopt(T* data, const std::vector<mwSize>& dimensions) {
+  static_assert(MxArithmeticType<T>::value || MxLogicalType<T>::value,
+                "Only a real numeric or logical buffer can be adopted.");
+  MEXPLUS_ASSERT(!dimensions.empty(), "Missing dimensions.");
+  mxArray* array = (MxLogicalType<T>::value) ?
+      mxCreateLogicalMatrix(0, 0) :
+      mxCreateNumericMatrix(0, 0, MxTypes<T>::class_id, mxREAL);
+  MEXPLUS_CHECK_NOTNULL(array);
+  MEXPLUS_ASSERT(mxSetDimensions(array,
+                                 dimensions.data(),
+                                 dimensions.size()) == 0,
+                 "Failed to set dimensions.");
+  MEXPLUS_ASSERT(data || mxGetNumberOfElements(array) == 0,
+                 "Null buffer for %d elements.",
+                 static_cast<int>(mxGetNumberOfElements(array)));
+  if (data)
+    mxSetData(array, data);
+  return array;
 }
 
 template <typename T>
@@ -8,10 +8,14 @@
 
 #include <mex.h>
 #include <complex>
+#include <string>
 #include <type_traits>
 
 namespace mexplus {
 
+template <typename T>
+struct Ragged;
+
 /************************************************************/
 /* Traits for fundamental datatypes.
    Don't use with function templates due to type promotion!
@@ -340,6 +344,32 @@ struct MxCellCompound<T, typename std::enable_if<
     MxCellType<typename T::value_type>::value,
     T>::type> : std::true_type {};
 
+/* Traits for string compounds, i.e. vector<string>.
+ */
+template <typename T, typename U = T>
+struct MxStringCompound : std::false_type {};
+template <typename T>
+struct MxStringCompound<T, typename std::enable_if<
+    std::is_same<typename T::value_type, std::string>::value,
+    T>::type> : std::true_type {};
+
+/* Traits for nested compounds, i.e. vector<vector<T> > or vector<string>.
+ */
+template <typename T, typename U = T>
+struct MxNestedCompound : std::false_type {};
+template <typename T>
+struct MxNestedCompound<T, typename std::enable_if<
+    MxCellCompound<T>::value &&
+    !std::is_void<typename T::value_type::value_type>::value,
+    T>::type> : std::true_type {};
+
+/* Traits for packed ragged arrays.
+ */
+template <typename T>
+struct MxRaggedType : std::false_type {};
+template <typename T>
+struct MxRaggedType<Ragged<T> > : std::true_type {};
+
 }  // namespace mexplus
 
 #endif  // INCLUDE_MEXPLUS_MXTYPES_H_
@@ -0,0 +1,139 @@
+/** Typed N-d view over array data.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * MxView refers to the real data of a numeric or logical array in column-major
+ * order, so that a kernel can write results straight into Matlab memory.
+ *
+ *    MxView<float> image = output.allocate<float>(0, {height, width, 3});
+ *    for (mwSize k = 0; k < 3; ++k)
+ *      for (mwSize j = 0; j < width; ++j)
+ *        for (mwSize i = 0; i < height; ++i)
+ *          image(i, j, k) = ...;
+ *
+ * A view may instead own a scratch buffer, e.g. when the output was not
+ * requested by the caller. Copies of the view share the same buffer.
+ */
+
+#ifndef INCLUDE_MEXPLUS_MXVIEW_H_
+#define INCLUDE_MEXPLUS_MXVIEW_H_
+
+#include <mex.h>
+#include <memory>
+#include <typeinfo>
+#include <vector>
+#include "mexplus/mxarray.h"
+
+namespace mexplus {
+
+/** Mutable typed view over column-major N-d data.
+ */
+template <typename T>
+class MxView {
+ public:
+  static_assert(MxArithmeticType<T>::value || MxLogicalType<T>::value,
+                "MxView supports real numeric or logical types.");
+  typedef T value_type;
+  typedef T* iterator;
+  typedef const T* const_iterator;
+
+  /** Empty view.
+   */
+  MxView() : data_(NULL), size_(0) {}
+  /** View over the data of a numeric or logical array.
+   */
+  explicit MxView(mxArray* array) {
+    MEXPLUS_CHECK_NOTNULL(array);
+    MEXPLUS_ASSERT(mxGetClassID(array) == MxTypes<T>::class_id &&
+                   !mxIsComplex(array),
+                   "Expected a real %s array but %s.",
+                   typeid(T).name(),
+                   mxGetClassName(array));
+    const mwSize* dimensions = mxGetDimensions(array);
+    dimensions_.assign(dimensions,
+                       dimensions + mxGetNumberOfDimensions(array));
+    data_ = reinterpret_cast<T*>(mxGetData(array));
+    size_ = mxGetNumberOfElements(array);
+  }
+  /** View over a new scratch buffer of the given dimensions.
+   */
+  explicit MxView(const std::vector<mwSize>& dimensions)
+      : dimensions_(dimensions), data_(NULL), size_(1) {
+    for (size_t i = 0; i < dimensions_.size(); ++i)
+      size_ *= dimensions_[i];
+    if (size_ > 0) {
+      scratch_.reset(new T[size_], std::default_delete<T[]>());
+      data_ = scratch_.get();
+    }
+  }
+  /** View over external data of the given dimensions. The data must outlive
+   * the view.
+   */
+  MxView(T* data, const std::vector<mwSize>& dimensions)
+      : dimensions_(dimensions), data_(data), size_(1) {
+    for (size_t i = 0; i < dimensions_.size(); ++i)
+      size_ *= dimensions_[i];
+  }
+  T* data() const { return data_; }
+  mwSize size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  /** Return true if the view owns a scratch buffer.
+   */
+  bool isScratch() const { return static_cast<bool>(scratch_); }
+  const std::vector<mwSize>& dimensions() const { return dimensions_; }
+  mwSize dimensionSize() const { return dimensions_.size(); }
+  mwSize rows() const { return dimension(0); }
+  mwSize cols() const { return dimension(1); }
+  /** Size of the given dimension, or 1 beyond the number of dimensions.
+   */
+  mwSize dimension(mwSize index) const {
+    return (index < dimensions_.size()) ? dimensions_[index] : 1;
+  }
+  iterator begin() const { return data_; }
+  iterator end() const { return data_ + size_; }
+  /** Linear access.
+   */
+  T& operator[](mwIndex index) const { return data_[index]; }
+  /** 2-D access.
+   */
+  T& operator()(mwIndex row, mwIndex column) const {
+    return data_[row + dimension(0) * column];
+  }
+  /** 3-D access.
+   */
+  T& operator()(mwIndex row, mwIndex column, mwIndex page) const {
+    return data_[row + dimension(0) * (column + dimension(1) * page)];
+  }
+  /** N-d access with bound checks.
+   */
+  T& at(const std::vector<mwIndex>& subscripts) const {
+    mwIndex index = 0;
+    mwIndex stride = 1;
+    for (size_t i = 0; i < subscripts.size(); ++i) {
+      MEXPLUS_ASSERT(subscripts[i] < dimension(i),
+                     "Index out of range: %d.",
+                     static_cast<int>(subscripts[i]));
+      index += subscripts[i] * stride;
+      stride *= dimension(i);
+    }
+    return data_[index];
+  }
+
+ private:
+  /** Dimensions of the data.
+   */
+  std::vector<mwSize> dimensions_;
+  /** Pointer to the first element.
+   */
+  T* data_;
+  /** Number of elements.
+   */
+  mwSize size_;
+  /** Scratch buffer when the view does not refer to an mxArray.
+   */
+  std::shared_ptr<T> scratch_;
+};
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_MXVIEW_H_
@@ -0,0 +1,496 @@
+/** Call recorder for offline replay of MEX_DISPATCH calls.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * MEX_DISPATCH can record each call, i.e., the operation name, the number of
+ * outputs, the elapsed time, and all input arrays, to a binary log. Recording
+ * is off unless the environment variable MEXPLUS_RECORD names the log file
+ * at the first call, or CallRecorder::get()->open() is called.
+ *
+ *    >> setenv('MEXPLUS_RECORD', 'calls.log');
+ *    >> mylibrary('myfunc', x);  % Appended to calls.log.
+ *    >> clear mylibrary          % Closes calls.log.
+ *
+ * Only calls that return normally are recorded. The log is then replayed
+ * without Matlab by tools/replay.cc linked against the same MEX_DEFINE
+ * sources and the stand-in MEX runtime in standalone/, which reports
+ * per-operation latency.
+ *
+ * Session ids are addresses, which differ in the replay. Each record keeps
+ * the ids that Session<T>::create() returned and destroy() received during
+ * the call, so that the replay maps a recorded id to the id of the replayed
+ * session. RemapSessions() replaces recorded ids in the inputs, i.e., double,
+ * int64, or uint64 values equal to a live recorded id, including those in
+ * cells and structs.
+ *
+ * Numeric, logical, char, sparse, cell, and struct arrays are recorded.
+ * Other classes, e.g., function handles and objects, are recorded as empty
+ * double arrays. The log uses the native byte order and mwSize, and is not
+ * meant to be moved across platforms.
+ */
+
+#ifndef INCLUDE_MEXPLUS_RECORDER_H_
+#define INCLUDE_MEXPLUS_RECORDER_H_
+
+#include <mex.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace mexplus {
+
+/** Magic bytes at the beginning of a call log.
+ */
+const char kCallLogMagic[8] = {'M', 'E', 'X', 'P', 'L', 'O', 'G', '\0'};
+const uint32_t kCallLogVersion = 2;
+
+template <typename T>
+inline void WriteBinary(std::ostream* output, const T& value) {
+  output->write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+inline void WriteBinary(std::ostream* output, const void* data, size_t size) {
+  if (size > 0)
+    output->write(static_cast<const char*>(data), size);
+}
+
+inline void ReadBinary(std::istream* input, void* data, size_t size) {
+  if (size > 0 && !input->read(static_cast<char*>(data), size))
+    mexErrMsgIdAndTxt("mexplus:recorder:formatError",
+                      "Unexpected end of the call log.");
+}
+
+template <typename T>
+inline T ReadBinary(std::istream* input) {
+  T value;
+  ReadBinary(input, &value, sizeof(T));
+  return value;
+}
+
+/** Serialize an array. NULL is kept as NULL.
+ */
+inline void SerializeArray(const mxArray* array, std::ostream* output) {
+  WriteBinary<uint8_t>(output, (array) ? 1 : 0);
+  if (!array)
+    return;
+  bool supported = mxIsNumeric(array) || mxIsLogical(array) ||
+                   mxIsChar(array) || mxIsCell(array) || mxIsStruct(array);
+  mxClassID class_id = (supported) ? mxGetClassID(array) : mxDOUBLE_CLASS;
+  bool complex = supported && mxIsComplex(array);
+  bool sparse = supported && mxIsSparse(array);
+  mwSize dimension_size = (supported) ? mxGetNumberOfDimensions(array) : 2;
+  const mwSize empty_dimensions[2] = {0, 0};
+  const mwSize* dimensions = (supported) ? mxGetDimensions(array) :
+                                           empty_dimensions;
+  WriteBinary<int32_t>(output, class_id);
+  WriteBinary<uint8_t>(output, (complex ? 1 : 0) | (sparse ? 2 : 0));
+  WriteBinary<uint64_t>(output, dimension_size);
+  for (mwSize i = 0; i < dimension_size; ++i)
+    WriteBinary<uint64_t>(output, dimensions[i]);
+  if (!supported) {
+    WriteBinary<uint32_t>(output, sizeof(double));
+    return;
+  }
+  size_t size = mxGetNumberOfElements(array);
+  if (mxIsCell(array)) {
+    for (size_t i = 0; i < size; ++i)
+      SerializeArray(mxGetCell(array, i), output);
+    return;
+  }
+  if (mxIsStruct(array)) {
+    int fields = mxGetNumberOfFields(array);
+    WriteBinary<uint32_t>(output, fields);
+    for (int j = 0; j < fields; ++j) {
+      const char* name = mxGetFieldNameByNumber(array, j);
+      WriteBinary<uint32_t>(output, std::strlen(name));
+      WriteBinary(output, name, std::strlen(name));
+    }
+    for (size_t i = 0; i < size; ++i)
+      for (int j = 0; j < fields; ++j)
+        SerializeArray(mxGetFieldByNumber(array, i, j), output);
+    return;
+  }
+  size_t element_size = mxGetElementSize(array);
+  WriteBinary<uint32_t>(output, element_size);
+  if (sparse) {
+    size_t columns = mxGetN(array);
+    const mwIndex* jc = mxGetJc(array);
+    size = jc[columns];
+    WriteBinary(output, jc, (columns + 1) * sizeof(mwIndex));
+    WriteBinary(output, mxGetIr(array), size * sizeof(mwIndex));
+  }
+  WriteBinary(output, mxGetData(array), size * element_size);
+  if (complex)
+    WriteBinary(output, mxGetImagData(array), size * element_size);
+}
+
+/** Deserialize an array.
+ * @return Unmanaged mxArray*. Always caller must destroy.
+ */
+inline mxArray* DeserializeArray(std::istream* input) {
+  if (ReadBinary<uint8_t>(input) == 0)
+    return NULL;
+  mxClassID class_id = static_cast<mxClassID>(ReadBinary<int32_t>(input));
+  uint8_t flags = ReadBinary<uint8_t>(input);
+  mxComplexity complexity = (flags & 1) ? mxCOMPLEX : mxREAL;
+  bool sparse = (flags & 2) != 0;
+  std::vector<mwSize> dimensions(ReadBinary<uint64_t>(input));
+  for (size_t i = 0; i < dimensions.size(); ++i)
+    dimensions[i] = ReadBinary<uint64_t>(input);
+  mxArray* array = NULL;
+  if (class_id == mxCELL_CLASS) {
+    array = mxCreateCellArray(dimensions.size(), dimensions.data());
+    for (size_t i = 0; i < mxGetNumberOfElements(array); ++i)
+      mxSetCell(array, i, DeserializeArray(input));
+    return array;
+  }
+  if (class_id == mxSTRUCT_CLASS) {
+    std::vector<std::string> names(ReadBinary<uint32_t>(input));
+    std::vector<const char*> fields(names.size());
+    for (size_t j = 0; j < names.size(); ++j) {
+      names[j].resize(ReadBinary<uint32_t>(input));
+      ReadBinary(input, &names[j][0], names[j].size());
+      fields[j] = names[j].c_str();
+    }
+    array = mxCreateStructArray(dimensions.size(),
+                                dimensions.data(),
+                                fields.size(),
+                                fields.data());
+    for (size_t i = 0; i < mxGetNumberOfElements(array); ++i)
+      for (size_t j = 0; j < fields.size(); ++j)
+        mxSetFieldByNumber(array, i, j, DeserializeArray(input));
+    return array;
+  }
+  size_t element_size = ReadBinary<uint32_t>(input);
+  size_t size = 0;
+  if (sparse) {
+    if (dimensions.size() != 2)
+      mexErrMsgIdAndTxt("mexplus:recorder:formatError",
+                        "Invalid sparse array in the call log.");
+    std::vector<mwIndex> jc(dimensions[1] + 1);
+    ReadBinary(input, jc.data(), jc.size() * sizeof(mwIndex));
+    size = jc.back();
+    mwSize capacity = (size > 0) ? size : 1;
+    array = (class_id == mxLOGICAL_CLASS) ?
+        mxCreateSparseLogicalMatrix(dimensions[0], dimensions[1], capacity) :
+        mxCreateSparse(dimensions[0], dimensions[1], capacity, complexity);
+    std::copy(jc.begin(), jc.end(), mxGetJc(array));
+    ReadBinary(input, mxGetIr(array), size * sizeof(mwIndex));
+  } else if (class_id == mxLOGICAL_CLASS) {
+    array = mxCreateLogicalArray(dimensions.size(), dimensions.data());
+  } else if (class_id == mxCHAR_CLASS) {
+    array = mxCreateCharArray(dimensions.size(), dimensions.data());
+  } else {
+    array = mxCreateNumericArray(dimensions.size(),
+                                 dimensions.data(),
+                                 class_id,
+                                 complexity);
+  }
+  if (!sparse)
+    size = mxGetNumberOfElements(array);
+  if (mxGetElementSize(array) != element_size)
+    mexErrMsgIdAndTxt("mexplus:recorder:formatError",
+                      "Element size of %s array mismatch: %d.",
+                      mxGetClassName(array),
+                      static_cast<int>(element_size));
+  ReadBinary(input, mxGetData(array), size * element_size);
+  if (complexity == mxCOMPLEX)
+    ReadBinary(input, mxGetImagData(array), size * element_size);
+  return array;
+}
+
+/** Recorded call.
+ */
+struct CallRecord {
+  CallRecord() : nlhs(0), seconds(0.0) {}
+  ~CallRecord() { clear(); }
+  /** Destroy the arguments.
+   */
+  void clear() {
+    for (size_t i = 0; i < arguments.size(); ++i)
+      if (arguments[i])
+        mxDestroyArray(arguments[i]);
+    arguments.clear();
+    created.clear();
+    destroyed.clear();
+  }
+  /** Return true if the call creates or destroys a session.
+   */
+  bool changesSessions() const {
+    return !created.empty() || !destroyed.empty();
+  }
+
+  /** Operation name.
+   */
+  std::string name;
+  int nlhs;
+  /** Elapsed time of the recorded call.
+   */
+  double seconds;
+  /** Inputs to mexFunction, including the operation name.
+   */
+  std::vector<mxArray*> arguments;
+  /** Session ids created and destroyed during the call.
+   */
+  std::vector<int64_t> created;
+  std::vector<int64_t> destroyed;
+
+ private:
+  CallRecord(const CallRecord&);
+  CallRecord& operator=(const CallRecord&);
+};
+
+inline void WriteCallLogHeader(std::ostream* output) {
+  WriteBinary(output, kCallLogMagic, sizeof(kCallLogMagic));
+  WriteBinary(output, kCallLogVersion);
+}
+
+/** Check the header of a call log.
+ */
+inline void ReadCallLogHeader(std::istream* input) {
+  char magic[sizeof(kCallLogMagic)];
+  ReadBinary(input, magic, sizeof(magic));
+  if (std::memcmp(magic, kCallLogMagic, sizeof(magic)) != 0 ||
+      ReadBinary<uint32_t>(input) != kCallLogVersion)
+    mexErrMsgIdAndTxt("mexplus:recorder:formatError",
+                      "Not a call log of version %d.",
+                      static_cast<int>(kCallLogVersion));
+}
+
+inline void WriteSessionIds(std::ostream* output,
+                            const std::vector<int64_t>& ids) {
+  WriteBinary<uint32_t>(output, ids.size());
+  WriteBinary(output, ids.data(), ids.size() * sizeof(int64_t));
+}
+
+inline void ReadSessionIds(std::istream* input, std::vector<int64_t>* ids) {
+  ids->resize(ReadBinary<uint32_t>(input));
+  ReadBinary(input, ids->data(), ids->size() * sizeof(int64_t));
+}
+
+inline void WriteCallRecord(
+    std::ostream* output,
+    const std::string& name,
+    int nlhs,
+    double seconds,
+    int nrhs,
+    const mxArray* prhs[],
+    const std::vector<int64_t>& created = std::vector<int64_t>(),
+    const std::vector<int64_t>& destroyed = std::vector<int64_t>()) {
+  WriteBinary<uint32_t>(output, name.size());
+  WriteBinary(output, name.data(), name.size());
+  WriteBinary<int32_t>(output, nlhs);
+  WriteBinary<double>(output, seconds);
+  WriteBinary<uint32_t>(output, nrhs);
+  for (int i = 0; i < nrhs; ++i)
+    SerializeArray(prhs[i], output);
+  WriteSessionIds(output, created);
+  WriteSessionIds(output, destroyed);
+}
+
+/** Read the next call. Return false at the end of the log.
+ */
+inline bool ReadCallRecord(std::istream* input, CallRecord* record) {
+  record->clear();
+  uint32_t name_size;
+  if (!input->read(reinterpret_cast<char*>(&name_size), sizeof(name_size)))
+    return false;
+  record->name.resize(name_size);
+  ReadBinary(input, &record->name[0], name_size);
+  record->nlhs = ReadBinary<int32_t>(input);
+  record->seconds = ReadBinary<double>(input);
+  uint32_t nrhs = ReadBinary<uint32_t>(input);
+  for (uint32_t i = 0; i < nrhs; ++i)
+    record->arguments.push_back(DeserializeArray(input));
+  ReadSessionIds(input, &record->created);
+  ReadSessionIds(input, &record->destroyed);
+  return true;
+}
+
+/** Recorded session id to the id in the replay.
+ */
+typedef std::map<int64_t, int64_t> SessionIdMap;
+
+/** Replace recorded session ids in an array with the mapped ids.
+ */
+inline void RemapSessions(mxArray* array, const SessionIdMap& ids) {
+  if (!array || ids.empty())
+    return;
+  size_t size = mxGetNumberOfElements(array);
+  if (mxIsCell(array)) {
+    for (size_t i = 0; i < size; ++i)
+      RemapSessions(mxGetCell(array, i), ids);
+    return;
+  }
+  if (mxIsStruct(array)) {
+    int fields = mxGetNumberOfFields(array);
+    for (size_t i = 0; i < size; ++i)
+      for (int j = 0; j < fields; ++j)
+        RemapSessions(mxGetFieldByNumber(array, i, j), ids);
+    return;
+  }
+  if (mxIsSparse(array))
+    return;
+  switch (mxGetClassID(array)) {
+    case mxDOUBLE_CLASS: {
+      // Bounds of int64_t, as the conversion of other values is undefined.
+      const double kLowest = -9223372036854775808.0;
+      const double kLimit = 9223372036854775808.0;
+      double* data = mxGetPr(array);
+      for (size_t i = 0; i < size; ++i) {
+        if (!std::isfinite(data[i]) || data[i] < kLowest || data[i] >= kLimit)
+          continue;
+        SessionIdMap::const_iterator it =
+            ids.find(static_cast<int64_t>(data[i]));
+        if (it != ids.end() && static_cast<double>(it->first) == data[i])
+          data[i] = static_cast<double>(it->second);
+      }
+      break;
+    }
+    case mxINT64_CLASS:
+    case mxUINT64_CLASS: {
+      int64_t* data = static_cast<int64_t*>(mxGetData(array));
+      for (size_t i = 0; i < size; ++i) {
+        SessionIdMap::const_iterator it = ids.find(data[i]);
+        if (it != ids.end())
+          data[i] = it->second;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/** Process-wide call log writer used by MEX_DISPATCH.
+ */
+class CallRecorder {
+ public:
+  /** Get the recorder. The first call opens MEXPLUS_RECORD if set.
+   */
+  static CallRecorder* get() {
+    static CallRecorder recorder;
+    return &recorder;
+  }
+  /** Start appending calls to the file.
+   */
+  bool open(const std::string& filename) {
+    close();
+    output_.open(filename.c_str(), std::ios::binary | std::ios::app);
+    if (!output_.is_open())
+      return false;
+    if (output_.tellp() == std::streampos(0))
+      WriteCallLogHeader(&output_);
+    return output_.good();
+  }
+  /** Stop recording.
+   */
+  void close() {
+    if (output_.is_open())
+      output_.close();
+  }
+  bool isOpen() const { return output_.is_open(); }
+  /** Collect session ids while not recording, e.g., in the replay.
+   */
+  void trackSessions(bool enabled) { tracking_ = enabled; }
+  /** Note a session created by Session<T>::create().
+   */
+  void created(intptr_t id) {
+    if (tracking_ || isOpen())
+      created_.push_back(id);
+  }
+  /** Note a session destroyed by Session<T>::destroy().
+   */
+  void destroyed(intptr_t id) {
+    if (tracking_ || isOpen())
+      destroyed_.push_back(id);
+  }
+  /** Move out the session ids noted since the last call.
+   */
+  void takeSessions(std::vector<int64_t>* created,
+                    std::vector<int64_t>* destroyed) {
+    created->swap(created_);
+    destroyed->swap(destroyed_);
+    created_.clear();
+    destroyed_.clear();
+  }
+  /** Append a call and flush, so that the log survives a crash.
+   */
+  void write(const std::string& name,
+             int nlhs,
+             double seconds,
+             int nrhs,
+             const mxArray* prhs[]) {
+    std::vector<int64_t> created, destroyed;
+    takeSessions(&created, &destroyed);
+    WriteCallRecord(&output_, name, nlhs, seconds, nrhs, prhs, created,
+                    destroyed);
+    output_.flush();
+  }
+
+ private:
+  CallRecorder() : tracking_(false) {
+    const char* filename = std::getenv("MEXPLUS_RECORD");
+    if (filename && *filename && !open(filename))
+      mexWarnMsgIdAndTxt("mexplus:recorder:ioError",
+                         "Failed to open %s.", filename);
+  }
+  ~CallRecorder() { close(); }
+  CallRecorder(const CallRecorder&);
+  CallRecorder& operator=(const CallRecorder&);
+
+  std::ofstream output_;
+  bool tracking_;
+  /** Session ids noted in the current call.
+   */
+  std::vector<int64_t> created_;
+  std::vector<int64_t> destroyed_;
+};
+
+/** Times a call and records it when the recorder is open.
+ */
+class CallRecording {
+ public:
+  CallRecording(int nrhs, const mxArray* prhs[])
+      : recorder_(CallRecorder::get()),
+        recording_(recorder_->isOpen()),
+        nrhs_(nrhs),
+        prhs_(prhs) {
+    if (recording_) {
+      std::vector<int64_t> created, destroyed;
+      recorder_->takeSessions(&created, &destroyed);
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+  /** Record the call that returned normally.
+   */
+  void finish(const std::string& name, int nlhs) {
+    if (!recording_ || !recorder_->isOpen())
+      return;
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start_;
+    recorder_->write(name, nlhs, elapsed.count(), nrhs_, prhs_);
+  }
+
+ private:
+  CallRecorder* recorder_;
+  /** True if the recorder was open when the call started.
+   */
+  bool recording_;
+  int nrhs_;
+  const mxArray** prhs_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_RECORDER_H_
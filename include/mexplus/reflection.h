@@ -0,0 +1,436 @@
+/** Struct reflection macro for MxArray conversion.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * MEXPLUS_STRUCT() generates MxArray::from() and MxArray::to() conversions
+ * between a plain C++ struct and a Matlab struct, for a single object as well
+ * as for std::vector of objects, which maps to a 1-by-N struct array.
+ *
+ *    struct Environment {
+ *      int code;
+ *      string status;
+ *    };
+ *
+ *    MEXPLUS_STRUCT(Environment, code, status)
+ *
+ *    plhs[0] = MxArray::from(environment);   // 1x1 struct.
+ *    plhs[1] = MxArray::from(environments);  // 1xN struct array.
+ *    MxArray::to(prhs[0], &environment);
+ *    MxArray::to(prhs[1], &environments);    // Struct array or cell array.
+ *
+ * A vector of records can also be transferred column-wise, which maps to a
+ * scalar struct whose fields are N-by-1 columns. Numeric and logical fields
+ * become numeric columns filled in one strided pass, and the other fields
+ * become cell columns. This is the layout Matlab tables are built from.
+ *
+ *    plhs[0] = MxStruct<Environment>::fromColumns(environments);
+ *    MxStruct<Environment>::toColumns(prhs[0], &environments);
+ *
+ * Field numbers are resolved once per mxArray, and each element is accessed
+ * with mxGetFieldByNumber() and mxSetFieldByNumber() instead of looking up
+ * the field name for every element. The macro must appear in the global
+ * namespace with a fully qualified type name, and supports up to 16 fields.
+ *
+ */
+
+#ifndef INCLUDE_MEXPLUS_REFLECTION_H_
+#define INCLUDE_MEXPLUS_REFLECTION_H_
+
+#include <cstddef>
+#include <iterator>
+#include <vector>
+#include "mexplus/mxarray.h"
+
+/** Preprocessor helpers.
+ */
+#define MEXPLUS_PP_EXPAND(x) x
+#define MEXPLUS_PP_CONCAT(a, b) MEXPLUS_PP_CONCAT_IMPL(a, b)
+#define MEXPLUS_PP_CONCAT_IMPL(a, b) a##b
+#define MEXPLUS_PP_NARGS(...) MEXPLUS_PP_EXPAND(MEXPLUS_PP_NARGS_IMPL( \
+    __VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+#define MEXPLUS_PP_NARGS_IMPL(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, \
+                              _12, _13, _14, _15, _16, N, ...) N
+#define MEXPLUS_PP_FOR_EACH(macro, ...) \
+    MEXPLUS_PP_EXPAND(MEXPLUS_PP_CONCAT(MEXPLUS_PP_FOR_EACH_, \
+        MEXPLUS_PP_NARGS(__VA_ARGS__))(macro, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_1(m, x) m(x)
+#define MEXPLUS_PP_FOR_EACH_2(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_1(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_3(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_2(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_4(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_3(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_5(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_4(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_6(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_5(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_7(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_6(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_8(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_7(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_9(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_8(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_10(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_9(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_11(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_10(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_12(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_11(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_13(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_12(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_14(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_13(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_15(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_14(m, __VA_ARGS__))
+#define MEXPLUS_PP_FOR_EACH_16(m, x, ...) \
+    m(x) MEXPLUS_PP_EXPAND(MEXPLUS_PP_FOR_EACH_15(m, __VA_ARGS__))
+
+namespace mexplus {
+
+/** Iterator over one member of consecutive records, i.e., a strided view of a
+ * single column in an array of structs.
+ */
+template <typename Record, typename F>
+class MemberIterator {
+ public:
+  typedef std::forward_iterator_tag iterator_category;
+  typedef F value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef typename std::conditional<std::is_const<Record>::value,
+                                    const F*, F*>::type pointer;
+  typedef typename std::conditional<std::is_const<Record>::value,
+                                    const F&, F&>::type reference;
+  typedef F std::remove_const<Record>::type::* Member;
+
+  MemberIterator(Record* record, Member member) :
+      record_(record), member_(member) {}
+  reference operator*() const { return record_->*member_; }
+  MemberIterator& operator++() {
+    ++record_;
+    return *this;
+  }
+  MemberIterator operator++(int) {
+    MemberIterator it(*this);
+    ++record_;
+    return it;
+  }
+  bool operator==(const MemberIterator& rhs) const {
+    return record_ == rhs.record_;
+  }
+  bool operator!=(const MemberIterator& rhs) const {
+    return record_ != rhs.record_;
+  }
+
+ private:
+  Record* record_;
+  Member member_;
+};
+
+/** Field table of a reflected struct. MEXPLUS_STRUCT() specializes this.
+ *
+ * A specialization provides the following members.
+ *
+ *    enum { size = <number of fields> };
+ *    static const char** names();
+ *    static void set(mxArray* array, mwIndex index, const int* numbers,
+ *                    const T& value);
+ *    static void get(const mxArray* array, mwIndex index, const int* numbers,
+ *                    T* value);
+ *    static void setColumns(mxArray* array, const T* values, mwSize size);
+ *    static void getColumns(const mxArray* array, const int* numbers,
+ *                           T* values, mwSize size);
+ */
+template <typename T>
+struct MxStructFields;
+
+/** Conversion between reflected structs and Matlab struct arrays.
+ */
+template <typename T>
+class MxStruct {
+ public:
+  typedef MxStructFields<T> Fields;
+
+  /** Create a 1-by-size struct array from an array of objects.
+   */
+  static mxArray* from(const T* values, mwSize size) {
+    MxArray struct_array(MxArray::Struct(Fields::size,
+                                         Fields::names(),
+                                         1,
+                                         static_cast<int>(size)));
+    int numbers[Fields::size];
+    for (int i = 0; i < Fields::size; ++i)
+      numbers[i] = i;  // Fields are created in declaration order.
+    for (mwIndex index = 0; index < size; ++index)
+      Fields::set(struct_array.getMutable(), index, numbers, values[index]);
+    return struct_array.release();
+  }
+  /** Convert a struct array to an array of objects.
+   */
+  static void to(const mxArray* array, T* values, mwSize size) {
+    MEXPLUS_CHECK_NOTNULL(array);
+    MEXPLUS_ASSERT(mxIsStruct(array),
+                   "Expected a struct array but %s.",
+                   mxGetClassName(array));
+    MEXPLUS_ASSERT(size <= mxGetNumberOfElements(array),
+                   "Index out of range: %u.",
+                   size);
+    int numbers[Fields::size];
+    resolve(array, numbers);
+    for (mwIndex index = 0; index < size; ++index)
+      Fields::get(array, index, numbers, &values[index]);
+  }
+  /** Convert a struct array or a cell array of structs to a vector.
+   */
+  static void to(const mxArray* array, std::vector<T>* values) {
+    MEXPLUS_CHECK_NOTNULL(array);
+    MEXPLUS_CHECK_NOTNULL(values);
+    values->resize(mxGetNumberOfElements(array));
+    if (mxIsCell(array)) {
+      for (mwIndex index = 0; index < values->size(); ++index) {
+        const mxArray* element = mxGetCell(array, index);
+        MEXPLUS_CHECK_NOTNULL(element);
+        to(element, &(*values)[index], 1);
+      }
+    } else if (!values->empty()) {
+      to(array, &(*values)[0], values->size());
+    }
+  }
+  /** Create a scalar struct of N-by-1 columns from an array of records.
+   */
+  static mxArray* fromColumns(const T* values, mwSize size) {
+    MxArray struct_array(MxArray::Struct(Fields::size, Fields::names()));
+    Fields::setColumns(struct_array.getMutable(), values, size);
+    return struct_array.release();
+  }
+  static mxArray* fromColumns(const std::vector<T>& values) {
+    return fromColumns((values.empty()) ? NULL : &values[0], values.size());
+  }
+  /** Convert a scalar struct of columns to a vector of records.
+   */
+  static void toColumns(const mxArray* array, std::vector<T>* values) {
+    MEXPLUS_CHECK_NOTNULL(array);
+    MEXPLUS_CHECK_NOTNULL(values);
+    MEXPLUS_ASSERT(mxIsStruct(array) && mxGetNumberOfElements(array) == 1,
+                   "Expected a scalar struct but %s.",
+                   mxGetClassName(array));
+    int numbers[Fields::size];
+    resolve(array, numbers);
+    const mxArray* first_column = mxGetFieldByNumber(array, 0, numbers[0]);
+    values->resize((first_column) ? mxGetNumberOfElements(first_column) : 0);
+    if (!values->empty())
+      Fields::getColumns(array, numbers, &(*values)[0], values->size());
+  }
+  /** Set a numeric or logical column by number.
+   */
+  template <typename F>
+  static void setColumn(mxArray* array,
+                        int number,
+                        const T* values,
+                        mwSize size,
+                        F T::*member,
+                        typename std::enable_if<
+                          MxArithmeticType<F>::value ||
+                          MxLogicalType<F>::value
+                        >::type* = NULL) {
+    std::vector<mwSize> dimensions(2, 1);
+    dimensions[0] = size;
+    mxArray* column = (MxLogicalType<F>::value) ?
+        CreateLogicalArray(dimensions) :
+        CreateNumericArray(dimensions,
+                           MxTypes<F>::class_id,
+                           mxREAL,
+                           kUninitialized);
+    if (size > 0)
+      std::copy(MemberIterator<const T, F>(values, member),
+                MemberIterator<const T, F>(values + size, member),
+                reinterpret_cast<F*>(mxGetData(column)));
+    mxDestroyArray(mxGetFieldByNumber(array, 0, number));
+    mxSetFieldByNumber(array, 0, number, column);
+  }
+  /** Set any other column as an N-by-1 cell array.
+   */
+  template <typename F>
+  static void setColumn(mxArray* array,
+                        int number,
+                        const T* values,
+                        mwSize size,
+                        F T::*member,
+                        typename std::enable_if<
+                          !MxArithmeticType<F>::value &&
+                          !MxLogicalType<F>::value
+                        >::type* = NULL) {
+    MxArray column(MxArray::Cell(static_cast<int>(size), 1));
+    for (mwIndex index = 0; index < size; ++index)
+      mxSetCell(column.getMutable(),
+                index,
+                MxArray::from(values[index].*member));
+    mxDestroyArray(mxGetFieldByNumber(array, 0, number));
+    mxSetFieldByNumber(array, 0, number, column.release());
+  }
+  /** Get a column by number.
+   */
+  template <typename F>
+  static void getColumn(const mxArray* array,
+                        int number,
+                        T* values,
+                        mwSize size,
+                        F T::*member) {
+    const mxArray* column = mxGetFieldByNumber(array, 0, number);
+    const char* name = mxGetFieldNameByNumber(array, number);
+    MEXPLUS_ASSERT(column, "Empty field '%s'.", name);
+    MEXPLUS_ASSERT(mxGetNumberOfElements(column) == size,
+                   "Column '%s' has %u elements for %u.",
+                   name,
+                   mxGetNumberOfElements(column),
+                   size);
+    if (mxIsCell(column)) {
+      for (mwIndex index = 0; index < size; ++index) {
+        const mxArray* element = mxGetCell(column, index);
+        MEXPLUS_CHECK_NOTNULL(element);
+        MxArray::to(element, &(values[index].*member));
+      }
+    } else {
+      getNumericColumn(column, values, size, member);
+    }
+  }
+  /** Set a field value by number.
+   */
+  template <typename F>
+  static void setField(mxArray* array,
+                       mwIndex index,
+                       int number,
+                       const F& value) {
+    mxArray* new_item = MxArray::from(value);  // Safe in case if from() fails.
+    mxDestroyArray(mxGetFieldByNumber(array, index, number));
+    mxSetFieldByNumber(array, index, number, new_item);
+  }
+  /** Get a field value by number.
+   */
+  template <typename F>
+  static void getField(const mxArray* array,
+                       mwIndex index,
+                       int number,
+                       F* value) {
+    const mxArray* element = mxGetFieldByNumber(array, index, number);
+    MEXPLUS_ASSERT(element,
+                   "Empty field '%s' at %u.",
+                   mxGetFieldNameByNumber(array, number),
+                   index);
+    MxArray::to(element, value);
+  }
+
+ private:
+  /** Scatter a numeric, logical, or char column into records.
+   */
+  template <typename F>
+  static void getNumericColumn(const mxArray* column,
+                               T* values,
+                               mwSize size,
+                               F T::*member,
+                               typename std::enable_if<
+                                 MxArithmeticType<F>::value ||
+                                 MxLogicalType<F>::value ||
+                                 MxCharType<F>::value
+                               >::type* = NULL) {
+    MxArray::copyTo(column, 0, size, MemberIterator<T, F>(values, member));
+  }
+  template <typename F>
+  static void getNumericColumn(const mxArray* column,
+                               T* /* values */,
+                               mwSize /* size */,
+                               F T::* /* member */,
+                               typename std::enable_if<
+                                 !MxArithmeticType<F>::value &&
+                                 !MxLogicalType<F>::value &&
+                                 !MxCharType<F>::value
+                               >::type* = NULL) {
+    MEXPLUS_ERROR("Expected a cell column but %s.", mxGetClassName(column));
+  }
+  /** Resolve field numbers of the given struct array.
+   */
+  static void resolve(const mxArray* array, int* numbers) {
+    const char** names = Fields::names();
+    for (int i = 0; i < Fields::size; ++i) {
+      numbers[i] = mxGetFieldNumber(array, names[i]);
+      MEXPLUS_ASSERT(numbers[i] >= 0, "Missing field '%s'.", names[i]);
+    }
+  }
+};
+
+}  // namespace mexplus
+
+#define MEXPLUS_STRUCT_NAME(field) #field,
+#define MEXPLUS_STRUCT_SET(field) \
+    MxStruct<Type>::setField(array, index, numbers[n++], value.field);
+#define MEXPLUS_STRUCT_GET(field) \
+    MxStruct<Type>::getField(array, index, numbers[n++], &value->field);
+#define MEXPLUS_STRUCT_SET_COLUMN(field) \
+    MxStruct<Type>::setColumn(array, n++, values, size, &Type::field);
+#define MEXPLUS_STRUCT_GET_COLUMN(field) \
+    MxStruct<Type>::getColumn(array, numbers[n++], values, size, &Type::field);
+
+/** Define MxArray conversions of a struct by listing its fields. Example:
+ *
+ * MEXPLUS_STRUCT(Environment, code, status)
+ */
+#define MEXPLUS_STRUCT(type, ...) \
+namespace mexplus { \
+template <> \
+struct MxStructFields<type> { \
+  typedef type Type; \
+  enum { size = MEXPLUS_PP_NARGS(__VA_ARGS__) }; \
+  static const char** names() { \
+    static const char* kNames[] = { \
+      MEXPLUS_PP_FOR_EACH(MEXPLUS_STRUCT_NAME, __VA_ARGS__) \
+    }; \
+    return kNames; \
+  } \
+  static void set(mxArray* array, \
+                  mwIndex index, \
+                  const int* numbers, \
+                  const Type& value) { \
+    int n = 0; \
+    MEXPLUS_PP_FOR_EACH(MEXPLUS_STRUCT_SET, __VA_ARGS__) \
+  } \
+  static void get(const mxArray* array, \
+                  mwIndex index, \
+                  const int* numbers, \
+                  Type* value) { \
+    int n = 0; \
+    MEXPLUS_PP_FOR_EACH(MEXPLUS_STRUCT_GET, __VA_ARGS__) \
+  } \
+  static void setColumns(mxArray* array, \
+                         const Type* values, \
+                         mwSize size) { \
+    int n = 0; \
+    MEXPLUS_PP_FOR_EACH(MEXPLUS_STRUCT_SET_COLUMN, __VA_ARGS__) \
+  } \
+  static void getColumns(const mxArray* array, \
+                         const int* numbers, \
+                         Type* values, \
+                         mwSize size) { \
+    int n = 0; \
+    MEXPLUS_PP_FOR_EACH(MEXPLUS_STRUCT_GET_COLUMN, __VA_ARGS__) \
+  } \
+}; \
+template <> \
+inline mxArray* MxArray::from(const type& value) { \
+  return MxStruct<type>::from(&value, 1); \
+} \
+template <> \
+inline void MxArray::to(const mxArray* array, type* value) { \
+  MEXPLUS_CHECK_NOTNULL(value); \
+  MxStruct<type>::to(array, value, 1); \
+} \
+template <> \
+inline mxArray* MxArray::from(const std::vector<type>& value) { \
+  return MxStruct<type>::from((value.empty()) ? NULL : &value[0], \
+                              value.size()); \
+} \
+template <> \
+inline void MxArray::to(const mxArray* array, std::vector<type>* value) { \
+  MxStruct<type>::to(array, value); \
+} \
+}
+
+#endif  // INCLUDE_MEXPLUS_REFLECTION_H_
@@ -0,0 +1,170 @@
+/** Resident arrays kept in the MEX file across calls.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * Passing the same large input to every call converts it every time.
+ * ResidentArray converts an array once into aligned storage of the chosen
+ * type, and Session keeps it under a handle so that later calls resolve the
+ * handle to a typed view. Delta updates patch elements in place, so Matlab
+ * only sends what changed.
+ *
+ *    typedef Session<ResidentArray<float> > ResidentStore;
+ *
+ *    MEX_DEFINE(upload) (int nlhs, mxArray* plhs[],
+ *                        int nrhs, const mxArray* prhs[]) {
+ *      OutputArguments output(nlhs, plhs, 1);
+ *      output.set(0, ResidentStore::create(new ResidentArray<float>(prhs[0])));
+ *    }
+ *
+ *    MEX_DEFINE(step) (int nlhs, mxArray* plhs[],
+ *                      int nrhs, const mxArray* prhs[]) {
+ *      MxView<float> X = ResidentStore::get(prhs[0])->view();  // No copy.
+ *      ...
+ *    }
+ *
+ *    MEX_DEFINE(patch) (int nlhs, mxArray* plhs[],
+ *                       int nrhs, const mxArray* prhs[]) {
+ *      InputArguments input(nrhs, prhs, 3);
+ *      ResidentStore::get(prhs[0])->update(input.get<mwIndex>(1) - 1,
+ *                                          prhs[2]);
+ *    }
+ */
+
+#ifndef INCLUDE_MEXPLUS_RESIDENT_H_
+#define INCLUDE_MEXPLUS_RESIDENT_H_
+
+#include <mex.h>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "mexplus/allocation.h"
+#include "mexplus/dispatch.h"
+#include "mexplus/mxarray.h"
+#include "mexplus/mxview.h"
+
+namespace mexplus {
+
+/** Converted copy of an array in aligned storage owned by C++.
+ */
+template <typename T>
+class ResidentArray {
+ public:
+  static_assert(MxArithmeticType<T>::value || MxLogicalType<T>::value,
+                "ResidentArray supports real numeric or logical types.");
+  /** Default alignment in bytes, i.e. a cache line.
+   */
+  static const size_t kDefaultAlignment = 64;
+
+  /** Convert a numeric, logical, or char array into resident storage.
+   * @param array array to convert.
+   * @param alignment alignment of the storage in bytes, a power of two.
+   */
+  explicit ResidentArray(const mxArray* array,
+                         size_t alignment = kDefaultAlignment) {
+    MEXPLUS_CHECK_NOTNULL(array);
+    const mwSize* dimensions = mxGetDimensions(array);
+    allocate(std::vector<mwSize>(dimensions,
+                                 dimensions + mxGetNumberOfDimensions(array)),
+             alignment);
+    MxArray::toInto(array, data_, size_);
+  }
+  /** Create zero-filled resident storage of the given dimensions.
+   */
+  explicit ResidentArray(const std::vector<mwSize>& dimensions,
+                         size_t alignment = kDefaultAlignment) {
+    allocate(dimensions, alignment);
+    if (size_ > 0)
+      std::memset(data_, 0, size_ * sizeof(T));
+  }
+  T* data() const { return data_; }
+  mwSize size() const { return size_; }
+  const std::vector<mwSize>& dimensions() const { return dimensions_; }
+  /** Typed view over the resident storage.
+   */
+  MxView<T> view() const { return MxView<T>(data_, dimensions_); }
+  /** Overwrite a contiguous range starting at the 0-based offset.
+   * @param offset index of the first element to overwrite.
+   * @param values numeric, logical, or char array of new values.
+   */
+  void update(mwIndex offset, const mxArray* values) {
+    MEXPLUS_CHECK_NOTNULL(values);
+    MEXPLUS_ASSERT(offset <= size_,
+                   "Index out of range: %u.",
+                   static_cast<unsigned>(offset));
+    MxArray::toInto(values, data_ + offset, size_ - offset);
+  }
+  /** Overwrite scattered elements at the 0-based indices.
+   * @param indices indices of the elements to overwrite.
+   * @param values array of new values, one for each index.
+   */
+  void update(const std::vector<mwIndex>& indices, const mxArray* values) {
+    MEXPLUS_CHECK_NOTNULL(values);
+    MEXPLUS_ASSERT(indices.size() == mxGetNumberOfElements(values),
+                   "Expected %u values but %u.",
+                   static_cast<unsigned>(indices.size()),
+                   static_cast<unsigned>(mxGetNumberOfElements(values)));
+    for (size_t i = 0; i < indices.size(); ++i)
+      MEXPLUS_ASSERT(indices[i] < size_,
+                     "Index out of range: %u.",
+                     static_cast<unsigned>(indices[i]));
+    std::unique_ptr<T[]> buffer(new T[indices.size()]);
+    MxArray::toInto(values, buffer.get(), indices.size());
+    for (size_t i = 0; i < indices.size(); ++i)
+      data_[indices[i]] = buffer[i];
+  }
+  /** Copy the resident data to a new array.
+   * @return Unmanaged mxArray*. Always caller must destroy.
+   */
+  mxArray* download() const {
+    mxArray* array = (MxLogicalType<T>::value) ?
+        CreateLogicalArray(dimensions_) :
+        CreateNumericArray(dimensions_, MxTypes<T>::class_id, mxREAL,
+                           kUninitialized);
+    if (size_ > 0)
+      std::memcpy(mxGetData(array), data_, size_ * sizeof(T));
+    return array;
+  }
+
+ private:
+  /** Prohibit copy.
+   */
+  ResidentArray(const ResidentArray&);
+  ResidentArray& operator=(const ResidentArray&);
+  /** Allocate aligned storage.
+   */
+  void allocate(const std::vector<mwSize>& dimensions, size_t alignment) {
+    MEXPLUS_ASSERT(alignment >= sizeof(T) && alignment % sizeof(T) == 0 &&
+                   (alignment & (alignment - 1)) == 0,
+                   "Invalid alignment: %u.",
+                   static_cast<unsigned>(alignment));
+    dimensions_ = dimensions;
+    size_ = 1;
+    for (size_t i = 0; i < dimensions_.size(); ++i)
+      size_ *= dimensions_[i];
+    storage_.reset(new char[size_ * sizeof(T) + alignment]);
+    uintptr_t address = reinterpret_cast<uintptr_t>(storage_.get());
+    address = (address + alignment - 1) & ~(alignment - 1);
+    data_ = reinterpret_cast<T*>(address);
+  }
+
+  /** Dimensions of the data.
+   */
+  std::vector<mwSize> dimensions_;
+  /** Number of elements.
+   */
+  mwSize size_;
+  /** Aligned pointer to the first element.
+   */
+  T* data_;
+  /** Unaligned storage.
+   */
+  std::unique_ptr<char[]> storage_;
+};
+
+template <typename T>
+const size_t ResidentArray<T>::kDefaultAlignment;
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_RESIDENT_H_
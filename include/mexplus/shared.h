@@ -0,0 +1,128 @@
+/** Reference-counted array handle with copy-on-write.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * MxArray has a unique owner, so handing the same array to several consumers
+ * means either a deep copy by clone() or raw pointers. SharedMxArray shares
+ * one array among copies of the handle and duplicates it only when a holder
+ * asks for mutable access while others still refer to it.
+ *
+ *    SharedMxArray input(MxArray(prhs[0]));     // Borrowed, no copy.
+ *    SharedMxArray cache = input;               // Shared, no copy.
+ *    cache.mutableArray().set("field", 1);      // Duplicated here.
+ *    plhs[0] = cache.release();                 // No copy when unique.
+ *
+ * Ownership follows MxArray: a handle made from mxArray* or an owner MxArray
+ * destroys the array when the last copy goes away, while a handle made from
+ * const mxArray* never destroys it and duplicates on the first write.
+ */
+
+#ifndef INCLUDE_MEXPLUS_SHARED_H_
+#define INCLUDE_MEXPLUS_SHARED_H_
+
+#include <mex.h>
+#include <memory>
+#include <utility>
+#include "mexplus/mxarray.h"
+
+namespace mexplus {
+
+/** Shared mxArray handle with copy-on-write.
+ */
+class SharedMxArray {
+ public:
+  /** Empty handle.
+   */
+  SharedMxArray() {}
+  /** Take over an MxArray, either an owner or a borrowed one.
+   */
+  explicit SharedMxArray(MxArray&& array)
+      : array_(array ? std::make_shared<MxArray>(std::move(array)) : nullptr) {}
+  /** Share a const mxArray*. The array is never destroyed by the handle.
+   */
+  explicit SharedMxArray(const mxArray* array) { reset(array); }
+  /** Share a mutable mxArray*. The last handle destroys the array.
+   */
+  explicit SharedMxArray(mxArray* array) { reset(array); }
+  /** Share a new array converted from a value.
+   */
+  template <typename T>
+  explicit SharedMxArray(const T& value)
+      : array_(std::make_shared<MxArray>(value)) {}
+  /** Reset to a const mxArray*.
+   */
+  void reset(const mxArray* array = NULL) {
+    array_ = (array) ? std::make_shared<MxArray>(array) : nullptr;
+  }
+  /** Reset to a mutable mxArray*.
+   */
+  void reset(mxArray* array) {
+    array_ = (array) ? std::make_shared<MxArray>(array) : nullptr;
+  }
+  /** Release the mxArray*, or clone if shared or not owner.
+   * @return Unmanaged mxArray*. Always caller must destroy.
+   */
+  mxArray* release() {
+    MEXPLUS_CHECK_NOTNULL(array_.get());
+    mxArray* array = (isUnique()) ? array_->release() : array_->clone();
+    array_.reset();
+    return array;
+  }
+  /** Clone mxArray. This always allocates new mxArray*.
+   * @return Unmanaged mxArray*. Always caller must destroy.
+   */
+  mxArray* clone() const {
+    MEXPLUS_CHECK_NOTNULL(array_.get());
+    return array_->clone();
+  }
+  /** Conversion to const mxArray*.
+   */
+  const mxArray* get() const { return (array_) ? array_->get() : NULL; }
+  /** Get a mutable mxArray*, duplicating if shared or not owner.
+   */
+  mxArray* getMutable() { return mutableArray().getMutable(); }
+  /** Read access to the array, e.g., at() on cells and structs.
+   */
+  const MxArray& array() const {
+    MEXPLUS_CHECK_NOTNULL(array_.get());
+    return *array_;
+  }
+  /** Write access to the array, duplicating if shared or not owner.
+   */
+  MxArray& mutableArray() {
+    MEXPLUS_CHECK_NOTNULL(array_.get());
+    if (!isUnique() || !array_->isOwner())
+      array_ = std::make_shared<MxArray>(array_->clone());
+    return *array_;
+  }
+  /** Convert to the given type.
+   */
+  template <typename T>
+  T to() const { return array().to<T>(); }
+  /** Return true if the array is not NULL.
+   */
+  operator bool() const { return static_cast<bool>(array_); }
+  /** Number of handles sharing the array.
+   */
+  long useCount() const { return array_.use_count(); }
+  /** Return true if no other handle shares the array.
+   */
+  bool isUnique() const { return array_.use_count() == 1; }
+  /** Return true if the handles share the same array.
+   */
+  bool isSharedWith(const SharedMxArray& other) const {
+    return array_ && array_ == other.array_;
+  }
+  /** Swap operation.
+   */
+  void swap(SharedMxArray& rhs) { array_.swap(rhs.array_); }
+
+ private:
+  /** Shared wrapper. Its owner flag decides whether the array is destroyed.
+   */
+  std::shared_ptr<MxArray> array_;
+};
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_SHARED_H_
@@ -0,0 +1,194 @@
+/** Read-only view over a Matlab char array.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * MxStringView refers to the UTF-16 data of a char array in place, so that a
+ * key given from Matlab can be compared or hashed without making a
+ * std::string. Comparison and hashing against std::string follow the same
+ * UTF-8 transcoding as MxArray::to<std::string>(), with a fast path for
+ * ASCII text.
+ *
+ *    MxStringView key = input.get<MxStringView>(1);
+ *    if (key == "open") { ... }
+ *    size_t bucket = key.hash();  // Same as MxStringView::Hash()("open").
+ *    std::string text = key.str(); // Materialize only when needed.
+ *
+ * The view does not own the data. It must not outlive the mxArray.
+ */
+
+#ifndef INCLUDE_MEXPLUS_STRINGVIEW_H_
+#define INCLUDE_MEXPLUS_STRINGVIEW_H_
+
+#include <mex.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "mexplus/mxarray.h"
+#include "mexplus/unicode.h"
+
+namespace mexplus {
+
+/** Read-only view over UTF-16 char data.
+ */
+class MxStringView {
+ public:
+  typedef const mxChar* const_iterator;
+  /** Hash functor that agrees between MxStringView and std::string.
+   */
+  struct Hash {
+    size_t operator()(const MxStringView& value) const {
+      return value.hash();
+    }
+    size_t operator()(const std::string& value) const {
+      return hashUtf8(value.data(), value.size());
+    }
+  };
+
+  /** Empty view.
+   */
+  MxStringView() : data_(NULL), size_(0) {}
+  /** View over the given UTF-16 data.
+   */
+  MxStringView(const mxChar* data, size_t size) : data_(data), size_(size) {}
+  /** View over a char array.
+   */
+  explicit MxStringView(const mxArray* array) {
+    MEXPLUS_CHECK_NOTNULL(array);
+    MEXPLUS_ASSERT(mxIsChar(array),
+                   "Expected a char array but %s.",
+                   mxGetClassName(array));
+    data_ = mxGetChars(array);
+    size_ = mxGetNumberOfElements(array);
+  }
+  const mxChar* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+  mxChar operator[](size_t index) const { return data_[index]; }
+  /** Return true if all characters are in ASCII.
+   */
+  bool isAscii() const { return AsciiPrefixLength(data_, size_) == size_; }
+  /** Convert to a UTF-8 std::string.
+   */
+  std::string str() const {
+    std::string value(Utf8Length(data_, size_), '\0');
+    if (!value.empty())
+      Utf16ToUtf8(data_, size_, &value[0]);
+    return value;
+  }
+  /** Compare to UTF-8 data without conversion.
+   */
+  bool equals(const char* data, size_t size) const {
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = input + size;
+    const uint16_t* units = reinterpret_cast<const uint16_t*>(data_);
+    size_t i = 0;
+    while (input < end) {
+      if (*input < 0x80) {
+        if (i == size_ || units[i++] != *(input++))
+          return false;
+        continue;
+      }
+      int consumed;
+      uint32_t code_point = DecodeUtf8(input, end, &consumed);
+      input += consumed;
+      if (code_point >= 0x10000) {
+        code_point -= 0x10000;
+        if (i + 1 >= size_ ||
+            units[i++] != 0xD800 + (code_point >> 10) ||
+            units[i++] != 0xDC00 + (code_point & 0x3FF))
+          return false;
+      } else if (i == size_ || units[i++] != code_point) {
+        return false;
+      }
+    }
+    return i == size_;
+  }
+  bool equals(const std::string& value) const {
+    return equals(value.data(), value.size());
+  }
+  bool equals(const MxStringView& value) const {
+    return size_ == value.size_ &&
+           std::equal(data_, data_ + size_, value.data_);
+  }
+  /** FNV-1a hash over UTF-16 code units.
+   */
+  size_t hash() const {
+    const uint16_t* units = reinterpret_cast<const uint16_t*>(data_);
+    uint64_t value = kOffsetBasis;
+    for (size_t i = 0; i < size_; ++i)
+      value = (value ^ units[i]) * kPrime;
+    return static_cast<size_t>(value);
+  }
+  /** FNV-1a hash of UTF-8 data, equal to the hash of its UTF-16 view.
+   */
+  static size_t hashUtf8(const char* data, size_t size) {
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = input + size;
+    uint64_t value = kOffsetBasis;
+    while (input < end) {
+      if (*input < 0x80) {
+        value = (value ^ *(input++)) * kPrime;
+        continue;
+      }
+      int consumed;
+      uint32_t code_point = DecodeUtf8(input, end, &consumed);
+      input += consumed;
+      if (code_point >= 0x10000) {
+        code_point -= 0x10000;
+        value = (value ^ (0xD800 + (code_point >> 10))) * kPrime;
+        value = (value ^ (0xDC00 + (code_point & 0x3FF))) * kPrime;
+      } else {
+        value = (value ^ code_point) * kPrime;
+      }
+    }
+    return static_cast<size_t>(value);
+  }
+
+ private:
+  static const uint64_t kOffsetBasis = 14695981039346656037ULL;
+  static const uint64_t kPrime = 1099511628211ULL;
+
+  /** Pointer to the first character.
+   */
+  const mxChar* data_;
+  /** Number of characters.
+   */
+  size_t size_;
+};
+
+inline bool operator==(const MxStringView& lhs, const MxStringView& rhs) {
+  return lhs.equals(rhs);
+}
+inline bool operator==(const MxStringView& lhs, const std::string& rhs) {
+  return lhs.equals(rhs);
+}
+inline bool operator==(const std::string& lhs, const MxStringView& rhs) {
+  return rhs.equals(lhs);
+}
+inline bool operator==(const MxStringView& lhs, const char* rhs) {
+  return lhs.equals(rhs, std::char_traits<char>::length(rhs));
+}
+inline bool operator!=(const MxStringView& lhs, const MxStringView& rhs) {
+  return !lhs.equals(rhs);
+}
+inline bool operator!=(const MxStringView& lhs, const std::string& rhs) {
+  return !lhs.equals(rhs);
+}
+inline bool operator!=(const MxStringView& lhs, const char* rhs) {
+  return !(lhs == rhs);
+}
+
+/** Make a view from a char array, i.e. input.get<MxStringView>(0).
+ */
+template <>
+inline void MxArray::to(const mxArray* array, MxStringView* value) {
+  MEXPLUS_CHECK_NOTNULL(value);
+  *value = MxStringView(array);
+}
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_STRINGVIEW_H_
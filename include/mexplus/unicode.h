@@ -0,0 +1,253 @@
+/** UTF-8 and UTF-16 transcoding for Matlab char arrays.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * Matlab keeps a char array in UTF-16 code units (mxChar), while std::string
+ * in C++ is conventionally UTF-8. The functions here convert between the two
+ * encodings, including surrogate pairs. Pure ASCII blocks are narrowed or
+ * widened 16 characters at a time with SSE2 when available.
+ *
+ *    size_t size = Utf16Length(text.data(), text.size());
+ *    Utf8ToUtf16(text.data(), text.size(), mxGetChars(array));
+ *
+ * A byte that does not form a valid UTF-8 sequence decodes to the code unit of
+ * the same value, as in Latin-1, which encodes back as valid UTF-8. Such bytes
+ * therefore do not round trip through a char array; keep binary data in a
+ * uint8 array instead. Encoding replaces an unpaired surrogate with U+FFFD.
+ */
+
+#ifndef INCLUDE_MEXPLUS_UNICODE_H_
+#define INCLUDE_MEXPLUS_UNICODE_H_
+
+#include <mex.h>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MEXPLUS_UNICODE_SSE2
+#endif
+
+namespace mexplus {
+
+/** Decode one code point from UTF-8, or a single byte if it is invalid.
+ * @param data pointer to the first byte.
+ * @param end pointer to the end of the input.
+ * @param size number of bytes consumed.
+ * @return decoded code point.
+ */
+inline uint32_t DecodeUtf8(const unsigned char* data,
+                           const unsigned char* end,
+                           int* size) {
+  uint32_t lead = data[0];
+  *size = 1;
+  int length;
+  uint32_t code_point;
+  uint32_t minimum;
+  if (lead < 0x80)
+    return lead;
+  else if (lead >= 0xC2 && lead <= 0xDF)
+    length = 2, code_point = lead & 0x1F, minimum = 0x80;
+  else if (lead >= 0xE0 && lead <= 0xEF)
+    length = 3, code_point = lead & 0x0F, minimum = 0x800;
+  else if (lead >= 0xF0 && lead <= 0xF4)
+    length = 4, code_point = lead & 0x07, minimum = 0x10000;
+  else
+    return lead;
+  if (end - data < length)
+    return lead;
+  for (int i = 1; i < length; ++i) {
+    if ((data[i] & 0xC0) != 0x80)
+      return lead;
+    code_point = (code_point << 6) | (data[i] & 0x3F);
+  }
+  if (code_point < minimum || code_point > 0x10FFFF ||
+      (code_point >= 0xD800 && code_point <= 0xDFFF))
+    return lead;
+  *size = length;
+  return code_point;
+}
+
+/** Length of the ASCII prefix of UTF-8 data, checked in blocks.
+ */
+inline size_t AsciiPrefixLength(const char* data, size_t size) {
+  size_t i = 0;
+#ifdef MEXPLUS_UNICODE_SSE2
+  for (; i + 16 <= size; i += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    if (_mm_movemask_epi8(block))
+      break;
+  }
+#endif
+  while (i < size && !(data[i] & 0x80))
+    ++i;
+  return i;
+}
+
+/** Length of the ASCII prefix of UTF-16 data, checked in blocks.
+ */
+inline size_t AsciiPrefixLength(const mxChar* data, size_t size) {
+  const uint16_t* units = reinterpret_cast<const uint16_t*>(data);
+  size_t i = 0;
+#ifdef MEXPLUS_UNICODE_SSE2
+  const __m128i kMask = _mm_set1_epi16(static_cast<short>(0xFF80));
+  const __m128i kZero = _mm_setzero_si128();
+  for (; i + 16 <= size; i += 16) {
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(units + i));
+    __m128i high = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(units + i + 8));
+    __m128i bits = _mm_and_si128(_mm_or_si128(low, high), kMask);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(bits, kZero)) != 0xFFFF)
+      break;
+  }
+#endif
+  while (i < size && units[i] < 0x80)
+    ++i;
+  return i;
+}
+
+/** Number of UTF-16 code units to represent UTF-8 data.
+ */
+inline size_t Utf16Length(const char* data, size_t size) {
+  const unsigned char* input = reinterpret_cast<const unsigned char*>(data);
+  const unsigned char* end = input + size;
+  size_t length = 0;
+  while (input < end) {
+    size_t ascii = AsciiPrefixLength(reinterpret_cast<const char*>(input),
+                                     end - input);
+    input += ascii;
+    length += ascii;
+    if (input == end)
+      break;
+    int consumed;
+    uint32_t code_point = DecodeUtf8(input, end, &consumed);
+    input += consumed;
+    length += (code_point >= 0x10000) ? 2 : 1;
+  }
+  return length;
+}
+
+/** Convert UTF-8 data to UTF-16. Output must have Utf16Length() elements.
+ * @return pointer to the end of the output.
+ */
+inline mxChar* Utf8ToUtf16(const char* data, size_t size, mxChar* output) {
+  const unsigned char* input = reinterpret_cast<const unsigned char*>(data);
+  const unsigned char* end = input + size;
+  while (input < end) {
+#ifdef MEXPLUS_UNICODE_SSE2
+    const __m128i kZero = _mm_setzero_si128();
+    while (end - input >= 16) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+      if (_mm_movemask_epi8(block))
+        break;
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(output),
+                       _mm_unpacklo_epi8(block, kZero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 8),
+                       _mm_unpackhi_epi8(block, kZero));
+      input += 16;
+      output += 16;
+    }
+#endif
+    while (input < end && *input < 0x80)
+      *(output++) = static_cast<mxChar>(*(input++));
+    if (input == end)
+      break;
+    int consumed;
+    uint32_t code_point = DecodeUtf8(input, end, &consumed);
+    input += consumed;
+    if (code_point >= 0x10000) {
+      code_point -= 0x10000;
+      *(output++) = static_cast<mxChar>(0xD800 + (code_point >> 10));
+      *(output++) = static_cast<mxChar>(0xDC00 + (code_point & 0x3FF));
+    } else {
+      *(output++) = static_cast<mxChar>(code_point);
+    }
+  }
+  return output;
+}
+
+/** Number of UTF-8 bytes to represent UTF-16 data.
+ */
+inline size_t Utf8Length(const mxChar* data, size_t size) {
+  const uint16_t* units = reinterpret_cast<const uint16_t*>(data);
+  size_t length = 0;
+  size_t i = 0;
+  while (i < size) {
+    size_t ascii = AsciiPrefixLength(data + i, size - i);
+    i += ascii;
+    length += ascii;
+    if (i == size)
+      break;
+    uint16_t unit = units[i++];
+    if (unit < 0x800) {
+      length += 2;
+    } else if (unit >= 0xD800 && unit <= 0xDBFF && i < size &&
+               units[i] >= 0xDC00 && units[i] <= 0xDFFF) {
+      length += 4;
+      ++i;
+    } else {
+      length += 3;  // Including U+FFFD for an unpaired surrogate.
+    }
+  }
+  return length;
+}
+
+/** Convert UTF-16 data to UTF-8. Output must have Utf8Length() bytes.
+ * @return pointer to the end of the output.
+ */
+inline char* Utf16ToUtf8(const mxChar* data, size_t size, char* output) {
+  const uint16_t* units = reinterpret_cast<const uint16_t*>(data);
+  size_t i = 0;
+  while (i < size) {
+#ifdef MEXPLUS_UNICODE_SSE2
+    const __m128i kMask = _mm_set1_epi16(static_cast<short>(0xFF80));
+    const __m128i kZero = _mm_setzero_si128();
+    while (i + 16 <= size) {
+      __m128i low = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(units + i));
+      __m128i high = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(units + i + 8));
+      __m128i bits = _mm_and_si128(_mm_or_si128(low, high), kMask);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(bits, kZero)) != 0xFFFF)
+        break;
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(output),
+                       _mm_packus_epi16(low, high));
+      i += 16;
+      output += 16;
+    }
+#endif
+    while (i < size && units[i] < 0x80)
+      *(output++) = static_cast<char>(units[i++]);
+    if (i == size)
+      break;
+    uint32_t code_point = units[i++];
+    if (code_point >= 0xD800 && code_point <= 0xDFFF) {
+      if (code_point <= 0xDBFF && i < size &&
+          units[i] >= 0xDC00 && units[i] <= 0xDFFF) {
+        code_point = 0x10000 + ((code_point - 0xD800) << 10) +
+                     (units[i++] - 0xDC00);
+      } else {
+        code_point = 0xFFFD;
+      }
+    }
+    if (code_point < 0x800) {
+      *(output++) = static_cast<char>(0xC0 | (code_point >> 6));
+      *(output++) = static_cast<char>(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+      *(output++) = static_cast<char>(0xE0 | (code_point >> 12));
+      *(output++) = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+      *(output++) = static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+      *(output++) = static_cast<char>(0xF0 | (code_point >> 18));
+      *(output++) = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+      *(output++) = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+      *(output++) = static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+  }
+  return output;
+}
+
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEXPLUS_UNICODE_H_
@@ -110,6 +110,9 @@ function buildTarget(target, varargin)
   elseif isunix()
     varargin = [varargin, 'CXXFLAGS="$CXXFLAGS -std=c++11"'];
   end
+  if ~exist('OCTAVE_VERSION', 'builtin') && ~verLessThan('matlab', '8.5')
+    varargin = [varargin, '-DMEXPLUS_UNINIT_ARRAY'];
+  end
   command = sprintf('mex%s -output ''%s'' %s%s', ...
                     sprintf(' ''%s''', target.sources{:}), ...
                     target.name, ...
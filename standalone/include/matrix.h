@@ -0,0 +1,170 @@
+/** Stand-in for the MATLAB matrix API (matrix.h).
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * Declares the subset of the mx* API used by mexplus, with the same array
+ * layout semantics as MATLAB's separate-complex storage: column-major data,
+ * separate real and imaginary buffers, UTF-16 mxChar, cells and structs as
+ * arrays of mxArray pointers, and compressed sparse columns (ir/jc).
+ */
+
+#ifndef INCLUDE_MATRIX_H_
+#define INCLUDE_MATRIX_H_
+
+#include <cstddef>
+#include <cstdint>
+
+typedef std::size_t mwSize;
+typedef std::size_t mwIndex;
+typedef std::ptrdiff_t mwSignedIndex;
+typedef char16_t mxChar;
+typedef bool mxLogical;
+
+typedef enum {
+  mxUNKNOWN_CLASS = 0,
+  mxCELL_CLASS,
+  mxSTRUCT_CLASS,
+  mxLOGICAL_CLASS,
+  mxCHAR_CLASS,
+  mxVOID_CLASS,
+  mxDOUBLE_CLASS,
+  mxSINGLE_CLASS,
+  mxINT8_CLASS,
+  mxUINT8_CLASS,
+  mxINT16_CLASS,
+  mxUINT16_CLASS,
+  mxINT32_CLASS,
+  mxUINT32_CLASS,
+  mxINT64_CLASS,
+  mxUINT64_CLASS,
+  mxFUNCTION_CLASS,
+  mxOPAQUE_CLASS,
+  mxOBJECT_CLASS
+} mxClassID;
+
+typedef enum {
+  mxREAL = 0,
+  mxCOMPLEX
+} mxComplexity;
+
+typedef struct mxArray_tag mxArray;
+
+/* Memory management. */
+void* mxMalloc(std::size_t n);
+void* mxCalloc(std::size_t n, std::size_t size);
+void* mxRealloc(void* pointer, std::size_t size);
+void mxFree(void* pointer);
+
+/* Creation and destruction. */
+mxArray* mxCreateNumericMatrix(mwSize m, mwSize n, mxClassID class_id,
+                               mxComplexity flag);
+mxArray* mxCreateNumericArray(mwSize ndim, const mwSize* dims,
+                              mxClassID class_id, mxComplexity flag);
+mxArray* mxCreateUninitNumericMatrix(std::size_t m, std::size_t n,
+                                     mxClassID class_id, mxComplexity flag);
+mxArray* mxCreateUninitNumericArray(std::size_t ndim, std::size_t* dims,
+                                    mxClassID class_id, mxComplexity flag);
+mxArray* mxCreateDoubleMatrix(mwSize m, mwSize n, mxComplexity flag);
+mxArray* mxCreateDoubleScalar(double value);
+mxArray* mxCreateLogicalMatrix(mwSize m, mwSize n);
+mxArray* mxCreateLogicalArray(mwSize ndim, const mwSize* dims);
+mxArray* mxCreateLogicalScalar(mxLogical value);
+mxArray* mxCreateString(const char* str);
+mxArray* mxCreateCharArray(mwSize ndim, const mwSize* dims);
+mxArray* mxCreateCharMatrixFromStrings(mwSize m, const char** str);
+mxArray* mxCreateCellMatrix(mwSize m, mwSize n);
+mxArray* mxCreateCellArray(mwSize ndim, const mwSize* dims);
+mxArray* mxCreateStructMatrix(mwSize m, mwSize n, int nfields,
+                              const char** fieldnames);
+mxArray* mxCreateStructArray(mwSize ndim, const mwSize* dims, int nfields,
+                             const char** fieldnames);
+mxArray* mxCreateSparse(mwSize m, mwSize n, mwSize nzmax,
+                        mxComplexity flag);
+mxArray* mxCreateSparseLogicalMatrix(mwSize m, mwSize n, mwSize nzmax);
+mxArray* mxDuplicateArray(const mxArray* array);
+void mxDestroyArray(mxArray* array);
+
+/* Type queries. */
+mxClassID mxGetClassID(const mxArray* array);
+const char* mxGetClassName(const mxArray* array);
+bool mxIsClass(const mxArray* array, const char* name);
+bool mxIsCell(const mxArray* array);
+bool mxIsStruct(const mxArray* array);
+bool mxIsChar(const mxArray* array);
+bool mxIsLogical(const mxArray* array);
+bool mxIsLogicalScalar(const mxArray* array);
+bool mxIsLogicalScalarTrue(const mxArray* array);
+bool mxIsNumeric(const mxArray* array);
+bool mxIsDouble(const mxArray* array);
+bool mxIsSingle(const mxArray* array);
+bool mxIsInt8(const mxArray* array);
+bool mxIsUint8(const mxArray* array);
+bool mxIsInt16(const mxArray* array);
+bool mxIsUint16(const mxArray* array);
+bool mxIsInt32(const mxArray* array);
+bool mxIsUint32(const mxArray* array);
+bool mxIsInt64(const mxArray* array);
+bool mxIsUint64(const mxArray* array);
+bool mxIsComplex(const mxArray* array);
+bool mxIsSparse(const mxArray* array);
+bool mxIsEmpty(const mxArray* array);
+bool mxIsFromGlobalWS(const mxArray* array);
+bool mxIsFinite(double value);
+bool mxIsInf(double value);
+bool mxIsNaN(double value);
+double mxGetInf(void);
+double mxGetNaN(void);
+double mxGetEps(void);
+
+/* Shape. */
+std::size_t mxGetNumberOfElements(const mxArray* array);
+mwSize mxGetNumberOfDimensions(const mxArray* array);
+const mwSize* mxGetDimensions(const mxArray* array);
+int mxSetDimensions(mxArray* array, const mwSize* dims, mwSize ndim);
+std::size_t mxGetM(const mxArray* array);
+std::size_t mxGetN(const mxArray* array);
+void mxSetM(mxArray* array, mwSize m);
+void mxSetN(mxArray* array, mwSize n);
+std::size_t mxGetElementSize(const mxArray* array);
+mwIndex mxCalcSingleSubscript(const mxArray* array, mwSize nsubs,
+                              const mwIndex* subs);
+
+/* Data access. */
+void* mxGetData(const mxArray* array);
+void mxSetData(mxArray* array, void* data);
+void* mxGetImagData(const mxArray* array);
+void mxSetImagData(mxArray* array, void* data);
+double* mxGetPr(const mxArray* array);
+void mxSetPr(mxArray* array, double* data);
+double* mxGetPi(const mxArray* array);
+void mxSetPi(mxArray* array, double* data);
+double mxGetScalar(const mxArray* array);
+mxChar* mxGetChars(const mxArray* array);
+mxLogical* mxGetLogicals(const mxArray* array);
+int mxGetString(const mxArray* array, char* buffer, mwSize buflen);
+char* mxArrayToString(const mxArray* array);
+
+/* Sparse. */
+mwIndex* mxGetIr(const mxArray* array);
+mwIndex* mxGetJc(const mxArray* array);
+mwSize mxGetNzmax(const mxArray* array);
+void mxSetNzmax(mxArray* array, mwSize nzmax);
+
+/* Cells. */
+mxArray* mxGetCell(const mxArray* array, mwIndex index);
+void mxSetCell(mxArray* array, mwIndex index, mxArray* value);
+
+/* Structs. */
+int mxGetNumberOfFields(const mxArray* array);
+const char* mxGetFieldNameByNumber(const mxArray* array, int number);
+int mxGetFieldNumber(const mxArray* array, const char* name);
+int mxAddField(mxArray* array, const char* name);
+void mxRemoveField(mxArray* array, int number);
+mxArray* mxGetField(const mxArray* array, mwIndex index, const char* name);
+void mxSetField(mxArray* array, mwIndex index, const char* name,
+                mxArray* value);
+mxArray* mxGetFieldByNumber(const mxArray* array, mwIndex index, int number);
+void mxSetFieldByNumber(mxArray* array, mwIndex index, int number,
+                        mxArray* value);
+
+#endif  // INCLUDE_MATRIX_H_
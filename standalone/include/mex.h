@@ -0,0 +1,107 @@
+/** Stand-in for the MATLAB MEX API (mex.h).
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * Declares the subset of the mex* API used by mexplus so that MEX sources can
+ * be built and run as native executables. Errors raised through
+ * mexErrMsgIdAndTxt() are thrown as mexplus::standalone::Error, which plays
+ * the role of MATLAB's longjmp back into the interpreter.
+ */
+
+#ifndef INCLUDE_MEX_H_
+#define INCLUDE_MEX_H_
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include "matrix.h"
+
+void mexFunction(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+
+void mexErrMsgTxt(const char* message);
+void mexErrMsgIdAndTxt(const char* identifier, const char* format, ...);
+void mexWarnMsgTxt(const char* message);
+void mexWarnMsgIdAndTxt(const char* identifier, const char* format, ...);
+int mexPrintf(const char* format, ...);
+int mexCallMATLAB(int nlhs, mxArray* plhs[], int nrhs, mxArray* prhs[],
+                  const char* name);
+void mexMakeArrayPersistent(mxArray* array);
+void mexMakeMemoryPersistent(void* pointer);
+void mexLock(void);
+void mexUnlock(void);
+bool mexIsLocked(void);
+int mexAtExit(void (*function)(void));
+const char* mexFunctionName(void);
+
+namespace mexplus {
+namespace standalone {
+
+/** Exception thrown by mexErrMsgIdAndTxt() and mexErrMsgTxt().
+ */
+class Error : public std::runtime_error {
+ public:
+  Error(const std::string& identifier, const std::string& message) :
+      std::runtime_error(message), identifier_(identifier) {}
+  virtual ~Error() throw() {}
+  const std::string& identifier() const { return identifier_; }
+
+ private:
+  std::string identifier_;
+};
+
+/** Native implementation of a function reachable through mexCallMATLAB().
+ */
+typedef std::function<void(int nlhs, mxArray* plhs[],
+                           int nrhs, mxArray* prhs[])> Function;
+
+/** Register a function callable by name through mexCallMATLAB(). The name
+ * "feval" dispatches on a function handle created by functionHandle().
+ */
+void registerFunction(const std::string& name, const Function& function);
+/** Create a function handle array that refers to a registered function.
+ * mexCallMATLAB() also creates one through "str2func".
+ */
+mxArray* functionHandle(const std::string& name);
+/** Name of the function referred to by a function handle array.
+ */
+std::string functionName(const mxArray* handle);
+/** Call mexFunction() as MATLAB does. Arrays created during the call are
+ * destroyed when it returns, except the outputs, persistent arrays, and those
+ * stored in a cell or a struct. A failed call also destroys its outputs. plhs
+ * must hold max(nlhs, 1) elements, or be NULL if nlhs is 0.
+ */
+inline void callMexFunction(int nlhs, mxArray* plhs[], int nrhs,
+                            const mxArray* prhs[]);
+/** Start a call. Arrays created until the matching endCall() are temporary.
+ */
+void beginCall();
+/** End a call and destroy its temporary arrays. Outputs are kept only if the
+ * call succeeded.
+ */
+void endCall(int nlhs, mxArray* plhs[], bool succeeded);
+/** Current mexLock() count.
+ */
+int lockCount();
+/** Number of mxArrays currently alive, for leak checks.
+ */
+long liveArrays();
+/** Call mexAtExit() handlers and reset the runtime state.
+ */
+void shutdown();
+
+inline void callMexFunction(int nlhs, mxArray* plhs[], int nrhs,
+                            const mxArray* prhs[]) {
+  beginCall();
+  try {
+    mexFunction(nlhs, plhs, nrhs, prhs);
+  } catch (...) {
+    endCall(nlhs, plhs, false);
+    throw;
+  }
+  endCall(nlhs, plhs, true);
+}
+
+}  // namespace standalone
+}  // namespace mexplus
+
+#endif  // INCLUDE_MEX_H_
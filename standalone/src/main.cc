@@ -0,0 +1,22 @@
+/** Entry point to run a MEX test as a native executable.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * Calls mexFunction() without arguments, as testAll.m does for the tests that
+ * run all their checks on a single call, and turns a MEX error into a nonzero
+ * exit status. Temporary arrays are destroyed after the call as in Matlab.
+ */
+
+#include <mex.h>
+#include <cstdio>
+
+int main(int /* argc */, char** /* argv */) {
+  try {
+    mexplus::standalone::callMexFunction(0, NULL, 0, NULL);
+  } catch (const mexplus::standalone::Error& e) {
+    std::fprintf(stderr, "Error (%s): %s\n", e.identifier().c_str(), e.what());
+    return 1;
+  }
+  mexplus::standalone::shutdown();
+  return 0;
+}
@@ -0,0 +1,974 @@
+/** Stand-in implementation of the MATLAB MEX and matrix API.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * The implementation keeps MATLAB's data layout so that code written against
+ * mxGetData(), mxGetChars(), mxGetPi() and friends behaves identically. Data
+ * buffers are allocated with mxMalloc(), so mxSetData() can adopt them and
+ * mxDestroyArray() releases them with mxFree().
+ *
+ * As in MATLAB, arrays created during a call through callMexFunction() are
+ * temporary. Those that are not outputs, not persistent, and not stored in a
+ * cell or a struct are destroyed when the call returns.
+ */
+
+#include <mex.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+struct mxArray_tag {
+  mxClassID class_id;
+  bool complex;
+  bool sparse;
+  std::vector<mwSize> dims;
+  void* real;
+  void* imag;
+  // Sparse storage.
+  mwIndex* ir;
+  mwIndex* jc;
+  mwSize nzmax;
+  // Struct field names. Struct data is stored in real as mxArray*[n * nf].
+  std::vector<std::string> fields;
+  // Function handle name.
+  std::string function;
+};
+
+namespace {
+
+using mexplus::standalone::Error;
+using mexplus::standalone::Function;
+
+long g_live_arrays = 0;
+int g_lock_count = 0;
+int g_call_depth = 0;
+
+// Never destroyed, as owners of persistent arrays may outlive it.
+std::set<mxArray*>* temporaryArrays() {
+  static std::set<mxArray*>* arrays = new std::set<mxArray*>();
+  return arrays;
+}
+
+// Count a new array, and make it temporary inside a call.
+void track(mxArray* array) {
+  ++g_live_arrays;
+  if (g_call_depth > 0)
+    temporaryArrays()->insert(array);
+}
+
+void untrack(mxArray* array) {
+  temporaryArrays()->erase(array);
+}
+
+void destroyTemporaries() {
+  std::set<mxArray*> arrays;
+  arrays.swap(*temporaryArrays());
+  for (std::set<mxArray*>::iterator it = arrays.begin();
+       it != arrays.end();
+       ++it)
+    mxDestroyArray(*it);
+}
+
+std::map<std::string, Function>* functionRegistry() {
+  static std::map<std::string, Function> registry;
+  return &registry;
+}
+
+std::vector<void (*)(void)>* exitHandlers() {
+  static std::vector<void (*)(void)> handlers;
+  return &handlers;
+}
+
+std::string formatMessage(const char* format, va_list arguments) {
+  va_list copy;
+  va_copy(copy, arguments);
+  int size = std::vsnprintf(NULL, 0, format, copy);
+  va_end(copy);
+  if (size < 0)
+    return std::string(format);
+  std::vector<char> buffer(size + 1);
+  std::vsnprintf(&buffer[0], buffer.size(), format, arguments);
+  return std::string(&buffer[0], size);
+}
+
+std::size_t classElementSize(mxClassID class_id) {
+  switch (class_id) {
+    case mxCELL_CLASS:
+    case mxSTRUCT_CLASS:   return sizeof(mxArray*);
+    case mxLOGICAL_CLASS:  return sizeof(mxLogical);
+    case mxCHAR_CLASS:     return sizeof(mxChar);
+    case mxDOUBLE_CLASS:   return sizeof(double);
+    case mxSINGLE_CLASS:   return sizeof(float);
+    case mxINT8_CLASS:
+    case mxUINT8_CLASS:    return 1;
+    case mxINT16_CLASS:
+    case mxUINT16_CLASS:   return 2;
+    case mxINT32_CLASS:
+    case mxUINT32_CLASS:   return 4;
+    case mxINT64_CLASS:
+    case mxUINT64_CLASS:   return 8;
+    default:               return 0;
+  }
+}
+
+bool isNumericClass(mxClassID class_id) {
+  return class_id >= mxDOUBLE_CLASS && class_id <= mxUINT64_CLASS;
+}
+
+std::size_t countElements(const std::vector<mwSize>& dims) {
+  std::size_t count = 1;
+  for (std::size_t i = 0; i < dims.size(); ++i)
+    count *= dims[i];
+  return count;
+}
+
+void normalizeDimensions(std::vector<mwSize>* dims) {
+  while (dims->size() > 2 && dims->back() == 1)
+    dims->pop_back();
+  while (dims->size() < 2)
+    dims->push_back(dims->empty() ? 0 : 1);
+}
+
+/** Number of slots in the real buffer.
+ */
+std::size_t storageSize(const mxArray* array) {
+  if (array->sparse)
+    return array->nzmax;
+  std::size_t count = countElements(array->dims);
+  if (array->class_id == mxSTRUCT_CLASS)
+    count *= array->fields.size();
+  return count;
+}
+
+mxArray* newArray(mxClassID class_id,
+                  const std::vector<mwSize>& dims,
+                  bool complex,
+                  bool initialize) {
+  mxArray* array = new mxArray_tag();
+  array->class_id = class_id;
+  array->complex = complex;
+  array->sparse = false;
+  array->dims = dims;
+  normalizeDimensions(&array->dims);
+  array->real = NULL;
+  array->imag = NULL;
+  array->ir = NULL;
+  array->jc = NULL;
+  array->nzmax = 0;
+  std::size_t bytes = countElements(array->dims) * classElementSize(class_id);
+  if (bytes > 0) {
+    array->real = (initialize) ? mxCalloc(bytes, 1) : mxMalloc(bytes);
+    if (complex)
+      array->imag = (initialize) ? mxCalloc(bytes, 1) : mxMalloc(bytes);
+  }
+  track(array);
+  return array;
+}
+
+std::vector<mwSize> makeDimensions(mwSize ndim, const mwSize* dims) {
+  return std::vector<mwSize>(dims, dims + ndim);
+}
+
+std::vector<mwSize> makeDimensions(mwSize m, mwSize n) {
+  std::vector<mwSize> dims(2);
+  dims[0] = m;
+  dims[1] = n;
+  return dims;
+}
+
+mxArray** slots(const mxArray* array) {
+  return reinterpret_cast<mxArray**>(array->real);
+}
+
+void resizeStructStorage(mxArray* array, std::size_t old_fields) {
+  std::size_t elements = countElements(array->dims);
+  std::size_t new_fields = array->fields.size();
+  mxArray** old_data = slots(array);
+  mxArray** new_data = NULL;
+  if (elements * new_fields > 0) {
+    new_data = reinterpret_cast<mxArray**>(
+        mxCalloc(elements * new_fields, sizeof(mxArray*)));
+    std::size_t common = (old_fields < new_fields) ? old_fields : new_fields;
+    for (std::size_t i = 0; i < elements; ++i)
+      for (std::size_t j = 0; j < common; ++j)
+        new_data[i * new_fields + j] = old_data[i * old_fields + j];
+  }
+  mxFree(old_data);
+  array->real = new_data;
+}
+
+}  // namespace
+
+/* Memory management. */
+
+void* mxMalloc(std::size_t n) {
+  return std::malloc((n > 0) ? n : 1);
+}
+
+void* mxCalloc(std::size_t n, std::size_t size) {
+  return std::calloc((n > 0) ? n : 1, (size > 0) ? size : 1);
+}
+
+void* mxRealloc(void* pointer, std::size_t size) {
+  return std::realloc(pointer, (size > 0) ? size : 1);
+}
+
+void mxFree(void* pointer) {
+  std::free(pointer);
+}
+
+/* Creation and destruction. */
+
+mxArray* mxCreateNumericMatrix(mwSize m, mwSize n, mxClassID class_id,
+                               mxComplexity flag) {
+  return newArray(class_id, makeDimensions(m, n), flag == mxCOMPLEX, true);
+}
+
+mxArray* mxCreateNumericArray(mwSize ndim, const mwSize* dims,
+                              mxClassID class_id, mxComplexity flag) {
+  return newArray(class_id, makeDimensions(ndim, dims), flag == mxCOMPLEX,
+                  true);
+}
+
+mxArray* mxCreateUninitNumericMatrix(std::size_t m, std::size_t n,
+                                     mxClassID class_id, mxComplexity flag) {
+  return newArray(class_id, makeDimensions(m, n), flag == mxCOMPLEX, false);
+}
+
+mxArray* mxCreateUninitNumericArray(std::size_t ndim, std::size_t* dims,
+                                    mxClassID class_id, mxComplexity flag) {
+  return newArray(class_id, makeDimensions(ndim, dims), flag == mxCOMPLEX,
+                  false);
+}
+
+mxArray* mxCreateDoubleMatrix(mwSize m, mwSize n, mxComplexity flag) {
+  return mxCreateNumericMatrix(m, n, mxDOUBLE_CLASS, flag);
+}
+
+mxArray* mxCreateDoubleScalar(double value) {
+  mxArray* array = mxCreateDoubleMatrix(1, 1, mxREAL);
+  *mxGetPr(array) = value;
+  return array;
+}
+
+mxArray* mxCreateLogicalMatrix(mwSize m, mwSize n) {
+  return newArray(mxLOGICAL_CLASS, makeDimensions(m, n), false, true);
+}
+
+mxArray* mxCreateLogicalArray(mwSize ndim, const mwSize* dims) {
+  return newArray(mxLOGICAL_CLASS, makeDimensions(ndim, dims), false, true);
+}
+
+mxArray* mxCreateLogicalScalar(mxLogical value) {
+  mxArray* array = mxCreateLogicalMatrix(1, 1);
+  *mxGetLogicals(array) = value;
+  return array;
+}
+
+mxArray* mxCreateString(const char* str) {
+  std::size_t length = (str) ? std::strlen(str) : 0;
+  mxArray* array = newArray(mxCHAR_CLASS, makeDimensions(1, length), false,
+                            true);
+  mxChar* data = mxGetChars(array);
+  for (std::size_t i = 0; i < length; ++i)
+    data[i] = static_cast<unsigned char>(str[i]);
+  return array;
+}
+
+mxArray* mxCreateCharArray(mwSize ndim, const mwSize* dims) {
+  return newArray(mxCHAR_CLASS, makeDimensions(ndim, dims), false, true);
+}
+
+mxArray* mxCreateCharMatrixFromStrings(mwSize m, const char** str) {
+  std::size_t n = 0;
+  for (mwSize i = 0; i < m; ++i)
+    n = std::max(n, std::strlen(str[i]));
+  mxArray* array = newArray(mxCHAR_CLASS, makeDimensions(m, n), false, true);
+  mxChar* data = mxGetChars(array);
+  for (mwSize i = 0; i < m; ++i) {
+    std::size_t length = std::strlen(str[i]);
+    for (std::size_t j = 0; j < n; ++j)
+      data[j * m + i] = (j < length) ?
+          static_cast<unsigned char>(str[i][j]) : ' ';
+  }
+  return array;
+}
+
+mxArray* mxCreateCellMatrix(mwSize m, mwSize n) {
+  return newArray(mxCELL_CLASS, makeDimensions(m, n), false, true);
+}
+
+mxArray* mxCreateCellArray(mwSize ndim, const mwSize* dims) {
+  return newArray(mxCELL_CLASS, makeDimensions(ndim, dims), false, true);
+}
+
+mxArray* mxCreateStructArray(mwSize ndim, const mwSize* dims, int nfields,
+                             const char** fieldnames) {
+  mxArray* array = newArray(mxSTRUCT_CLASS, makeDimensions(ndim, dims), false,
+                            false);
+  mxFree(array->real);
+  array->real = NULL;
+  for (int i = 0; i < nfields; ++i)
+    array->fields.push_back(fieldnames[i]);
+  resizeStructStorage(array, 0);
+  return array;
+}
+
+mxArray* mxCreateStructMatrix(mwSize m, mwSize n, int nfields,
+                              const char** fieldnames) {
+  mwSize dims[] = {m, n};
+  return mxCreateStructArray(2, dims, nfields, fieldnames);
+}
+
+mxArray* mxCreateSparse(mwSize m, mwSize n, mwSize nzmax,
+                        mxComplexity flag) {
+  mxArray* array = newArray(mxDOUBLE_CLASS, makeDimensions(m, n), false,
+                            false);
+  mxFree(array->real);
+  if (nzmax == 0)
+    nzmax = 1;
+  array->sparse = true;
+  array->complex = (flag == mxCOMPLEX);
+  array->nzmax = nzmax;
+  array->real = mxCalloc(nzmax, sizeof(double));
+  array->imag = (array->complex) ? mxCalloc(nzmax, sizeof(double)) : NULL;
+  array->ir = reinterpret_cast<mwIndex*>(mxCalloc(nzmax, sizeof(mwIndex)));
+  array->jc = reinterpret_cast<mwIndex*>(mxCalloc(n + 1, sizeof(mwIndex)));
+  return array;
+}
+
+mxArray* mxCreateSparseLogicalMatrix(mwSize m, mwSize n, mwSize nzmax) {
+  mxArray* array = mxCreateSparse(m, n, nzmax, mxREAL);
+  mxFree(array->real);
+  array->class_id = mxLOGICAL_CLASS;
+  array->real = mxCalloc(array->nzmax, sizeof(mxLogical));
+  return array;
+}
+
+mxArray* mxDuplicateArray(const mxArray* array) {
+  if (!array)
+    return NULL;
+  mxArray* copy = new mxArray_tag(*array);
+  track(copy);
+  std::size_t count = storageSize(array);
+  std::size_t element_size = classElementSize(array->class_id);
+  copy->real = NULL;
+  copy->imag = NULL;
+  if (array->real) {
+    copy->real = mxMalloc(count * element_size);
+    if (array->class_id == mxCELL_CLASS || array->class_id == mxSTRUCT_CLASS) {
+      for (std::size_t i = 0; i < count; ++i) {
+        slots(copy)[i] = mxDuplicateArray(slots(array)[i]);
+        untrack(slots(copy)[i]);
+      }
+    } else {
+      std::memcpy(copy->real, array->real, count * element_size);
+    }
+  }
+  if (array->imag) {
+    copy->imag = mxMalloc(count * element_size);
+    std::memcpy(copy->imag, array->imag, count * element_size);
+  }
+  if (array->sparse) {
+    std::size_t columns = array->dims[1];
+    copy->ir = reinterpret_cast<mwIndex*>(
+        mxMalloc(array->nzmax * sizeof(mwIndex)));
+    copy->jc = reinterpret_cast<mwIndex*>(
+        mxMalloc((columns + 1) * sizeof(mwIndex)));
+    std::memcpy(copy->ir, array->ir, array->nzmax * sizeof(mwIndex));
+    std::memcpy(copy->jc, array->jc, (columns + 1) * sizeof(mwIndex));
+  }
+  return copy;
+}
+
+void mxDestroyArray(mxArray* array) {
+  if (!array)
+    return;
+  if (array->class_id == mxCELL_CLASS || array->class_id == mxSTRUCT_CLASS) {
+    std::size_t count = storageSize(array);
+    for (std::size_t i = 0; i < count; ++i)
+      mxDestroyArray(slots(array)[i]);
+  }
+  mxFree(array->real);
+  mxFree(array->imag);
+  mxFree(array->ir);
+  mxFree(array->jc);
+  untrack(array);
+  --g_live_arrays;
+  delete array;
+}
+
+/* Type queries. */
+
+mxClassID mxGetClassID(const mxArray* array) {
+  return array->class_id;
+}
+
+const char* mxGetClassName(const mxArray* array) {
+  switch (array->class_id) {
+    case mxCELL_CLASS:     return "cell";
+    case mxSTRUCT_CLASS:   return "struct";
+    case mxLOGICAL_CLASS:  return "logical";
+    case mxCHAR_CLASS:     return "char";
+    case mxDOUBLE_CLASS:   return "double";
+    case mxSINGLE_CLASS:   return "single";
+    case mxINT8_CLASS:     return "int8";
+    case mxUINT8_CLASS:    return "uint8";
+    case mxINT16_CLASS:    return "int16";
+    case mxUINT16_CLASS:   return "uint16";
+    case mxINT32_CLASS:    return "int32";
+    case mxUINT32_CLASS:   return "uint32";
+    case mxINT64_CLASS:    return "int64";
+    case mxUINT64_CLASS:   return "uint64";
+    case mxFUNCTION_CLASS: return "function_handle";
+    default:               return "unknown";
+  }
+}
+
+bool mxIsClass(const mxArray* array, const char* name) {
+  return std::strcmp(mxGetClassName(array), name) == 0;
+}
+
+bool mxIsCell(const mxArray* array) {
+  return array->class_id == mxCELL_CLASS;
+}
+
+bool mxIsStruct(const mxArray* array) {
+  return array->class_id == mxSTRUCT_CLASS;
+}
+
+bool mxIsChar(const mxArray* array) {
+  return array->class_id == mxCHAR_CLASS;
+}
+
+bool mxIsLogical(const mxArray* array) {
+  return array->class_id == mxLOGICAL_CLASS;
+}
+
+bool mxIsLogicalScalar(const mxArray* array) {
+  return mxIsLogical(array) && mxGetNumberOfElements(array) == 1;
+}
+
+bool mxIsLogicalScalarTrue(const mxArray* array) {
+  return mxIsLogicalScalar(array) && *mxGetLogicals(array);
+}
+
+bool mxIsNumeric(const mxArray* array) {
+  return isNumericClass(array->class_id);
+}
+
+bool mxIsDouble(const mxArray* array) {
+  return array->class_id == mxDOUBLE_CLASS;
+}
+
+bool mxIsSingle(const mxArray* array) {
+  return array->class_id == mxSINGLE_CLASS;
+}
+
+bool mxIsInt8(const mxArray* array) {
+  return array->class_id == mxINT8_CLASS;
+}
+
+bool mxIsUint8(const mxArray* array) {
+  return array->class_id == mxUINT8_CLASS;
+}
+
+bool mxIsInt16(const mxArray* array) {
+  return array->class_id == mxINT16_CLASS;
+}
+
+bool mxIsUint16(const mxArray* array) {
+  return array->class_id == mxUINT16_CLASS;
+}
+
+bool mxIsInt32(const mxArray* array) {
+  return array->class_id == mxINT32_CLASS;
+}
+
+bool mxIsUint32(const mxArray* array) {
+  return array->class_id == mxUINT32_CLASS;
+}
+
+bool mxIsInt64(const mxArray* array) {
+  return array->class_id == mxINT64_CLASS;
+}
+
+bool mxIsUint64(const mxArray* array) {
+  return array->class_id == mxUINT64_CLASS;
+}
+
+bool mxIsComplex(const mxArray* array) {
+  return array->complex;
+}
+
+bool mxIsSparse(const mxArray* array) {
+  return array->sparse;
+}
+
+bool mxIsEmpty(const mxArray* array) {
+  return mxGetNumberOfElements(array) == 0;
+}
+
+bool mxIsFromGlobalWS(const mxArray* /* array */) {
+  return false;
+}
+
+bool mxIsFinite(double value) {
+  return std::isfinite(value);
+}
+
+bool mxIsInf(double value) {
+  return std::isinf(value);
+}
+
+bool mxIsNaN(double value) {
+  return std::isnan(value);
+}
+
+double mxGetInf(void) {
+  return std::numeric_limits<double>::infinity();
+}
+
+double mxGetNaN(void) {
+  return std::numeric_limits<double>::quiet_NaN();
+}
+
+double mxGetEps(void) {
+  return std::numeric_limits<double>::epsilon();
+}
+
+/* Shape. */
+
+std::size_t mxGetNumberOfElements(const mxArray* array) {
+  return countElements(array->dims);
+}
+
+mwSize mxGetNumberOfDimensions(const mxArray* array) {
+  return array->dims.size();
+}
+
+const mwSize* mxGetDimensions(const mxArray* array) {
+  return &array->dims[0];
+}
+
+int mxSetDimensions(mxArray* array, const mwSize* dims, mwSize ndim) {
+  array->dims.assign(dims, dims + ndim);
+  normalizeDimensions(&array->dims);
+  return 0;
+}
+
+std::size_t mxGetM(const mxArray* array) {
+  return array->dims[0];
+}
+
+std::size_t mxGetN(const mxArray* array) {
+  std::size_t n = 1;
+  for (std::size_t i = 1; i < array->dims.size(); ++i)
+    n *= array->dims[i];
+  return n;
+}
+
+void mxSetM(mxArray* array, mwSize m) {
+  array->dims[0] = m;
+}
+
+void mxSetN(mxArray* array, mwSize n) {
+  array->dims.resize(2);
+  array->dims[1] = n;
+}
+
+std::size_t mxGetElementSize(const mxArray* array) {
+  return classElementSize(array->class_id);
+}
+
+mwIndex mxCalcSingleSubscript(const mxArray* array, mwSize nsubs,
+                              const mwIndex* subs) {
+  mwIndex index = 0;
+  mwIndex stride = 1;
+  for (mwSize i = 0; i < nsubs; ++i) {
+    index += subs[i] * stride;
+    stride *= (i < array->dims.size()) ? array->dims[i] : 1;
+  }
+  return index;
+}
+
+/* Data access. */
+
+void* mxGetData(const mxArray* array) {
+  return array->real;
+}
+
+void mxSetData(mxArray* array, void* data) {
+  array->real = data;
+}
+
+void* mxGetImagData(const mxArray* array) {
+  return array->imag;
+}
+
+void mxSetImagData(mxArray* array, void* data) {
+  array->imag = data;
+  array->complex = (data != NULL);
+}
+
+double* mxGetPr(const mxArray* array) {
+  return reinterpret_cast<double*>(array->real);
+}
+
+void mxSetPr(mxArray* array, double* data) {
+  array->real = data;
+}
+
+double* mxGetPi(const mxArray* array) {
+  return reinterpret_cast<double*>(array->imag);
+}
+
+void mxSetPi(mxArray* array, double* data) {
+  mxSetImagData(array, data);
+}
+
+double mxGetScalar(const mxArray* array) {
+  if (!array->real || mxGetNumberOfElements(array) == 0)
+    return 0.0;
+  switch (array->class_id) {
+    case mxLOGICAL_CLASS:
+      return *reinterpret_cast<mxLogical*>(array->real);
+    case mxCHAR_CLASS:  return *reinterpret_cast<mxChar*>(array->real);
+    case mxDOUBLE_CLASS:  return *reinterpret_cast<double*>(array->real);
+    case mxSINGLE_CLASS:  return *reinterpret_cast<float*>(array->real);
+    case mxINT8_CLASS:  return *reinterpret_cast<int8_t*>(array->real);
+    case mxUINT8_CLASS:  return *reinterpret_cast<uint8_t*>(array->real);
+    case mxINT16_CLASS:  return *reinterpret_cast<int16_t*>(array->real);
+    case mxUINT16_CLASS:  return *reinterpret_cast<uint16_t*>(array->real);
+    case mxINT32_CLASS:  return *reinterpret_cast<int32_t*>(array->real);
+    case mxUINT32_CLASS:  return *reinterpret_cast<uint32_t*>(array->real);
+    case mxINT64_CLASS:
+      return static_cast<double>(*reinterpret_cast<int64_t*>(array->real));
+    case mxUINT64_CLASS:
+      return static_cast<double>(*reinterpret_cast<uint64_t*>(array->real));
+    default:
+      return 0.0;
+  }
+}
+
+mxChar* mxGetChars(const mxArray* array) {
+  return (array->class_id == mxCHAR_CLASS) ?
+      reinterpret_cast<mxChar*>(array->real) : NULL;
+}
+
+mxLogical* mxGetLogicals(const mxArray* array) {
+  return (array->class_id == mxLOGICAL_CLASS) ?
+      reinterpret_cast<mxLogical*>(array->real) : NULL;
+}
+
+int mxGetString(const mxArray* array, char* buffer, mwSize buflen) {
+  if (!mxIsChar(array) || buflen == 0)
+    return 1;
+  std::size_t length = mxGetNumberOfElements(array);
+  std::size_t count = (length < buflen - 1) ? length : buflen - 1;
+  const mxChar* data = mxGetChars(array);
+  for (std::size_t i = 0; i < count; ++i)
+    buffer[i] = static_cast<char>(data[i]);
+  buffer[count] = '\0';
+  return (count < length) ? 1 : 0;
+}
+
+char* mxArrayToString(const mxArray* array) {
+  if (!mxIsChar(array))
+    return NULL;
+  std::size_t length = mxGetNumberOfElements(array);
+  char* buffer = reinterpret_cast<char*>(mxMalloc(length + 1));
+  mxGetString(array, buffer, length + 1);
+  return buffer;
+}
+
+/* Sparse. */
+
+mwIndex* mxGetIr(const mxArray* array) {
+  return array->ir;
+}
+
+mwIndex* mxGetJc(const mxArray* array) {
+  return array->jc;
+}
+
+mwSize mxGetNzmax(const mxArray* array) {
+  return (array->sparse) ? array->nzmax : mxGetNumberOfElements(array);
+}
+
+void mxSetNzmax(mxArray* array, mwSize nzmax) {
+  if (!array->sparse)
+    return;
+  std::size_t element_size = classElementSize(array->class_id);
+  array->real = mxRealloc(array->real, nzmax * element_size);
+  if (array->imag)
+    array->imag = mxRealloc(array->imag, nzmax * element_size);
+  array->ir = reinterpret_cast<mwIndex*>(
+      mxRealloc(array->ir, nzmax * sizeof(mwIndex)));
+  array->nzmax = nzmax;
+}
+
+/* Cells. */
+
+mxArray* mxGetCell(const mxArray* array, mwIndex index) {
+  if (!mxIsCell(array) || index >= mxGetNumberOfElements(array))
+    return NULL;
+  return slots(array)[index];
+}
+
+void mxSetCell(mxArray* array, mwIndex index, mxArray* value) {
+  if (!mxIsCell(array) || index >= mxGetNumberOfElements(array))
+    mexErrMsgIdAndTxt("MATLAB:mxSetCell:indexOutOfRange",
+                      "Index out of range.");
+  untrack(value);
+  slots(array)[index] = value;
+}
+
+/* Structs. */
+
+int mxGetNumberOfFields(const mxArray* array) {
+  return static_cast<int>(array->fields.size());
+}
+
+const char* mxGetFieldNameByNumber(const mxArray* array, int number) {
+  if (number < 0 || number >= mxGetNumberOfFields(array))
+    return NULL;
+  return array->fields[number].c_str();
+}
+
+int mxGetFieldNumber(const mxArray* array, const char* name) {
+  if (!mxIsStruct(array))
+    return -1;
+  for (std::size_t i = 0; i < array->fields.size(); ++i)
+    if (array->fields[i] == name)
+      return static_cast<int>(i);
+  return -1;
+}
+
+int mxAddField(mxArray* array, const char* name) {
+  if (!mxIsStruct(array))
+    return -1;
+  int number = mxGetFieldNumber(array, name);
+  if (number >= 0)
+    return number;
+  std::size_t old_fields = array->fields.size();
+  array->fields.push_back(name);
+  resizeStructStorage(array, old_fields);
+  return static_cast<int>(old_fields);
+}
+
+void mxRemoveField(mxArray* array, int number) {
+  if (!mxIsStruct(array) || number < 0 ||
+      number >= mxGetNumberOfFields(array))
+    return;
+  std::size_t elements = mxGetNumberOfElements(array);
+  std::size_t old_fields = array->fields.size();
+  std::vector<mxArray*> data(slots(array),
+                             slots(array) + elements * old_fields);
+  for (std::size_t i = 0; i < elements; ++i) {
+    mxDestroyArray(data[i * old_fields + number]);
+    data.erase(data.begin() + i * (old_fields - 1) + number);
+  }
+  array->fields.erase(array->fields.begin() + number);
+  mxFree(array->real);
+  array->real = NULL;
+  if (!data.empty()) {
+    array->real = mxMalloc(data.size() * sizeof(mxArray*));
+    std::memcpy(array->real, &data[0], data.size() * sizeof(mxArray*));
+  }
+}
+
+mxArray* mxGetFieldByNumber(const mxArray* array, mwIndex index,
+                            int number) {
+  if (!mxIsStruct(array) || index >= mxGetNumberOfElements(array) ||
+      number < 0 || number >= mxGetNumberOfFields(array))
+    return NULL;
+  return slots(array)[index * array->fields.size() + number];
+}
+
+void mxSetFieldByNumber(mxArray* array, mwIndex index, int number,
+                        mxArray* value) {
+  if (!mxIsStruct(array) || index >= mxGetNumberOfElements(array) ||
+      number < 0 || number >= mxGetNumberOfFields(array))
+    mexErrMsgIdAndTxt("MATLAB:mxSetFieldByNumber:indexOutOfRange",
+                      "Index out of range.");
+  untrack(value);
+  slots(array)[index * array->fields.size() + number] = value;
+}
+
+mxArray* mxGetField(const mxArray* array, mwIndex index, const char* name) {
+  return mxGetFieldByNumber(array, index, mxGetFieldNumber(array, name));
+}
+
+void mxSetField(mxArray* array, mwIndex index, const char* name,
+                mxArray* value) {
+  int number = mxGetFieldNumber(array, name);
+  if (number < 0)
+    number = mxAddField(array, name);
+  mxSetFieldByNumber(array, index, number, value);
+}
+
+/* MEX API. */
+
+void mexErrMsgTxt(const char* message) {
+  throw Error("", message);
+}
+
+void mexErrMsgIdAndTxt(const char* identifier, const char* format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  std::string message = formatMessage(format, arguments);
+  va_end(arguments);
+  throw Error(identifier, message);
+}
+
+void mexWarnMsgTxt(const char* message) {
+  std::fprintf(stderr, "Warning: %s\n", message);
+}
+
+void mexWarnMsgIdAndTxt(const char* identifier, const char* format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  std::string message = formatMessage(format, arguments);
+  va_end(arguments);
+  std::fprintf(stderr, "Warning: %s (%s)\n", message.c_str(), identifier);
+}
+
+int mexPrintf(const char* format, ...) {
+  va_list arguments;
+  va_start(arguments, format);
+  int size = std::vprintf(format, arguments);
+  va_end(arguments);
+  return size;
+}
+
+int mexCallMATLAB(int nlhs, mxArray* plhs[], int nrhs, mxArray* prhs[],
+                  const char* name) {
+  std::string function_name(name);
+  if (function_name == "drawnow")
+    return 0;
+  if (function_name == "str2func") {
+    if (nrhs < 1 || !mxIsChar(prhs[0]))
+      mexErrMsgIdAndTxt("MATLAB:str2func:invalidInput",
+                        "Input must be a character vector.");
+    char* buffer = mxArrayToString(prhs[0]);
+    plhs[0] = mexplus::standalone::functionHandle(buffer);
+    mxFree(buffer);
+    return 0;
+  }
+  if (function_name == "feval") {
+    if (nrhs < 1)
+      mexErrMsgIdAndTxt("MATLAB:feval:notEnoughInputs",
+                        "Not enough input arguments.");
+    if (mxIsChar(prhs[0])) {
+      char* buffer = mxArrayToString(prhs[0]);
+      function_name.assign(buffer);
+      mxFree(buffer);
+    } else {
+      function_name = mexplus::standalone::functionName(prhs[0]);
+    }
+    ++prhs;
+    --nrhs;
+  }
+  std::map<std::string, Function>::const_iterator entry =
+      functionRegistry()->find(function_name);
+  if (entry == functionRegistry()->end())
+    mexErrMsgIdAndTxt("MATLAB:UndefinedFunction",
+                      "Undefined function '%s'.",
+                      function_name.c_str());
+  entry->second(nlhs, plhs, nrhs, prhs);
+  return 0;
+}
+
+void mexMakeArrayPersistent(mxArray* array) {
+  untrack(array);
+}
+
+void mexMakeMemoryPersistent(void* /* pointer */) {}
+
+void mexLock(void) {
+  ++g_lock_count;
+}
+
+void mexUnlock(void) {
+  if (g_lock_count > 0)
+    --g_lock_count;
+}
+
+bool mexIsLocked(void) {
+  return g_lock_count > 0;
+}
+
+int mexAtExit(void (*function)(void)) {
+  // As in Matlab, a MEX file has one exit function and the last one wins.
+  exitHandlers()->assign(1, function);
+  return 0;
+}
+
+const char* mexFunctionName(void) {
+  return "mexFunction";
+}
+
+namespace mexplus {
+namespace standalone {
+
+void registerFunction(const std::string& name, const Function& function) {
+  (*functionRegistry())[name] = function;
+}
+
+mxArray* functionHandle(const std::string& name) {
+  mxArray* array = newArray(mxFUNCTION_CLASS, makeDimensions(1, 1), false,
+                            false);
+  array->function = name;
+  return array;
+}
+
+std::string functionName(const mxArray* handle) {
+  if (!handle || handle->class_id != mxFUNCTION_CLASS)
+    mexErrMsgIdAndTxt("MATLAB:feval:invalidHandle",
+                      "Argument must be a function handle.");
+  return handle->function;
+}
+
+void beginCall() {
+  ++g_call_depth;
+}
+
+void endCall(int nlhs, mxArray* plhs[], bool succeeded) {
+  if (--g_call_depth > 0)
+    return;
+  for (int i = 0; plhs && i < std::max(nlhs, 1); ++i) {
+    if (succeeded && plhs[i])
+      untrack(plhs[i]);
+    else
+      plhs[i] = NULL;
+  }
+  destroyTemporaries();
+}
+
+int lockCount() {
+  return g_lock_count;
+}
+
+long liveArrays() {
+  return g_live_arrays;
+}
+
+void shutdown() {
+  std::vector<void (*)(void)> handlers;
+  handlers.swap(*exitHandlers());
+  for (std::size_t i = 0; i < handlers.size(); ++i)
+    handlers[i]();
+  g_lock_count = 0;
+}
+
+}  // namespace standalone
+}  // namespace mexplus
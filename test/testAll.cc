@@ -0,0 +1,299 @@
+/** Native counterpart of testAll.m.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * Runs the call sequences of testAll.m for the MEX source linked into the
+ * executable, through the stand-in runtime in standalone/. The argument names
+ * the sequence.
+ *
+ *    $ ./testDispatch_ testDispatch
+ *
+ * Function handles are native functions registered to the runtime in place of
+ * the anonymous functions in testAll.m.
+ */
+
+#include <mex.h>
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <limits>
+#include <string>
+#include <vector>
+#include "mexplus/mxarray.h"
+
+using mexplus::MxArray;
+using mexplus::standalone::Error;
+using std::string;
+using std::vector;
+
+#define EXPECT(condition) if (!(condition)) \
+    mexErrMsgTxt(#condition " not true.")
+
+namespace {
+
+/** Call mexFunction() as Matlab does, and return the outputs. The inputs are
+ * destroyed after the call.
+ */
+vector<MxArray> Call(int nlhs, const vector<mxArray*>& inputs) {
+  vector<MxArray> arguments;
+  for (size_t i = 0; i < inputs.size(); ++i)
+    arguments.push_back(MxArray(inputs[i]));
+  vector<const mxArray*> prhs;
+  for (size_t i = 0; i < arguments.size(); ++i)
+    prhs.push_back(arguments[i].get());
+  vector<mxArray*> plhs(std::max(nlhs, 1), static_cast<mxArray*>(NULL));
+  mexplus::standalone::callMexFunction(nlhs, plhs.data(),
+                                       static_cast<int>(prhs.size()),
+                                       prhs.data());
+  vector<MxArray> outputs;
+  for (size_t i = 0; i < plhs.size(); ++i)
+    outputs.push_back(MxArray(plhs[i]));
+  return outputs;
+}
+
+/** Call mexFunction() and return the first output.
+ */
+MxArray Call(const vector<mxArray*>& inputs) {
+  return std::move(Call(1, inputs)[0]);
+}
+
+/** Expect the call to throw the specified error identifier.
+ */
+void ExpectError(const string& identifier, const vector<mxArray*>& inputs) {
+  try {
+    Call(0, inputs);
+  } catch (const Error& error) {
+    if (error.identifier() != identifier)
+      mexErrMsgIdAndTxt("test:fail", "Expected %s but %s.",
+                        identifier.c_str(), error.identifier().c_str());
+    return;
+  }
+  mexErrMsgIdAndTxt("test:fail", "Unexpected execution.");
+}
+
+mxArray* Text(const char* value) { return MxArray::from(value); }
+
+mxArray* Scalar(double value) { return MxArray::from(value); }
+
+mxArray* Row(const vector<double>& values) { return MxArray::from(values); }
+
+/** Cell array of the given elements.
+ */
+mxArray* Cell(const vector<mxArray*>& elements) {
+  MxArray cell(MxArray::Cell(1, elements.size()));
+  for (size_t i = 0; i < elements.size(); ++i)
+    cell.set(i, elements[i]);
+  return cell.release();
+}
+
+/** Char array of the given UTF-16 code units.
+ */
+mxArray* Chars(const vector<mxChar>& values) {
+  mwSize dimensions[] = {1, values.size()};
+  mxArray* array = mxCreateCharArray(2, dimensions);
+  std::copy(values.begin(), values.end(), mxGetChars(array));
+  return array;
+}
+
+/** Copy of an int64 session id plus an offset.
+ */
+mxArray* Offset(const MxArray& id, int64_t offset) {
+  mxArray* array = mxDuplicateArray(id.get());
+  *static_cast<int64_t*>(mxGetData(array)) += offset;
+  return array;
+}
+
+/** Sum of squares of each column, as @(X)sum(X.^2, 1).
+ */
+void SumOfSquares(int /* nlhs */, mxArray* plhs[], int nrhs,
+                  mxArray* prhs[]) {
+  EXPECT(nrhs == 1 && mxIsDouble(prhs[0]));
+  size_t rows = mxGetM(prhs[0]);
+  size_t columns = mxGetN(prhs[0]);
+  const double* data = mxGetPr(prhs[0]);
+  plhs[0] = mxCreateDoubleMatrix(1, columns, mxREAL);
+  for (size_t j = 0; j < columns; ++j)
+    for (size_t i = 0; i < rows; ++i)
+      mxGetPr(plhs[0])[j] += data[j * rows + i] * data[j * rows + i];
+}
+
+/** Sum of squares of each cell, as
+ * @(X)cellfun(@(x)sum(x.^2), X, 'UniformOutput', false).
+ */
+void CellSumOfSquares(int /* nlhs */, mxArray* plhs[], int nrhs,
+                      mxArray* prhs[]) {
+  EXPECT(nrhs == 1 && mxIsCell(prhs[0]));
+  size_t size = mxGetNumberOfElements(prhs[0]);
+  plhs[0] = mxCreateCellMatrix(1, size);
+  for (size_t i = 0; i < size; ++i) {
+    mxArray* result = NULL;
+    mxArray* input = mxGetCell(prhs[0], i);
+    SumOfSquares(1, &result, 1, &input);
+    mxSetCell(plhs[0], i, result);
+  }
+}
+
+void testDispatch() {
+  mexplus::standalone::registerFunction("sumsq", SumOfSquares);
+  mexplus::standalone::registerFunction("cellsumsq", CellSumOfSquares);
+  Call(0, {Text("foo")});
+  ExpectError("mexplus:dispatch:argumentError", {});
+  ExpectError("mexplus:dispatch:argumentError", {Text("baz")});
+  // Pipeline.
+  vector<MxArray> outputs = Call(2, {
+      Cell({Cell({Text("scale"), Text("y"), Row({1, 2, 3}), Scalar(2)}),
+            Cell({Text("sum"), Cell({Text("total"), Text("count")}),
+                  Text("$y")})}),
+      Cell({Text("total"), Text("y")})});
+  EXPECT(outputs[0].to<double>() == 12);
+  EXPECT(outputs[1].to<vector<double> >() == vector<double>({2, 4, 6}));
+  ExpectError("mexplus:dispatch:argumentError", {
+      Cell({Cell({Text("sum"), Text("x"), Text("$undefined")})}),
+      Cell({Text("x")})});
+  // Pipeline with C++ values published between steps.
+  outputs = Call(3, {
+      Cell({Cell({Text("cumsum"), Text("y"), Row({1, 2, 3})}),
+            Cell({Text("cumsum"), Text("z"), Text("$y")}),
+            Cell({Text("length"), Text("n"), Text("$z")})}),
+      Cell({Text("z"), Text("y"), Text("n")})});
+  EXPECT(outputs[0].to<vector<double> >() == vector<double>({1, 4, 10}));
+  EXPECT(outputs[1].to<vector<double> >() == vector<double>({1, 3, 6}));
+  EXPECT(outputs[2].to<int>() == 3);
+  EXPECT(Call({Text("cumsum"), Row({1, 2, 3})}).to<vector<double> >() ==
+         vector<double>({1, 3, 6}));
+  ExpectError("mexplus:dispatch:typeError", {
+      Cell({Cell({Text("length"), Text("n"), Row({1, 2})}),
+            Cell({Text("cumsum"), Text("y"), Text("$n")})}),
+      Cell({Text("y")})});
+  // Cache.
+  EXPECT(Call({Text("square"), Scalar(3)}).to<double>() == 9);
+  EXPECT(Call({Text("square"), Scalar(3)}).to<double>() == 9);
+  EXPECT(Call({Text("square"), Scalar(4)}).to<double>() == 16);
+  // A function handle cannot be hashed, so the call is not cached.
+  for (int i = 0; i < 2; ++i) {
+    EXPECT(Call({Text("square"), Scalar(5),
+                 Cell({mexplus::standalone::functionHandle("sumsq")})})
+               .to<double>() == 25);
+  }
+  MxArray stats(Call({Text("cacheStatistics")}));
+  EXPECT(stats.at<string>("name") == "square");
+  EXPECT(stats.at<double>("hits") == 1 && stats.at<double>("misses") == 2 &&
+         stats.at<double>("entries") == 2);
+  Call(0, {Text("clearCache")});
+  MxArray cleared(Call({Text("cacheStatistics")}));
+  EXPECT(cleared.at<double>("entries") == 0 &&
+         cleared.at<double>("bytes") == 0);
+  // Callback.
+  outputs = Call(2, {Text("evaluate"),
+                     mexplus::standalone::functionHandle("sumsq"),
+                     Text("stacked")});
+  EXPECT(outputs[0].to<vector<double> >() == vector<double>({1, 5, 13}));
+  EXPECT(outputs[1].to<double>() == 13);
+  // Argument arrays refilled in place.
+  outputs = Call(2, {Text("evaluate"),
+                     mexplus::standalone::functionHandle("sumsq"),
+                     Text("stacked"), MxArray::from(true)});
+  EXPECT(outputs[0].to<vector<double> >() == vector<double>({1, 5, 13}));
+  EXPECT(outputs[1].to<double>() == 13);
+  MxArray values(Call({Text("evaluate"),
+                       mexplus::standalone::functionHandle("cellsumsq"),
+                       Text("cell")}));
+  EXPECT(values.to<vector<double> >() == vector<double>({1, 5, 13}));
+  // Pool.
+  Call(0, {Text("release"), Text("pooled")});
+  ExpectError("mexplus:pool:released", {Text("release"), Text("twice")});
+  ExpectError("mexplus:pool:persistent",
+              {Text("release"), Text("persistent")});
+}
+
+void testSession() {
+  MxArray id(Call({Text("create")}));
+  Call(0, {Text("get"), mxDuplicateArray(id.get())});
+  ExpectError("mexplus:session:notFound", {Text("get"), Offset(id, 1)});
+  EXPECT(Call({Text("exist"), mxDuplicateArray(id.get())}).to<bool>());
+  EXPECT(!Call({Text("exist"), Offset(id, 1)}).to<bool>());
+  Call(0, {Text("destroy"), mxDuplicateArray(id.get())});
+  ExpectError("mexplus:session:notFound",
+              {Text("get"), mxDuplicateArray(id.get())});
+  EXPECT(!Call({Text("exist"), mxDuplicateArray(id.get())}).to<bool>());
+  Call(0, {Text("clear")});
+  // Cursor.
+  MxArray cursor(Call({Text("range"), Scalar(5)}));
+  vector<MxArray> outputs = Call(2, {Text("next"),
+                                     mxDuplicateArray(cursor.get()),
+                                     Scalar(3)});
+  EXPECT(outputs[0].to<vector<double> >() == vector<double>({0, 1, 2}));
+  EXPECT(!outputs[1].to<bool>());
+  outputs = Call(2, {Text("next"), mxDuplicateArray(cursor.get()),
+                     Scalar(3)});
+  EXPECT(outputs[0].to<vector<double> >() == vector<double>({3, 4}));
+  EXPECT(outputs[1].to<bool>());
+  ExpectError("mexplus:cursor:argumentError",
+              {Text("next"), mxDuplicateArray(cursor.get()),
+               Scalar(std::numeric_limits<double>::infinity())});
+  Call(0, {Text("close"), mxDuplicateArray(cursor.get())});
+  ExpectError("mexplus:session:notFound",
+              {Text("next"), mxDuplicateArray(cursor.get()), Scalar(1)});
+  // The prefetch thread fails at the third item.
+  MxArray failing(Call({Text("range"), Scalar(5), Scalar(2)}));
+  MxArray values(Call({Text("next"), mxDuplicateArray(failing.get()),
+                       Scalar(2)}));
+  EXPECT(values.to<vector<double> >() == vector<double>({0, 1}));
+  bool failed = false;
+  try {
+    Call({Text("next"), mxDuplicateArray(failing.get()), Scalar(2)});
+  } catch (const std::exception&) {
+    failed = true;
+  }
+  EXPECT(failed);
+  Call(0, {Text("close"), mxDuplicateArray(failing.get())});
+}
+
+void testString() {
+  vector<mxChar> fixtures[] = {
+      {0, 127, 128, 255},
+      {72, 233, 8364, 55357, 56832},
+      vector<mxChar>(40, 'a')};
+  fixtures[2].push_back(8364);
+  fixtures[2].insert(fixtures[2].end(), 20, 'b');
+  for (size_t i = 0; i < sizeof(fixtures) / sizeof(fixtures[0]); ++i) {
+    MxArray value(Call({Chars(fixtures[i])}));
+    EXPECT(value.isChar() && value.size() == fixtures[i].size());
+    EXPECT(std::equal(fixtures[i].begin(), fixtures[i].end(),
+                      mxGetChars(value.get())));
+  }
+  // Bytes come back as chars, cast to uint8 as in testAll.m.
+  vector<uint8_t> bytes({0, 127, 128, 255});
+  MxArray value(Call({MxArray::from(bytes)}));
+  EXPECT(value.isChar() && value.size() == bytes.size());
+  for (size_t i = 0; i < bytes.size(); ++i)
+    EXPECT(std::min<mxChar>(mxGetChars(value.get())[i], 255) == bytes[i]);
+  MxArray surrogate(Call({Chars({55357})}));
+  EXPECT(surrogate.size() == 1 && mxGetChars(surrogate.get())[0] == 65533);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::fprintf(stderr, "Usage: %s SEQUENCE\n", argv[0]);
+    return 1;
+  }
+  string name(argv[1]);
+  try {
+    if (name == "testDispatch")
+      testDispatch();
+    else if (name == "testSession")
+      testSession();
+    else if (name == "testString")
+      testString();
+    else
+      mexErrMsgIdAndTxt("test:fail", "Unknown sequence: %s.", argv[1]);
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "=> FAIL: %s: %s\n", name.c_str(), e.what());
+    return 1;
+  }
+  mexplus::standalone::shutdown();
+  std::printf("=> PASS: %s\n", name.c_str());
+  return 0;
+}
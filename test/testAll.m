@@ -40,6 +40,44 @@ function testDispatch
   testDispatch_('foo');
   expectError('mexplus:dispatch:argumentError', @()testDispatch_());
   expectError('mexplus:dispatch:argumentError', @()testDispatch_('baz'));
+  [total, y] = testDispatch_({{'scale', 'y', [1, 2, 3], 2}, ...
+                              {'sum', {'total', 'count'}, '$y'}}, ...
+                             {'total', 'y'});
+  assert(total == 12 && isequal(y, [2, 4, 6]));
+  expectError('mexplus:dispatch:argumentError', ...
+              @()testDispatch_({{'sum', 'x', '$undefined'}}, {'x'}));
+  [z, y, n] = testDispatch_({{'cumsum', 'y', [1, 2, 3]}, ...
+                             {'cumsum', 'z', '$y'}, ...
+                             {'length', 'n', '$z'}}, {'z', 'y', 'n'});
+  assert(isequal(z, [1, 4, 10]) && isequal(y, [1, 3, 6]) && n == 3);
+  assert(isequal(testDispatch_('cumsum', [1, 2, 3]), [1, 3, 6]));
+  expectError('mexplus:dispatch:typeError', ...
+              @()testDispatch_({{'length', 'n', [1, 2]}, ...
+                                {'cumsum', 'y', '$n'}}, {'y'}));
+  assert(testDispatch_('square', 3) == 9);
+  assert(testDispatch_('square', 3) == 9);
+  assert(testDispatch_('square', 4) == 16);
+  % A function handle cannot be hashed, so the call is not cached.
+  assert(testDispatch_('square', 5, {@sin}) == 25);
+  assert(testDispatch_('square', 5, {@sin}) == 25);
+  stats = testDispatch_('cacheStatistics');
+  assert(strcmp(stats.name, 'square'));
+  assert(stats.hits == 1 && stats.misses == 2 && stats.entries == 2);
+  testDispatch_('clearCache');
+  stats = testDispatch_('cacheStatistics');
+  assert(stats.entries == 0 && stats.bytes == 0);
+  [values, value] = testDispatch_('evaluate', @(X)sum(X.^2, 1), 'stacked');
+  assert(isequal(values(:)', [1, 5, 13]) && value == 13);
+  [values, value] = testDispatch_('evaluate', @(X)sum(X.^2, 1), 'stacked', ...
+                                  true);
+  assert(isequal(values(:)', [1, 5, 13]) && value == 13);
+  values = testDispatch_('evaluate', ...
+      @(X)cellfun(@(x)sum(x.^2), X, 'UniformOutput', false), 'cell');
+  assert(isequal(values(:)', [1, 5, 13]));
+  testDispatch_('release', 'pooled');
+  expectError('mexplus:pool:released', @()testDispatch_('release', 'twice'));
+  expectError('mexplus:pool:persistent', ...
+              @()testDispatch_('release', 'persistent'));
   fprintf('PASS: %s\n', 'testDispatch');
 end
 
@@ -54,12 +92,37 @@ function testSession
   expectError('mexplus:session:notFound', @()testSession_('get', id));
   assert(~testSession_('exist', id));
   testSession_('clear');
+  cursor = testSession_('range', 5);
+  [values, done] = testSession_('next', cursor, 3);
+  assert(isequal(values, [0, 1, 2]) && ~done);
+  [values, done] = testSession_('next', cursor, 3);
+  assert(isequal(values, [3, 4]) && done);
+  expectError('mexplus:cursor:argumentError', ...
+              @()testSession_('next', cursor, Inf));
+  testSession_('close', cursor);
+  expectError('mexplus:session:notFound', ...
+              @()testSession_('next', cursor, 1));
+  % The prefetch thread fails at the third item.
+  cursor = testSession_('range', 5, 2);
+  values = testSession_('next', cursor, 2);
+  assert(isequal(values, [0, 1]));
+  failed = false;
+  try
+    testSession_('next', cursor, 2);
+  catch
+    failed = true;
+  end
+  assert(failed);
+  testSession_('close', cursor);
   fprintf('PASS: %s\n', 'testSession');
 end
 
 function testString
 %TESTSTRING
-  fixtures = {char([0, 127, 128, 255]), uint8([0, 127, 128, 255])};
+  fixtures = {char([0, 127, 128, 255]), ...
+              uint8([0, 127, 128, 255]), ...
+              char([72, 233, 8364, 55357, 56832]), ...
+              [repmat('a', 1, 40), char(8364), repmat('b', 1, 20)]};
   for i = 1:numel(fixtures)
     value = fixtures{i};
     value_type = class(value);
@@ -69,5 +132,6 @@ function testString
     assert(numel(returned_value) == numel(value) && ...
            all(returned_value(:) == value(:)));
   end
+  assert(double(testString_(char(55357))) == 65533);
   fprintf('PASS: %s\n', 'testString');
 end
@@ -140,6 +140,61 @@ void testOutputArguments() {
   output0[0] = lhs[0];
 }
 
+/** Test ragged array output to a pair of outputs.
+ */
+void testOutputArgumentsRagged() {
+  vector<vector<double> > rows(2, vector<double>(3, 1.0));
+  mexplus::Ragged<double> ragged(rows);
+  vector<mxArray*> lhs(2, static_cast<mxArray*>(NULL));
+  OutputArguments output(lhs.size(), &lhs[0], 2);
+  output.set(0, 1, ragged);
+  MxArray values(lhs[0]);
+  MxArray offsets(lhs[1]);
+  EXPECT(values.size() == 6);
+  EXPECT(offsets.size() == 3);
+  EXPECT(offsets.at<int>(2) == 6);
+}
+
+void testOutputArgumentsAllocate() {
+  vector<mxArray*> lhs(1, static_cast<mxArray*>(NULL));
+  OutputArguments output(lhs.size(), &lhs[0], 1);
+  const mwSize dimensions[] = {2, 3, 4};
+  mexplus::MxView<float> image = output.allocate<float>(
+      0, vector<mwSize>(dimensions, dimensions + 3));
+  EXPECT(!image.isScratch());
+  EXPECT(image.size() == 24 && image.dimensionSize() == 3);
+  for (mwIndex i = 0; i < image.size(); ++i)
+    image[i] = static_cast<float>(i);
+  image(1, 2, 3) = -1.0f;
+  EXPECT(image(1, 2, 3) == image[1 + 2 * (2 + 3 * 3)]);
+  MxArray result(lhs[0]);
+  EXPECT(result.isSingle());
+  EXPECT(mxGetNumberOfDimensions(lhs[0]) == 3);
+  EXPECT(result.at<float>(23) == -1.0f);
+  EXPECT(result.at<float>(22) == 22.0f);
+  mexplus::MxView<mxLogical> flags = output.allocate<mxLogical>(1, 2, 2);
+  EXPECT(flags.isScratch());
+  EXPECT(flags.rows() == 2 && flags.cols() == 2);
+  flags(1, 1) = true;
+  EXPECT(flags[3]);
+}
+
+/** Test lazy outputs skip the computation for unrequested outputs.
+ */
+void testOutputArgumentsLazy() {
+  vector<mxArray*> lhs(1, static_cast<mxArray*>(NULL));
+  OutputArguments output(lhs.size(), &lhs[0], 2);
+  EXPECT(output.wanted(0));
+  EXPECT(!output.wanted(1));
+  int calls = 0;
+  output.setLazy(0, [&calls]() { ++calls; return vector<double>(3, 1.0); });
+  output.setLazy(1, [&calls]() { ++calls; return string("unused"); });
+  EXPECT(calls == 1);
+  EXPECT(MxArray(lhs[0]).size() == 3);
+  output.setLazy(0, []() { return mxCreateDoubleScalar(2.0); });
+  EXPECT(mxGetScalar(lhs[0]) == 2.0);
+}
+
 }  // namespace
 
 void mexFunction(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]) {
@@ -148,4 +203,7 @@ void mexFunction(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]) {
   RUN_TEST(testInputsSingleFormatStructOptions);
   RUN_TEST(testInputsMultipleFormats);
   RUN_TEST(testOutputArguments);
+  RUN_TEST(testOutputArgumentsRagged);
+  RUN_TEST(testOutputArgumentsAllocate);
+  RUN_TEST(testOutputArgumentsLazy);
 }
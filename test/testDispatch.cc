@@ -3,6 +3,11 @@
  * Copyright 2013 Kota Yamaguchi.
  */
 
+#include <memory>
+#include <string>
+#include <vector>
+#include "mexplus/cache.h"
+#include "mexplus/callback.h"
 #include "mexplus/dispatch.h"
 
 #define EXPECT(condition) if (!(condition)) \
@@ -24,6 +29,125 @@ MEX_DEFINE(bar) (int nlhs,
                  const mxArray* prhs[]) {
 }
 
+MEX_DEFINE(scale) (int nlhs,
+                   mxArray* plhs[],
+                   int nrhs,
+                   const mxArray* prhs[]) {
+  if (nrhs != 2)
+    mexErrMsgTxt("Expected two inputs.");
+  plhs[0] = mxDuplicateArray(prhs[0]);
+  double* data = mxGetPr(plhs[0]);
+  for (size_t i = 0; i < mxGetNumberOfElements(plhs[0]); ++i)
+    data[i] *= mxGetScalar(prhs[1]);
+}
+
+MEX_DEFINE(sum) (int nlhs,
+                 mxArray* plhs[],
+                 int nrhs,
+                 const mxArray* prhs[]) {
+  if (nrhs != 1)
+    mexErrMsgTxt("Expected one input.");
+  double total = 0.0;
+  const double* data = mxGetPr(prhs[0]);
+  for (size_t i = 0; i < mxGetNumberOfElements(prhs[0]); ++i)
+    total += data[i];
+  plhs[0] = mxCreateDoubleScalar(total);
+  if (nlhs > 1)
+    plhs[1] = mxCreateDoubleScalar(mxGetNumberOfElements(prhs[0]));
+}
+
+MEX_DEFINE(cumsum) (int nlhs,
+                    mxArray* plhs[],
+                    int nrhs,
+                    const mxArray* prhs[]) {
+  if (nrhs != 1)
+    mexErrMsgTxt("Expected one input.");
+  std::shared_ptr<const std::vector<double> > input =
+      mexplus::Pipeline::consume<std::vector<double> >(0, prhs);
+  std::vector<double> output(*input);
+  for (size_t i = 1; i < output.size(); ++i)
+    output[i] += output[i - 1];
+  if (!mexplus::Pipeline::publish(0, std::move(output)))
+    plhs[0] = mexplus::MxArray::from(output);
+}
+
+MEX_DEFINE(length) (int nlhs,
+                    mxArray* plhs[],
+                    int nrhs,
+                    const mxArray* prhs[]) {
+  if (nrhs != 1)
+    mexErrMsgTxt("Expected one input.");
+  int length = static_cast<int>(
+      mexplus::Pipeline::consume<std::vector<double> >(0, prhs)->size());
+  if (!mexplus::Pipeline::publish(0, length))
+    plhs[0] = mexplus::MxArray::from(length);
+}
+
+MEX_DEFINE_CACHED(square, 1 << 10) (int nlhs,
+                                    mxArray* plhs[],
+                                    int nrhs,
+                                    const mxArray* prhs[]) {
+  // Other inputs are ignored, but still part of the cache key.
+  if (nrhs < 1)
+    mexErrMsgTxt("Expected an input.");
+  double value = mxGetScalar(prhs[0]);
+  plhs[0] = mxCreateDoubleScalar(value * value);
+}
+
+MEX_DEFINE(cacheStatistics) (int nlhs,
+                             mxArray* plhs[],
+                             int nrhs,
+                             const mxArray* prhs[]) {
+  plhs[0] = mexplus::OperationCache::statistics();
+}
+
+MEX_DEFINE(clearCache) (int nlhs,
+                        mxArray* plhs[],
+                        int nrhs,
+                        const mxArray* prhs[]) {
+  mexplus::OperationCache::invalidateAll();
+}
+
+MEX_DEFINE(evaluate) (int nlhs,
+                      mxArray* plhs[],
+                      int nrhs,
+                      const mxArray* prhs[]) {
+  if (nrhs != 2 && nrhs != 3)
+    mexErrMsgTxt("Expected two or three inputs.");
+  std::string mode = mexplus::MxArray::to<std::string>(prhs[1]);
+  bool reuse = (nrhs > 2) && mexplus::MxArray::to<bool>(prhs[2]);
+  mexplus::Callback<double(std::vector<double>)> callback(
+      prhs[0],
+      (mode == "stacked") ? mexplus::kStackedBatch : mexplus::kCellBatch,
+      reuse);
+  std::vector<double> x(2);
+  for (int i = 0; i < 3; ++i) {
+    x[0] = i;
+    x[1] = i + 1.0;
+    callback.push(x);
+  }
+  EXPECT(callback.pending() == 3);
+  plhs[0] = mexplus::MxArray::from(callback.flush());
+  if (nlhs > 1)
+    plhs[1] = mxCreateDoubleScalar(callback(x));
+  EXPECT(callback.pending() == 0);
+}
+
+MEX_DEFINE(release) (int nlhs,
+                     mxArray* plhs[],
+                     int nrhs,
+                     const mxArray* prhs[]) {
+  if (nrhs != 1)
+    mexErrMsgTxt("Expected one input.");
+  std::string mode = mexplus::MxArray::to<std::string>(prhs[0]);
+  mxArray* array = mexplus::MxArray::Numeric<double>(
+      2, 2, (mode == "persistent") ? mexplus::kPersistent : mexplus::kPooled);
+  mexplus::MxArrayPool::release(array);
+  if (mode == "twice")
+    mexplus::MxArrayPool::release(array);
+  mexplus::MxArrayPool::clear();
+}
+
 }  // namespace
 
 MEX_DISPATCH
@@ -3,11 +3,35 @@
  * Copyright 2013 Kota Yamaguchi.
  */
 
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <sstream>
 #include <typeinfo>
 #include "mexplus/mxarray.h"
+#include "mexplus/accessor.h"
+#include "mexplus/cache.h"
+#include "mexplus/arrow.h"
+#include "mexplus/chunked.h"
+#include "mexplus/cursor.h"
+#include "mexplus/dlpack.h"
+#include "mexplus/recorder.h"
+#include "mexplus/reflection.h"
+#include "mexplus/resident.h"
+#include "mexplus/shared.h"
+#include "mexplus/stringview.h"
 
 using namespace std;
 using mexplus::MxArray;
+using mexplus::Accessor;
+using mexplus::ChunkedReader;
+using mexplus::DLManagedTensor;
+using mexplus::MxAllocator;
+using mexplus::MxStringView;
+using mexplus::SharedMxArray;
 
 #define EXPECT(...) if (!(__VA_ARGS__)) \
     mexErrMsgIdAndTxt("test:MxArray", \
@@ -241,6 +265,599 @@ void testMxArrayString() {
   value4.set(0, nested_string[0]);
 }
 
+/** Check UTF-8 transcoding of std::string.
+ */
+void testMxArrayUnicode() {
+  // "H\u00e9\u20ac\U0001F600" in UTF-8 is 1 + 2 + 3 + 4 bytes.
+  const string text("H\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80");
+  MxArray value(text);
+  EXPECT(value.size() == 5);
+  const mxChar* chars = mxGetChars(value.get());
+  EXPECT(chars[0] == 0x48 && chars[1] == 0xE9 && chars[2] == 0x20AC);
+  EXPECT(chars[3] == 0xD83D && chars[4] == 0xDE00);
+  EXPECT(value.to<string>() == text);
+  // Long input exercises the block ASCII path around non-ASCII characters.
+  string long_text = string(40, 'a') + "\xE2\x82\xAC" + string(21, 'b');
+  MxArray long_value(long_text);
+  EXPECT(long_value.size() == 62);
+  EXPECT(mxGetChars(long_value.get())[40] == 0x20AC);
+  EXPECT(mxGetChars(long_value.get())[61] == 'b');
+  EXPECT(long_value.to<string>() == long_text);
+  // Invalid bytes are kept as single characters, as in Latin-1.
+  const string invalid("\x80\xFFz\xC3(\xED\xA0\x80\xC3\xA9");
+  MxArray bytes(invalid);
+  EXPECT(bytes.size() == 9);
+  EXPECT(mxGetChars(bytes.get())[1] == 0xFF);
+  EXPECT(mxGetChars(bytes.get())[8] == 0xE9);
+  EXPECT(bytes.to<string>() == "\xC2\x80\xC3\xBFz\xC3\x83(\xC3\xAD"
+                               "\xC2\xA0\xC2\x80\xC3\xA9");
+  EXPECT(mexplus::MxStringView(bytes.get()).equals(invalid));
+  EXPECT(mexplus::MxStringView(bytes.get()).hash() ==
+         mexplus::MxStringView::hashUtf8(invalid.data(), invalid.size()));
+  // A uint8 array round trips arbitrary bytes.
+  MxArray raw(MxArray::from(vector<uint8_t>(invalid.begin(), invalid.end())));
+  EXPECT(raw.size() == invalid.size() && raw.to<string>() == invalid);
+  // Other unpaired surrogates become U+FFFD.
+  const mwSize dimensions[] = {1, 1};
+  MxArray surrogate(mxCreateCharArray(2, dimensions));
+  mxGetChars(surrogate.get())[0] = static_cast<mxChar>(0xD83D);
+  EXPECT(surrogate.to<string>() == "\xEF\xBF\xBD");
+  // Other char containers keep one element per character.
+  EXPECT(value.to<vector<char> >().size() == 5);
+}
+
+/** Check cellstr and padded char matrix conversions.
+ */
+void testMxArrayCellstr() {
+  vector<string> rows;
+  rows.push_back("ab");
+  rows.push_back("");
+  rows.push_back("c\xE2\x82\xAC d");
+  MxArray cellstr(rows);
+  EXPECT(cellstr.isCell());
+  EXPECT(cellstr.size() == 3);
+  EXPECT(mxGetNumberOfElements(mxGetCell(cellstr.get(), 2)) == 4);
+  EXPECT(cellstr.to<vector<string> >() == rows);
+  MxArray matrix(MxArray::CharMatrix(rows));
+  EXPECT(matrix.isChar());
+  EXPECT(matrix.rows() == 3 && matrix.cols() == 4);
+  const mxChar* chars = mxGetChars(matrix.get());
+  EXPECT(chars[0] == 'a' && chars[1] == ' ' && chars[2] == 'c');
+  EXPECT(chars[3] == 'b' && chars[5] == 0x20AC && chars[10] == ' ');
+  EXPECT(matrix.to<vector<string> >() == rows);
+  MxArray single("single row  ");
+  vector<string> single_rows = single.to<vector<string> >();
+  EXPECT(single_rows.size() == 1 && single_rows[0] == "single row");
+  MxArray empty(MxArray::CharMatrix(vector<string>()));
+  EXPECT(empty.to<vector<string> >().empty());
+}
+
+/** Check string views over char arrays.
+ */
+void testMxStringView() {
+  const string text("key-\xE2\x82\xAC\xF0\x9F\x98\x80");
+  MxArray value(text);
+  MxStringView view = value.to<MxStringView>();
+  EXPECT(view.size() == 7);
+  EXPECT(view.data() == mxGetChars(value.get()));
+  EXPECT(!view.isAscii());
+  EXPECT(view == text);
+  EXPECT(view != "key-");
+  EXPECT(view != string("key-\xE2\x82\xAC\xF0\x9F\x98\x81"));
+  EXPECT(view.str() == text);
+  EXPECT(view.hash() == MxStringView::Hash()(text));
+  MxArray ascii("open");
+  MxStringView ascii_view(ascii.get());
+  EXPECT(ascii_view.isAscii());
+  EXPECT(ascii_view == "open");
+  EXPECT(ascii_view != "opens");
+  EXPECT(ascii_view != "ope");
+  EXPECT(ascii_view.hash() == MxStringView::Hash()(string("open")));
+  EXPECT(ascii_view != view);
+  EXPECT(MxStringView() == "");
+}
+
+/** Check adopting buffers from MxAllocator and mxMalloc().
+ */
+void testMxArrayAdopt() {
+  vector<double, MxAllocator<double> > values(6);
+  for (size_t i = 0; i < values.size(); ++i)
+    values[i] = static_cast<double>(i);
+  const double* buffer = values.data();
+  mwSize dimensions[] = {2, 3};
+  MxArray matrix(MxArray::adopt(std::move(values),
+                                vector<mwSize>(dimensions, dimensions + 2)));
+  EXPECT(values.empty());
+  EXPECT(matrix.isDouble());
+  EXPECT(matrix.rows() == 2 && matrix.cols() == 3);
+  EXPECT(matrix.getData<double>() == buffer);
+  EXPECT(matrix.at<double>(1, 2) == 5.0);
+  vector<int32_t, MxAllocator<int32_t> > row(4, 7);
+  MxArray row_array(MxArray::adopt(std::move(row)));
+  EXPECT(row_array.isInt32());
+  EXPECT(row_array.rows() == 1 && row_array.cols() == 4);
+  EXPECT(row_array.to<vector<int> >() == vector<int>(4, 7));
+  MxArray empty(MxArray::adopt(vector<float, MxAllocator<float> >()));
+  EXPECT(empty.isSingle() && empty.size() == 0);
+  vector<float, MxAllocator<float> > reserved;
+  reserved.reserve(8);
+  MxArray unused(MxArray::adopt(std::move(reserved)));
+  EXPECT(unused.size() == 0 && reserved.capacity() == 0);
+  mxLogical* flags = static_cast<mxLogical*>(mxCalloc(3, sizeof(mxLogical)));
+  flags[1] = true;
+  MxArray logical(MxArray::adopt(flags, vector<mwSize>(1, 3)));
+  EXPECT(logical.isLogical() && logical.size() == 3);
+  EXPECT(!logical.at<bool>(0) && logical.at<bool>(1));
+  // Other buffers from the allocator are still released as usual.
+  vector<double, MxAllocator<double> > temporary(100, 1.0);
+  temporary.resize(1000);
+}
+
+/** Check allocation policies.
+ */
+void testMxArrayAllocation() {
+  MxArray uninitialized(MxArray::Numeric<double>(3,
+                                                 2,
+                                                 mexplus::kUninitialized));
+  EXPECT(uninitialized.isDouble());
+  EXPECT(uninitialized.rows() == 3 && uninitialized.cols() == 2);
+  MxArray logical(MxArray::Logical(2, 2, mexplus::kUninitialized));
+  EXPECT(logical.isLogical() && logical.size() == 4);
+  mexplus::MxArrayPool::clear();
+  mxArray* persistent = MxArray::Numeric<int32_t>(4, 1, mexplus::kPersistent);
+  EXPECT(mxIsInt32(persistent) && *static_cast<int32_t*>(
+      mxGetData(persistent)) == 0);
+  EXPECT(mexplus::MxArrayPool::size() == 1);
+  mxArray* scratch = MxArray::Numeric<float>(8, 8, mexplus::kPooled);
+  EXPECT(mxIsSingle(scratch) && mxGetNumberOfElements(scratch) == 64);
+  EXPECT(mexplus::MxArrayPool::size() == 2);
+  mexplus::MxArrayPool::release(scratch);
+  EXPECT(mexplus::MxArrayPool::available() == 1);
+  EXPECT(MxArray::Numeric<float>(8, 8, mexplus::kPooled) == scratch);
+  EXPECT(MxArray::Numeric<float>(8, 4, mexplus::kPooled) != scratch);
+  EXPECT(MxArray::Logical(8, 8, mexplus::kPooled) != scratch);
+  EXPECT(mexplus::MxArrayPool::size() == 4);
+  mexplus::MxArrayPool::release(scratch);
+  EXPECT(mexplus::MxArrayPool::available() == 1);
+  mexplus::MxArrayPool::destroy(persistent);
+  EXPECT(mexplus::MxArrayPool::size() == 3);
+  // The exit handler destroys the rest, as when the MEX file is cleared.
+  mexplus::ExitHandlers::run();
+  EXPECT(mexplus::MxArrayPool::size() == 0);
+  EXPECT(mexplus::MxArrayPool::available() == 0);
+}
+
+/** Check typed accessors.
+ */
+void testAccessor() {
+  vector<int> values(10);
+  for (int i = 0; i < 10; ++i)
+    values[i] = i;
+  MxArray input(values);
+  const MxArray& const_input = input;
+  Accessor<double> reader(const_input);
+  EXPECT(reader.size() == 10);
+  EXPECT(!reader.isDirect());
+  MxArray output(MxArray::Numeric<double>(1, 10));
+  Accessor<double, mexplus::UncheckedAccess> writer(output);
+  EXPECT(writer.isDirect());
+  for (mwIndex i = 0; i < reader.size(); ++i)
+    writer[i] = 0.5 * reader[i];
+  EXPECT(output.at<double>(9) == 4.5);
+  Accessor<int> converter(input);
+  converter[3] = converter[9];
+  converter.set(4, -1);
+  EXPECT(input.at<int>(3) == 9 && input.at<int>(4) == -1);
+  MxArray flags(MxArray::Logical(1, 3));
+  Accessor<bool> logical(flags);
+  logical[1] = true;
+  EXPECT(!logical[0] && logical[1] && flags.at<bool>(1));
+  MxArray text("abc");
+  EXPECT(Accessor<char>(text)[2] == 'c');
+}
+
+/** Check conversions into preallocated storage.
+ */
+void testMxArrayToInto() {
+  vector<double> values(5, 2.0);
+  MxArray array(values);
+  float buffer[8];
+  EXPECT(MxArray::toInto(array.get(), buffer, 8) == 5);
+  EXPECT(buffer[4] == 2.0f);
+  vector<int> scratch;
+  scratch.reserve(16);
+  const int* storage = scratch.data();
+  MxArray::toInto(array.get(), &scratch);
+  EXPECT(scratch.size() == 5 && scratch[0] == 2);
+  MxArray::toInto(MxArray(vector<int>(16, 3)).get(), &scratch);
+  EXPECT(scratch.size() == 16 && scratch[15] == 3);
+  MxArray::toInto(array.get(), &scratch);
+  EXPECT(scratch.size() == 5 && scratch.data() == storage);
+  std::array<uint8_t, 6> fixed;
+  fixed.fill(0);
+  EXPECT(MxArray::toInto(array.get(), &fixed) == 5);
+  EXPECT(fixed[4] == 2 && fixed[5] == 0);
+}
+
+/** Check chunked conversion with and without prefetch.
+ */
+void testChunkedReader() {
+  vector<int32_t> values(1000);
+  for (size_t i = 0; i < values.size(); ++i)
+    values[i] = static_cast<int32_t>(i);
+  MxArray array(values);
+  for (int prefetch = 0; prefetch < 2; ++prefetch) {
+    ChunkedReader<double> reader(array.get(), 64, prefetch != 0);
+    double sum = 0.0;
+    mwIndex expected_offset = 0;
+    int chunks = 0;
+    while (reader.next()) {
+      EXPECT(reader.offset() == expected_offset);
+      EXPECT(reader.size() == min<mwSize>(64, 1000 - expected_offset));
+      EXPECT(reader.data()[0] == static_cast<double>(expected_offset));
+      for (mwSize i = 0; i < reader.size(); ++i)
+        sum += reader.data()[i];
+      expected_offset += reader.size();
+      ++chunks;
+    }
+    EXPECT(chunks == 16 && sum == 999.0 * 1000.0 / 2.0);
+    EXPECT(!reader.next());
+  }
+  double total = 0.0;
+  for (const ChunkedReader<float>::Chunk& chunk :
+       ChunkedReader<float>(array.get(), 300, true))
+    for (float value : chunk)
+      total += value;
+  EXPECT(total == 999.0 * 1000.0 / 2.0);
+  MxArray logical(vector<bool>(100, true));
+  mxGetLogicals(logical.get())[99] = false;
+  size_t count = 0;
+  for (const ChunkedReader<bool>::Chunk& chunk :
+       ChunkedReader<bool>(logical.get(), 30, true))
+    count += std::count(chunk.begin(), chunk.end(), true);
+  EXPECT(count == 99);
+  ChunkedReader<bool> numbers(array.get(), 1000);
+  EXPECT(numbers.next() && !numbers.data()[0] && numbers.data()[1]);
+  MxArray empty_array(MxArray::Numeric<int32_t>(0, 0));
+  ChunkedReader<uint8_t> empty(empty_array.get(), 8, true);
+  EXPECT(!empty.next() && empty.total() == 0);
+}
+
+/** Check that a prefetching cursor reports done() before the whole
+ * prefetched chunk is ready.
+ */
+void testCursorPrefetch() {
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool open = false;
+  bool completed = false;
+  int count = 0;
+  // Items after the fourth wait until the gate opens, or time out.
+  mexplus::Cursor<double> cursor([&](double* value) {
+    if (count >= 6)
+      return false;
+    if (count >= 4) {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait_for(lock, std::chrono::seconds(5), [&] { return open; });
+    }
+    *value = count++;
+    if (count == 6) {
+      std::lock_guard<std::mutex> lock(mutex);
+      completed = true;
+    }
+    return true;
+  }, true);
+  MxArray values(cursor.next(3));
+  EXPECT(values.to<vector<double> >() == vector<double>({0, 1, 2}));
+  EXPECT(!cursor.done());
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT(!completed);
+    open = true;
+  }
+  condition.notify_all();
+  values.reset(cursor.next(3));
+  EXPECT(values.to<vector<double> >() == vector<double>({3, 4, 5}));
+  EXPECT(cursor.done());
+}
+
+/** Check copy-on-write shared handles.
+ */
+void testSharedMxArray() {
+  MxArray cell(MxArray::Cell(1, 2));
+  cell.set(0, 1);
+  cell.set(1, "text");
+  SharedMxArray original(std::move(cell));
+  SharedMxArray copy = original;
+  EXPECT(copy.isSharedWith(original) && copy.useCount() == 2);
+  const mxArray* pointer = original.get();
+  copy.mutableArray().set(0, 2);
+  EXPECT(!copy.isSharedWith(original) && original.get() == pointer);
+  EXPECT(original.array().at<int>(0) == 1 && copy.array().at<int>(0) == 2);
+  EXPECT(copy.mutableArray().get() == copy.get());
+  MxArray struct_array(MxArray::Struct());
+  struct_array.set("value", 3);
+  SharedMxArray borrowed(struct_array.get());
+  EXPECT(borrowed.isUnique() && borrowed.get() == struct_array.get());
+  borrowed.mutableArray().set("value", 4);
+  EXPECT(borrowed.get() != struct_array.get());
+  EXPECT(borrowed.getMutable() == borrowed.get());
+  EXPECT(struct_array.at<int>("value") == 3 &&
+         borrowed.array().at<int>("value") == 4);
+  SharedMxArray shared = borrowed;
+  MxArray released(shared.release());
+  EXPECT(!shared && released.get() != borrowed.get());
+  pointer = borrowed.get();
+  released.reset(borrowed.release());
+  EXPECT(!borrowed && released.get() == pointer);
+  SharedMxArray scalar(5.0);
+  EXPECT(scalar.to<double>() == 5.0);
+}
+
+/** Check Arrow export and import.
+ */
+void testArrow() {
+  vector<double> values;
+  values.push_back(1.5);
+  values.push_back(-2.0);
+  values.push_back(4.0);
+  SharedMxArray numeric(values);
+  ArrowArray array;
+  ArrowSchema schema;
+  mexplus::ExportArrow(numeric, &array, &schema);
+  EXPECT(string(schema.format) == "g" && array.length == 3);
+  EXPECT(array.buffers[1] == mxGetData(numeric.get()));
+  EXPECT(numeric.useCount() == 2);
+  MxArray imported(mexplus::ImportArrow(&array, &schema));
+  EXPECT(!array.release && !schema.release && numeric.useCount() == 1);
+  EXPECT(imported.rows() == 3 && imported.to<vector<double> >() == values);
+  vector<bool> flags(10, false);
+  flags[0] = flags[9] = true;
+  MxArray logical(flags);
+  mexplus::ExportArrow(logical.get(), &array, &schema);
+  EXPECT(string(schema.format) == "b");
+  EXPECT(static_cast<const uint8_t*>(array.buffers[1])[1] == 2);
+  imported.reset(mexplus::ImportArrow(&array, &schema));
+  EXPECT(imported.isLogical() && imported.to<vector<bool> >() == flags);
+  vector<string> words;
+  words.push_back("arrow");
+  words.push_back("");
+  words.push_back("caf\xc3\xa9");
+  MxArray cellstr(words);
+  mexplus::ExportArrow(cellstr.get(), &array, &schema);
+  EXPECT(string(schema.format) == "u" && array.n_buffers == 3);
+  EXPECT(static_cast<const int32_t*>(array.buffers[1])[3] == 10);
+  imported.reset(mexplus::ImportArrow(&array, &schema));
+  EXPECT(imported.isCell() && imported.to<vector<string> >() == words);
+  float nullable[3] = {1.0f, 2.0f, 3.0f};
+  uint8_t validity = 5;
+  const void* buffers[2] = {&validity, nullable};
+  ArrowArray foreign = {3, 1, 0, 2, 0, buffers, NULL, NULL, NULL, NULL};
+  foreign.release = [](ArrowArray* array) { array->release = NULL; };
+  schema.format = "f";
+  schema.release = [](ArrowSchema* schema) { schema->release = NULL; };
+  imported.reset(mexplus::ImportArrow(&foreign, &schema));
+  EXPECT(imported.at<float>(0) == 1.0f && mxIsNaN(imported.at<float>(1)));
+  EXPECT(!foreign.release && imported.classID() == mxSINGLE_CLASS);
+}
+
+/** Check DLPack export and import.
+ */
+void testDLPack() {
+  MxArray array(MxArray::Numeric<float>(vector<size_t>{2, 3, 4}));
+  for (mwIndex i = 0; i < array.size(); ++i)
+    array.set(i, static_cast<float>(i));
+  const mxArray* pointer = array.get();
+  DLManagedTensor* tensor = mexplus::ToDLPack(std::move(array));
+  EXPECT(tensor->dl_tensor.ndim == 3 && tensor->dl_tensor.shape[2] == 4);
+  EXPECT(tensor->dl_tensor.strides[0] == 1 &&
+         tensor->dl_tensor.strides[2] == 6);
+  EXPECT(tensor->dl_tensor.dtype.code == mexplus::kDLFloat &&
+         tensor->dl_tensor.dtype.bits == 32);
+  EXPECT(tensor->dl_tensor.data == mxGetData(pointer));
+  MxArray adopted(mexplus::FromDLPack(tensor));
+  EXPECT(adopted.get() == pointer);
+  SharedMxArray shared(adopted.get());
+  tensor = mexplus::ToDLPack(shared);
+  MxArray copied(mexplus::FromDLPack(tensor));
+  EXPECT(copied.get() != pointer && copied.at<float>(23) == 23.0f);
+  EXPECT(shared.useCount() == 1);
+  // Row-major 2x3 int16 tensor without strides.
+  int16_t values[6] = {1, 2, 3, 4, 5, 6};
+  int64_t shape[2] = {2, 3};
+  DLManagedTensor foreign;
+  foreign.dl_tensor.data = values;
+  foreign.dl_tensor.device.device_type = mexplus::kDLCPU;
+  foreign.dl_tensor.device.device_id = 0;
+  foreign.dl_tensor.ndim = 2;
+  foreign.dl_tensor.dtype.code = mexplus::kDLInt;
+  foreign.dl_tensor.dtype.bits = 16;
+  foreign.dl_tensor.dtype.lanes = 1;
+  foreign.dl_tensor.shape = shape;
+  foreign.dl_tensor.strides = NULL;
+  foreign.dl_tensor.byte_offset = 0;
+  foreign.manager_ctx = NULL;
+  foreign.deleter = [](DLManagedTensor* tensor) { tensor->deleter = NULL; };
+  copied.reset(mexplus::FromDLPack(&foreign));
+  EXPECT(!foreign.deleter && copied.classID() == mxINT16_CLASS);
+  EXPECT(copied.rows() == 2 && copied.cols() == 3);
+  EXPECT(copied.at<int>(2) == 2 && copied.at<int>(1) == 4 &&
+         copied.at<int>(5) == 6);
+}
+
+/** Check resident arrays kept in a session.
+ */
+void testResidentArray() {
+  typedef mexplus::ResidentArray<float> Resident;
+  typedef mexplus::Session<Resident> ResidentStore;
+  MxArray input(MxArray::Numeric<double>(3, 4));
+  for (mwIndex i = 0; i < input.size(); ++i)
+    input.set(i, static_cast<double>(i));
+  MxArray id(ResidentStore::create(new Resident(input.get(), 128)));
+  Resident* resident = ResidentStore::get(id.get());
+  EXPECT(reinterpret_cast<uintptr_t>(resident->data()) % 128 == 0);
+  mexplus::MxView<float> view = resident->view();
+  EXPECT(view.rows() == 3 && view.cols() == 4 && view(2, 3) == 11.0f);
+  resident->update(4, MxArray(vector<int>(2, -1)).get());
+  EXPECT(view[3] == 3.0f && view[4] == -1.0f && view[5] == -1.0f &&
+         view[6] == 6.0f);
+  vector<mwIndex> indices;
+  indices.push_back(0);
+  indices.push_back(11);
+  resident->update(indices, MxArray(vector<double>(2, 7.0)).get());
+  MxArray output(resident->download());
+  EXPECT(output.classID() == mxSINGLE_CLASS && output.cols() == 4);
+  EXPECT(output.at<float>(0) == 7.0f && output.at<float>(11) == 7.0f &&
+         output.at<float>(5) == -1.0f);
+  ResidentStore::destroy(id.get());
+  EXPECT(!ResidentStore::exist(id.get()));
+}
+
+/** Check content hashing.
+ */
+void testMxArrayHash() {
+  vector<double> values(4, 1.0);
+  MxArray row(values);
+  MxArray same(values);
+  EXPECT(row.hash() == same.hash() && row.get() != same.get());
+  MxArray column(MxArray::Numeric<double>(4, 1));
+  for (mwIndex i = 0; i < 4; ++i)
+    column.set(i, 1.0);
+  EXPECT(row.hash() != column.hash());
+  EXPECT(row.hash() != MxArray(vector<float>(4, 1.0f)).hash());
+  MxArray cell(MxArray::Cell(1, 2));
+  cell.set(0, values);
+  uint64_t empty_cell = cell.hash();
+  cell.set(1, MxArray::Numeric<double>(0, 0));
+  EXPECT(cell.hash() == empty_cell);
+  cell.set(1, "text");
+  uint64_t text_cell = cell.hash();
+  cell.set(1, "texT");
+  EXPECT(cell.hash() != text_cell && cell.hash() != empty_cell);
+  const char* fields[] = {"a", "b"};
+  MxArray first(MxArray::Struct(2, fields));
+  first.set("a", 1);
+  first.set("b", 2);
+  const char* swapped[] = {"b", "a"};
+  MxArray second(MxArray::Struct(2, swapped));
+  second.set("a", 1);
+  second.set("b", 2);
+  EXPECT(first.hash() != second.hash());
+  second.set("b", 1);
+  second.set("a", 2);
+  EXPECT(first.hash() != second.hash());
+  MxArray large(vector<double>(1 << 20, 0.5));
+  EXPECT(large.hash() == large.hash(true));
+  EXPECT(MxArray::hash(large.get()) == large.hash());
+  EXPECT(mexplus::HashArray(cell.get(), false, 1) != cell.hash());
+  const uint64_t seeds[2] = {0, 1};
+  uint64_t hashes[2];
+  mexplus::HashArray(first.get(), seeds, hashes);
+  EXPECT(hashes[0] == first.hash() &&
+         hashes[1] == mexplus::HashArray(first.get(), false, 1));
+  mexplus::HashArray(large.get(), seeds, hashes, true);
+  EXPECT(hashes[0] == large.hash() &&
+         hashes[1] == mexplus::HashArray(large.get(), false, 1));
+  EXPECT(mexplus::IsHashable(cell.get()) && mexplus::IsHashable(NULL));
+}
+
+/** Check that an operation cache entry matches only on both hashes.
+ */
+void testOperationCache() {
+  mexplus::OperationCache cache(1 << 10);
+  mxArray* outputs[] = {MxArray::from(9.0)};
+  cache.store(1, 2, 1, outputs);
+  mxDestroyArray(outputs[0]);
+  mxArray* result = NULL;
+  EXPECT(!cache.lookup(1, 3, 1, &result) && !result);
+  EXPECT(cache.lookup(1, 2, 1, &result));
+  EXPECT(MxArray(result).to<double>() == 9.0);
+  outputs[0] = MxArray::from(16.0);
+  cache.store(1, 3, 1, outputs);
+  mxDestroyArray(outputs[0]);
+  EXPECT(cache.size() == 1 && !cache.lookup(1, 2, 1, &result));
+  EXPECT(cache.hits() == 1 && cache.misses() == 2);
+}
+
+/** Check call log serialization.
+ */
+void testCallLog() {
+  const char* fields[] = {"a", "b"};
+  MxArray structure(MxArray::Struct(2, fields));
+  structure.set("a", vector<int>(3, 7));
+  structure.set("b", "text");
+  MxArray cell(MxArray::Cell(1, 3));
+  cell.set(0, structure.release());
+  cell.set(1, vector<bool>(5, true));
+  MxArray sparse(mxCreateSparse(3, 2, 2, mxREAL));
+  mxGetJc(sparse.get())[1] = 1;
+  mxGetJc(sparse.get())[2] = 2;
+  mxGetIr(sparse.get())[0] = 2;
+  mxGetIr(sparse.get())[1] = 0;
+  mxGetPr(sparse.get())[0] = 1.5;
+  mxGetPr(sparse.get())[1] = -2.0;
+  MxArray complex(mxCreateDoubleMatrix(2, 1, mxCOMPLEX));
+  mxGetPi(complex.get())[1] = 3.0;
+  MxArray name("solve");
+  const mxArray* prhs[] = {name.get(), cell.get(), sparse.get(),
+                           complex.get()};
+  std::stringstream log;
+  mexplus::WriteCallLogHeader(&log);
+  mexplus::WriteCallRecord(&log, "solve", 2, 0.25, 4, prhs);
+  mexplus::WriteCallRecord(&log, "empty", 0, 0.5, 0, NULL,
+                           vector<int64_t>(1, 1234), vector<int64_t>(2, 5));
+  mexplus::ReadCallLogHeader(&log);
+  mexplus::CallRecord record;
+  EXPECT(mexplus::ReadCallRecord(&log, &record));
+  EXPECT(record.name == "solve" && record.nlhs == 2 && record.seconds == 0.25);
+  EXPECT(record.arguments.size() == 4);
+  for (size_t i = 0; i < record.arguments.size(); ++i)
+    EXPECT(MxArray::hash(record.arguments[i]) == MxArray::hash(prhs[i]));
+  EXPECT(mxIsSparse(record.arguments[2]) && mxIsComplex(record.arguments[3]));
+  EXPECT(!mxGetCell(record.arguments[1], 2));
+  EXPECT(mexplus::ReadCallRecord(&log, &record));
+  EXPECT(record.name == "empty" && record.arguments.empty());
+  EXPECT(record.created.size() == 1 && record.created[0] == 1234);
+  EXPECT(record.destroyed.size() == 2 && record.changesSessions());
+  EXPECT(!mexplus::ReadCallRecord(&log, &record));
+  // Recorded session ids are replaced in nested inputs.
+  mexplus::SessionIdMap sessions;
+  sessions[1234] = 99;
+  MxArray ids(MxArray::Cell(1, 4));
+  ids.set(0, 1234.0);
+  ids.set(1, static_cast<int64_t>(1234));
+  ids.set(2, 1234.5);
+  // Doubles that do not fit in int64_t are left alone.
+  vector<double> others = {numeric_limits<double>::quiet_NaN(),
+                           numeric_limits<double>::infinity(), -1e300, 1e19};
+  ids.set(3, others);
+  mexplus::RemapSessions(ids.getMutable(), sessions);
+  EXPECT(MxArray::at<double>(ids.at(0), 0) == 99);
+  EXPECT(MxArray::at<int64_t>(ids.at(1), 0) == 99);
+  EXPECT(MxArray::at<double>(ids.at(2), 0) == 1234.5);
+  EXPECT(MxArray::at<double>(ids.at(3), 3) == 1e19 &&
+         std::isnan(MxArray::at<double>(ids.at(3), 0)));
+  // A function handle is recorded as an empty double array.
+  mxArray* function_name = MxArray::from("disp");
+  mxArray* function_handle = NULL;
+  mexCallMATLAB(1, &function_handle, 1, &function_name, "str2func");
+  mxDestroyArray(function_name);
+  MxArray handles(MxArray::Cell(1, 2));
+  handles.set(0, function_handle);
+  handles.set(1, 42);
+  MxArray last(3.5);
+  log.clear();
+  const mxArray* handle_prhs[] = {handles.get(), last.get()};
+  mexplus::WriteCallRecord(&log, "handle", 1, 0.125, 2, handle_prhs);
+  EXPECT(mexplus::ReadCallRecord(&log, &record));
+  EXPECT(record.name == "handle" && record.arguments.size() == 2);
+  const mxArray* placeholder = mxGetCell(record.arguments[0], 0);
+  EXPECT(mxIsDouble(placeholder) && mxIsEmpty(placeholder));
+  EXPECT(MxArray::at<int>(record.arguments[0], 1) == 42);
+  EXPECT(MxArray::to<double>(record.arguments[1]) == 3.5);
+  EXPECT(!mexplus::ReadCallRecord(&log, &record));
+}
+
 /** Check cell array.
  */
 void testMxArrayCell() {
@@ -279,6 +896,68 @@ void testMxArrayStruct() {
   EXPECT(!struct_array.at("field1"));
 }
 
+/** Check nested conversion from rvalue and into existing storage.
+ */
+void testMxArrayNestedMove() {
+  vector<vector<string> > nested(3, vector<string>(2, "element"));
+  nested[2][1] = "last";
+  MxArray array(MxArray::from(std::move(nested)));
+  EXPECT(array.isCell());
+  EXPECT(array.size() == 3);
+  EXPECT(nested.size() == 3);
+  EXPECT(nested[0].empty());
+  vector<vector<string> > returned(5, vector<string>(8, "reused"));
+  array.to(&returned);
+  EXPECT(returned.size() == 3);
+  EXPECT(returned[0].size() == 2);
+  EXPECT(returned[0][0] == "element");
+  EXPECT(returned[2][1] == "last");
+  vector<vector<double> > numbers(2, vector<double>(3, 1.0));
+  MxArray number_array(MxArray::from(std::move(numbers)));
+  EXPECT(number_array.at<vector<double> >(1).size() == 3);
+  MxArray logical_cell(MxArray::Cell(1, 2));
+  logical_cell.set(0, MxArray::from(true));
+  logical_cell.set(1, MxArray::from(false));
+  vector<bool> flags = logical_cell.to<vector<bool> >();
+  EXPECT(flags.size() == 2 && flags[0] && !flags[1]);
+}
+
+/** Check packed ragged array.
+ */
+void testMxArrayRagged() {
+  vector<vector<int> > rows(3);
+  rows[0].push_back(1);
+  rows[0].push_back(2);
+  rows[2].push_back(3);
+  mexplus::Ragged<int> ragged(rows);
+  EXPECT(ragged.size() == 3);
+  EXPECT(ragged.rowSize(0) == 2);
+  EXPECT(ragged.rowSize(1) == 0);
+  EXPECT(ragged.rowSize(2) == 1);
+  MxArray array(ragged);
+  EXPECT(array.isStruct());
+  EXPECT(array.at<vector<int> >("values").size() == 3);
+  EXPECT(array.at<vector<mwIndex> >("offsets").size() == 4);
+  mexplus::Ragged<double> returned = array.to<mexplus::Ragged<double> >();
+  EXPECT(returned.offsets == ragged.offsets);
+  EXPECT(returned.values.size() == 3);
+  EXPECT(returned.values[2] == 3.0);
+  MxArray cell_array(MxArray::Cell(1, 3));
+  cell_array.set(0, vector<double>(2, 1.5));
+  cell_array.set(1, vector<float>());
+  cell_array.set(2, vector<uint8_t>(3, 7));
+  mexplus::Ragged<float> packed = cell_array.to<mexplus::Ragged<float> >();
+  EXPECT(packed.size() == 3);
+  EXPECT(packed.values.size() == 5);
+  EXPECT(packed.rowSize(1) == 0);
+  EXPECT(*packed.begin(0) == 1.5f);
+  EXPECT(*packed.begin(2) == 7.0f);
+  vector<mexplus::Ragged<int> > nested(2, ragged);
+  MxArray nested_array(nested);
+  EXPECT(nested_array.isCell());
+  EXPECT(nested_array.at<mexplus::Ragged<int> >(1).values == ragged.values);
+}
+
 }  // namespace
 
 /** Custom cell object for conversion test.
@@ -295,6 +974,27 @@ struct MyStructObject {
   vector<float> value;
 };
 
+/** Reflected struct object for conversion test.
+ */
+struct MyReflectedObject {
+  int id;
+  string name;
+  vector<double> value;
+};
+
+MEXPLUS_STRUCT(MyReflectedObject, id, name, value)
+
+/** Record object for columnar conversion test.
+ */
+struct MyRecord {
+  double x;
+  int32_t y;
+  bool flag;
+  string label;
+};
+
+MEXPLUS_STRUCT(MyRecord, x, y, flag, label)
+
 namespace mexplus {
 
 template <>
@@ -359,6 +1059,103 @@ void testCustomStruct() {
   EXPECT(object.value.size() == object2.value.size());
 }
 
+void testReflectedStruct() {
+  MyReflectedObject object, object2;
+  object.id = 3;
+  object.name = "foo";
+  object.value = vector<double>(4, 1.5);
+  MxArray array(MxArray::from(object));
+  EXPECT(array);
+  EXPECT(array.isStruct());
+  EXPECT(array.size() == 1);
+  EXPECT(array.fieldSize() == 3);
+  EXPECT(array.fieldName(0) == "id");
+  EXPECT(array.at<int>("id") == 3);
+  EXPECT(array.at<string>("name") == "foo");
+  MxArray::to(array.get(), &object2);
+  EXPECT(object2.id == object.id);
+  EXPECT(object2.name == object.name);
+  EXPECT(object2.value == object.value);
+  EXPECT(array.to<MyReflectedObject>().name == "foo");
+
+  vector<MyReflectedObject> objects(3, object), objects2;
+  objects[1].id = 4;
+  objects[2].name = "bar";
+  MxArray struct_array(MxArray::from(objects));
+  EXPECT(struct_array.isStruct());
+  EXPECT(struct_array.size() == 3);
+  EXPECT(struct_array.at<int>("id", 1) == 4);
+  EXPECT(struct_array.at<string>("name", 2) == "bar");
+  MxArray::to(struct_array.get(), &objects2);
+  EXPECT(objects2.size() == 3);
+  EXPECT(objects2[1].id == 4);
+  EXPECT(objects2[2].name == "bar");
+
+  // Different field order and a cell array of structs are also accepted.
+  const char* fields[] = {"value", "name", "id", "extra"};
+  MxArray reordered(MxArray::Struct(4, fields, 1, 2));
+  for (mwIndex i = 0; i < 2; ++i) {
+    reordered.set("value", vector<double>(1, 2.0), i);
+    reordered.set("name", "baz", i);
+    reordered.set("id", static_cast<int>(i), i);
+  }
+  MxArray::to(reordered.get(), &objects2);
+  EXPECT(objects2.size() == 2);
+  EXPECT(objects2[1].id == 1);
+  EXPECT(objects2[1].value.size() == 1);
+  MxArray cell_array(MxArray::Cell(1, 2));
+  cell_array.set(0, object);
+  cell_array.set(1, objects[1]);
+  MxArray::to(cell_array.get(), &objects2);
+  EXPECT(objects2.size() == 2);
+  EXPECT(objects2[1].id == 4);
+  MxArray empty_array(MxArray::from(vector<MyReflectedObject>()));
+  EXPECT(empty_array.isStruct());
+  EXPECT(empty_array.size() == 0);
+}
+
+void testColumnarStruct() {
+  typedef mexplus::MxStruct<MyRecord> Records;
+  vector<MyRecord> records(5), records2;
+  for (int i = 0; i < records.size(); ++i) {
+    records[i].x = i * 0.5;
+    records[i].y = -i;
+    records[i].flag = (i % 2 == 0);
+    records[i].label = string(i + 1, 'a');
+  }
+  MxArray array(Records::fromColumns(records));
+  EXPECT(array.isStruct());
+  EXPECT(array.size() == 1);
+  MxArray x(array.at("x"));
+  EXPECT(x.isDouble());
+  EXPECT(x.rows() == 5 && x.cols() == 1);
+  EXPECT(x.at<double>(3) == 1.5);
+  EXPECT(MxArray(array.at("y")).isInt32());
+  EXPECT(MxArray(array.at("flag")).isLogical());
+  EXPECT(MxArray(array.at("label")).isCell());
+  EXPECT(MxArray(array.at("label")).at<string>(2) == "aaa");
+  Records::toColumns(array.get(), &records2);
+  EXPECT(records2.size() == records.size());
+  for (int i = 0; i < records.size(); ++i) {
+    EXPECT(records2[i].x == records[i].x);
+    EXPECT(records2[i].y == records[i].y);
+    EXPECT(records2[i].flag == records[i].flag);
+    EXPECT(records2[i].label == records[i].label);
+  }
+  // Columns of another class or in a cell array are converted.
+  array.set("x", vector<float>(5, 2.0f));
+  MxArray cell_column(MxArray::Cell(5, 1));
+  for (mwIndex i = 0; i < 5; ++i)
+    cell_column.set(i, static_cast<int>(i * 10));
+  array.set("y", cell_column.release());
+  Records::toColumns(array.get(), &records2);
+  EXPECT(records2[4].x == 2.0);
+  EXPECT(records2[4].y == 40);
+  MxArray empty_array(Records::fromColumns(vector<MyRecord>()));
+  Records::toColumns(empty_array.get(), &records2);
+  EXPECT(records2.empty());
+}
+
 }  // namespace
 
 void mexFunction(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]) {
@@ -367,8 +1164,28 @@ void mexFunction(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]) {
   RUN_TEST(testAllComplex);
   RUN_TEST(testMxArrayMemory);
   RUN_TEST(testMxArrayString);
+  RUN_TEST(testMxArrayUnicode);
+  RUN_TEST(testMxArrayCellstr);
+  RUN_TEST(testMxStringView);
+  RUN_TEST(testMxArrayAdopt);
+  RUN_TEST(testMxArrayAllocation);
+  RUN_TEST(testAccessor);
+  RUN_TEST(testMxArrayToInto);
+  RUN_TEST(testChunkedReader);
+  RUN_TEST(testCursorPrefetch);
+  RUN_TEST(testSharedMxArray);
+  RUN_TEST(testArrow);
+  RUN_TEST(testDLPack);
+  RUN_TEST(testResidentArray);
+  RUN_TEST(testMxArrayHash);
+  RUN_TEST(testOperationCache);
+  RUN_TEST(testCallLog);
   RUN_TEST(testMxArrayCell);
   RUN_TEST(testMxArrayStruct);
+  RUN_TEST(testMxArrayNestedMove);
+  RUN_TEST(testMxArrayRagged);
   RUN_TEST(testCustomStruct);
   RUN_TEST(testCustomCell);
+  RUN_TEST(testReflectedStruct);
+  RUN_TEST(testColumnarStruct);
 }
@@ -4,6 +4,8 @@
  */
 
 #include <cstdint>
+#include <stdexcept>
+#include "mexplus/cursor.h"
 #include "mexplus/dispatch.h"
 
 using namespace std;
@@ -79,6 +81,29 @@ MEX_DEFINE(clear) (int nlhs,
   HypotheticalObjects::clear();
 }
 
+MEX_DEFINE(range) (int nlhs,
+                   mxArray* plhs[],
+                   int nrhs,
+                   const mxArray* prhs[]) {
+  if (nrhs < 1)
+    mexErrMsgTxt("Expected the number of items.");
+  int size = static_cast<int>(mxGetScalar(prhs[0]));
+  // Optionally fail at the given item.
+  int failure = (nrhs > 1) ? static_cast<int>(mxGetScalar(prhs[1])) : -1;
+  int count = 0;
+  plhs[0] = ConvertFromNumeric<int64_t>(mexplus::CursorBase::create(
+      new mexplus::Cursor<double>([=](double* value) mutable {
+        if (count == failure)
+          throw std::runtime_error("Failed to generate an item.");
+        if (count >= size)
+          return false;
+        *value = count++;
+        return true;
+      }, true)));
+}
+
+MEX_DEFINE_CURSOR_OPERATIONS
+
 }  // namespace
 
 MEX_DISPATCH
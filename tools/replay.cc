@@ -0,0 +1,179 @@
+/** Replay a call log recorded by MEX_DISPATCH.
+ *
+ * Copyright 2014 Kota Yamaguchi.
+ *
+ * Build this file together with the MEX_DEFINE sources of the library and the
+ * stand-in MEX runtime in standalone/, then run the calls in the log and
+ * report the latency of each operation.
+ *
+ *    $ c++ -std=c++11 -O2 -Iinclude -Istandalone/include mylibrary.cc \
+ *          tools/replay.cc standalone/src/mex.cc -o mylibrary_replay
+ *    $ ./mylibrary_replay calls.log 10
+ *
+ * Each call is repeated the given number of times, 1 by default. Session ids
+ * in the inputs are mapped to the sessions created in the replay. Calls that
+ * create or destroy a session run only once regardless of the repeat count,
+ * since running them again would leak sessions or destroy ids still in use.
+ *
+ * NOTE: Other operations are repeated as recorded, even if they change the
+ * state of a session or a global variable. Use a repeat count of 1 to replay
+ * a log whose results depend on such state.
+ *
+ * The report lists, for each operation, the number of calls, the mean
+ * recorded time in Matlab, and the mean, median, 95th percentile, and maximum
+ * replay time in microseconds. Calls that fail in the replay are counted as
+ * errors.
+ */
+
+#include <mex.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include "mexplus/recorder.h"
+
+namespace {
+
+/** Latency samples of an operation.
+ */
+struct Latency {
+  Latency() : calls(0), errors(0), recorded(0.0) {}
+  size_t calls;
+  size_t errors;
+  /** Total recorded seconds.
+   */
+  double recorded;
+  /** Replay seconds of each run.
+   */
+  std::vector<double> replayed;
+};
+
+double Percentile(const std::vector<double>& sorted, double fraction) {
+  if (sorted.empty())
+    return 0.0;
+  size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+  return sorted[index];
+}
+
+/** Run a recorded call once. Return false if the call fails.
+ */
+bool Run(const mexplus::CallRecord& record, double* seconds) {
+  std::vector<int64_t> created, destroyed;
+  mexplus::CallRecorder::get()->takeSessions(&created, &destroyed);
+  int nlhs = record.nlhs;
+  std::vector<mxArray*> plhs(std::max(nlhs, 1), static_cast<mxArray*>(NULL));
+  std::vector<const mxArray*> prhs(record.arguments.begin(),
+                                   record.arguments.end());
+  bool succeeded = true;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  try {
+    mexplus::standalone::callMexFunction(nlhs, plhs.data(),
+                                         static_cast<int>(prhs.size()),
+                                         prhs.data());
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "%s: %s\n", record.name.c_str(), e.what());
+    succeeded = false;
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  *seconds = elapsed.count();
+  for (size_t i = 0; i < plhs.size(); ++i)
+    if (plhs[i])
+      mxDestroyArray(plhs[i]);
+  return succeeded;
+}
+
+/** Map the sessions a recorded call created to those created in the replay.
+ */
+void UpdateSessions(const mexplus::CallRecord& record,
+                    mexplus::SessionIdMap* sessions) {
+  std::vector<int64_t> created, destroyed;
+  mexplus::CallRecorder::get()->takeSessions(&created, &destroyed);
+  for (size_t i = 0; i < record.destroyed.size(); ++i)
+    sessions->erase(record.destroyed[i]);
+  for (size_t i = 0; i < record.created.size() && i < created.size(); ++i)
+    (*sessions)[record.created[i]] = created[i];
+}
+
+void Report(const std::map<std::string, Latency>& latencies) {
+  std::printf("%-24s %8s %6s %12s %12s %12s %12s %12s\n",
+              "operation", "calls", "errors", "recorded", "mean", "p50",
+              "p95", "max");
+  for (std::map<std::string, Latency>::const_iterator it = latencies.begin();
+       it != latencies.end(); ++it) {
+    const Latency& latency = it->second;
+    std::vector<double> sorted(latency.replayed);
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for (size_t i = 0; i < sorted.size(); ++i)
+      total += sorted[i];
+    double mean = (sorted.empty()) ? 0.0 : total / sorted.size();
+    std::printf("%-24s %8lu %6lu %12.1f %12.1f %12.1f %12.1f %12.1f\n",
+                it->first.c_str(),
+                static_cast<unsigned long>(latency.calls),
+                static_cast<unsigned long>(latency.errors),
+                1e6 * latency.recorded / std::max<size_t>(latency.calls, 1),
+                1e6 * mean,
+                1e6 * Percentile(sorted, 0.5),
+                1e6 * Percentile(sorted, 0.95),
+                1e6 * ((sorted.empty()) ? 0.0 : sorted.back()));
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2 || argc > 3) {
+    std::fprintf(stderr, "Usage: %s LOG [REPEAT]\n", argv[0]);
+    return 1;
+  }
+  int repeat = (argc > 2) ? std::atoi(argv[2]) : 1;
+  if (repeat < 1) {
+    std::fprintf(stderr, "Invalid repeat: %s\n", argv[2]);
+    return 1;
+  }
+  // Never record the replay itself, even if MEXPLUS_RECORD is set.
+  mexplus::CallRecorder::get()->close();
+  mexplus::CallRecorder::get()->trackSessions(true);
+  std::ifstream input(argv[1], std::ios::binary);
+  if (!input.is_open()) {
+    std::fprintf(stderr, "Failed to open %s\n", argv[1]);
+    return 1;
+  }
+  std::map<std::string, Latency> latencies;
+  try {
+    mexplus::ReadCallLogHeader(&input);
+    mexplus::CallRecord record;
+    mexplus::SessionIdMap sessions;
+    while (mexplus::ReadCallRecord(&input, &record)) {
+      Latency& latency = latencies[record.name];
+      ++latency.calls;
+      latency.recorded += record.seconds;
+      for (size_t i = 0; i < record.arguments.size(); ++i)
+        mexplus::RemapSessions(record.arguments[i], sessions);
+      int runs = (record.changesSessions()) ? 1 : repeat;
+      for (int i = 0; i < runs; ++i) {
+        double seconds;
+        bool succeeded = Run(record, &seconds);
+        if (i == 0)
+          UpdateSessions(record, &sessions);
+        if (!succeeded) {
+          ++latency.errors;
+          break;
+        }
+        latency.replayed.push_back(seconds);
+      }
+    }
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "%s: %s\n", argv[1], e.what());
+    return 1;
+  }
+  Report(latencies);
+  return 0;
+}